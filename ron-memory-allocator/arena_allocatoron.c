@@ -0,0 +1,242 @@
+/**
+ * A bump-pointer arena allocator for allocations that die together.
+ *
+ * - Caller-provided memory region, like the other allocators
+ * - O(1) allocation: align the bump offset, check the limit, advance
+ * - No per-allocation header and no individual frees
+ * - Nested save/restore markers release everything allocated after the marker
+ * - O(1) reset of the whole region
+ * - Optional spill blocks from a variable-size heap when the region overflows
+ *
+ * Operates on a caller-provided memory region. Spill blocks come from the caller's vs_heap_t.
+ */
+
+#include "arena_allocatoron.h"
+#include "error_allocatoron.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Header of a spill block, placed at the start of the block's payload.
+ *
+ * Fields:
+ * - `prev`: The previous spill block, or NULL for the first one (which follows the region).
+ * - `size`: Usable bytes after this header.
+ */
+typedef struct ArenaSpill
+{
+    struct ArenaSpill* prev;
+    size_t size;
+} ArenaSpill;
+
+#define SPILL_HEADER_SIZE sizeof(ArenaSpill)
+
+/**
+ * Points the bump pointer at the end of the given block: a spill block, or the region for NULL.
+ */
+static void use_block(arena_t* arena, ArenaSpill* spill, size_t offset)
+{
+    arena->spills = spill;
+    arena->base = spill ? (char*)spill + SPILL_HEADER_SIZE : arena->memory;
+    arena->limit = spill ? spill->size : arena->size;
+    arena->offset = offset;
+}
+
+/**
+ * Returns the spill blocks newer than keep to the spill heap.
+ */
+static void release_spills(arena_t* arena, const ArenaSpill* keep)
+{
+    while (arena->spills && arena->spills != keep)
+    {
+        ArenaSpill* prev = arena->spills->prev;
+        vs_free(arena->spill, arena->spills);
+        arena->spills = prev;
+    }
+}
+
+/**
+ * Initializes an arena over a memory region.
+ * @param arena The arena handle to initialize
+ * @param memory The region to manage. Must be 8-byte aligned.
+ * @param size The size of the region in bytes
+ * @param spill The heap to take spill blocks from when the region is full. May be NULL.
+ * @return 0 on successful initialization. 1 Otherwise.
+ */
+int arena_init(arena_t* arena, void* memory, size_t size, vs_heap_t* spill)
+{
+    if (!arena || !memory || (uintptr_t)memory % ARENA_ALIGN_SIZE != 0 || size == 0)
+    {
+        RON_ERROR(RON_ECONFIG, memory);
+        return 1;
+    }
+
+    arena->memory = memory;
+    arena->size = size;
+    arena->spill = spill;
+    use_block(arena, NULL, 0);
+
+    return 0;
+}
+
+/**
+ * Allocates memory aligned to ARENA_ALIGN_SIZE.
+ * @param arena The arena to allocate from
+ * @param size The size of the memory to allocate
+ * @return A pointer to the usable allocated memory
+ */
+void* arena_alloc(arena_t* arena, size_t size)
+{
+    return arena_alloc_aligned(arena, size, ARENA_ALIGN_SIZE);
+}
+
+/**
+ * Allocates memory with the given alignment.
+ * When the current block is full, a spill block of at least ARENA_SPILL_SIZE bytes is taken
+ * from the spill heap and bumping continues there. The rest of the full block is not revisited.
+ * @param arena The arena to allocate from
+ * @param size The size of the memory to allocate
+ * @param alignment The alignment of the returned pointer. Must be a power of two.
+ * @return A pointer to the usable allocated memory
+ */
+void* arena_alloc_aligned(arena_t* arena, size_t size, size_t alignment)
+{
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+    {
+        RON_ERROR(RON_EALIGN, NULL);
+        return NULL;
+    }
+
+    // Align the absolute address, so alignments above the region's own are honored too
+    uintptr_t start = ((uintptr_t)arena->base + arena->offset + (alignment - 1)) & ~(uintptr_t)(alignment - 1);
+    size_t offset = (size_t)(start - (uintptr_t)arena->base);
+    if (offset <= arena->limit && size <= arena->limit - offset)
+    {
+        arena->offset = offset + size;
+        return (void*)start;
+    }
+
+    if (!arena->spill || size > SIZE_MAX - SPILL_HEADER_SIZE - alignment)
+    {
+        RON_ERROR(RON_ENOMEM, NULL);
+        return NULL;
+    }
+
+    // Spill - Chain a new block that fits the request at any alignment
+    size_t spill_size = size + alignment > ARENA_SPILL_SIZE ? size + alignment : ARENA_SPILL_SIZE;
+    ArenaSpill* spill = vs_malloc(arena->spill, SPILL_HEADER_SIZE + spill_size);
+    if (!spill)
+        return NULL;
+
+    spill->prev = arena->spills;
+    spill->size = spill_size;
+    use_block(arena, spill, 0);
+
+    return arena_alloc_aligned(arena, size, alignment);
+}
+
+/**
+ * Saves the current position of the arena. Markers nest: restore them in reverse order of saving.
+ * @param arena The arena to save
+ * @return A marker for arena_restore
+ */
+arena_marker_t arena_save(const arena_t* arena)
+{
+    arena_marker_t marker = { arena->spills, arena->offset };
+    return marker;
+}
+
+/**
+ * Releases everything allocated since the marker was saved, including the spill blocks taken since.
+ * @param arena The arena the marker was saved from
+ * @param marker A marker that is not older than a marker already restored
+ */
+void arena_restore(arena_t* arena, arena_marker_t marker)
+{
+    release_spills(arena, marker.spills);
+    use_block(arena, marker.spills, marker.offset);
+}
+
+/**
+ * Releases every allocation of the arena in O(1), plus one vs_free per spill block.
+ * @param arena The arena to reset
+ */
+void arena_reset(arena_t* arena)
+{
+    release_spills(arena, NULL);
+    use_block(arena, NULL, 0);
+}
+
+#ifdef RON_SELF_TEST
+#define ARENA_POOL_SIZE 256
+#define SPILL_POOL_SIZE 8192
+
+static char arena_memory[ARENA_POOL_SIZE] __attribute__((aligned(8)));
+static char spill_memory[SPILL_POOL_SIZE] __attribute__((aligned(8)));
+
+/**
+ * The main function initializes the allocator and acts as a test suite.
+ *
+ * The implemented tests are:
+ * - Bump allocation and alignment
+ * - Nested save/restore markers
+ * - Spilling to the variable-size heap
+ * - Reset
+ * - Out of memory without a spill heap
+ */
+int main()
+{
+    ron_set_error_handler(ron_print_error, NULL); // Failures are silent by default
+
+    vs_heap_t heap;
+    arena_t arena;
+    if (vs_init_heap(&heap, spill_memory, SPILL_POOL_SIZE) || arena_init(&arena, arena_memory, ARENA_POOL_SIZE, &heap))
+    {
+        printf("ERROR: Failed to initialize allocator\n");
+        return 1;
+    }
+
+    printf("\nTest: Bump allocation and alignment\n");
+    char* a = arena_alloc(&arena, 3);
+    char* b = arena_alloc(&arena, 8);
+    char* c = arena_alloc_aligned(&arena, 16, 64);
+    printf("\tSecond allocation follows the first: %s\n", b == a + 8 ? "yes" : "no"); // Should print yes
+    printf("\t64-byte alignment: %s\n", (uintptr_t)c % 64 == 0 ? "yes" : "no"); // Should print yes
+    arena_alloc_aligned(&arena, 8, 3); // Should print 'Alignment must be a power of two'
+
+    printf("\nTest: Nested markers\n");
+    arena_marker_t outer = arena_save(&arena);
+    char* d = arena_alloc(&arena, 32);
+    arena_marker_t inner = arena_save(&arena);
+    arena_alloc(&arena, 32);
+    arena_restore(&arena, inner);
+    printf("\tInner restore keeps the outer allocation: %s\n",
+           arena_alloc(&arena, 32) == d + 32 ? "yes" : "no"); // Should print yes
+    arena_restore(&arena, outer);
+    printf("\tOuter restore reuses its memory: %s\n", arena_alloc(&arena, 32) == d ? "yes" : "no"); // Should print yes
+
+    printf("\nTest: Spill to the variable-size heap\n");
+    arena_marker_t before_spill = arena_save(&arena);
+    void* spilled = arena_alloc(&arena, ARENA_POOL_SIZE); // Larger than what is left in the region
+    printf("\tServed by a spill block: %s\n", vs_owns(&heap, spilled) ? "yes" : "no"); // Should print yes
+    arena_alloc(&arena, 8); // Bumps inside the spill block
+    arena_restore(&arena, before_spill);
+    vs_dump_memory(&heap); // Should print 1 free block
+
+    printf("\nTest: Reset\n");
+    arena_alloc(&arena, ARENA_POOL_SIZE * 2); // Spills again
+    arena_reset(&arena);
+    printf("\tReset rewinds to the region start: %s\n",
+           arena_alloc(&arena, 8) == arena_memory ? "yes" : "no"); // Should print yes
+    vs_dump_memory(&heap); // Should print 1 free block
+
+    printf("\nTest: Out of memory without a spill heap\n");
+    arena_t bounded;
+    arena_init(&bounded, arena_memory, ARENA_POOL_SIZE, NULL);
+    arena_alloc(&bounded, ARENA_POOL_SIZE);
+    arena_alloc(&bounded, 1); // Should print 'Out of memory'
+
+    return 0;
+}
+#endif
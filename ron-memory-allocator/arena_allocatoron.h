@@ -0,0 +1,56 @@
+/**
+ * Public interface of the bump-pointer arena allocator.
+ * See arena_allocatoron.c for the design notes.
+ */
+
+#ifndef ARENA_ALLOCATORON_H
+#define ARENA_ALLOCATORON_H
+
+#include "variable_size_allocatoron.h"
+
+#include <stddef.h>
+
+#define ARENA_ALIGN_SIZE 8 // Default alignment of arena allocations
+#define ARENA_SPILL_SIZE 4096 // Minimal usable size of a spill block
+
+/**
+ * A bump-pointer arena over a caller-provided memory region.
+ * Allocations are never freed one by one; they are released together by arena_restore or arena_reset.
+ *
+ * Fields:
+ * - `memory`: Start of the region. Must be 8-byte aligned.
+ * - `size`: Size of the region in bytes.
+ * - `spill`: Heap that provides spill blocks once the region is full. May be NULL.
+ * - `spills`: Newest spill block, linking to the older ones. NULL while the region is in use.
+ * - `base`: Start of the block being bumped (the region or the newest spill block).
+ * - `limit`: Size of the block being bumped in bytes.
+ * - `offset`: Bytes already handed out from the block being bumped.
+ */
+typedef struct arena_t
+{
+    char* memory;
+    size_t size;
+    vs_heap_t* spill;
+    struct ArenaSpill* spills;
+    char* base;
+    size_t limit;
+    size_t offset;
+} arena_t;
+
+/**
+ * A saved arena position. Restoring it releases everything allocated after it was taken.
+ */
+typedef struct arena_marker_t
+{
+    struct ArenaSpill* spills;
+    size_t offset;
+} arena_marker_t;
+
+int arena_init(arena_t* arena, void* memory, size_t size, vs_heap_t* spill);
+void* arena_alloc(arena_t* arena, size_t size);
+void* arena_alloc_aligned(arena_t* arena, size_t size, size_t alignment);
+arena_marker_t arena_save(const arena_t* arena);
+void arena_restore(arena_t* arena, arena_marker_t marker);
+void arena_reset(arena_t* arena);
+
+#endif
@@ -0,0 +1,560 @@
+/**
+ * Microbenchmarks for the allocators, compared against the C library's malloc.
+ *
+ * Every pattern runs with the same pseudo-random sequence on each allocator that supports it:
+ * - LIFO churn: Allocate a stack of equal-sized objects, free them in reverse order
+ * - Random mix: Random sizes (mostly small, some medium, a few large), freed in random order
+ * - Producer/consumer: One thread allocates, another frees (thread-safe allocators only)
+ * - Realloc growth: Buffers grown step by step with realloc
+ * - Fragmentation: Interleaved frees followed by larger allocations
+ *
+ * Each operation is timed individually. The report lists, per pattern and allocator,
+ * the number of operations, the throughput, the p50/p99/p999 latency in nanoseconds,
+ * and the peak footprint of the allocator (0 for the C library outside glibc).
+ *
+ * Build with optimizations (-DCMAKE_BUILD_TYPE=Release) for meaningful numbers.
+ */
+
+#define _GNU_SOURCE // mallinfo2
+
+#include "fixed_size_allocatoron.h"
+#include "slab_allocatoron.h"
+#include "thread_cache_allocatoron.h"
+#include "variable_size_allocatoron.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#define HEAP_SIZE ((size_t)128 << 20) // Variable-size heap behind vs, tc and the slab fallback
+#define SLAB_SIZE ((size_t)128 << 20) // Slab region, 8 MiB per class so that no class runs out
+#define POOL_BLOCK_SIZE 64 // Fixed-size pool block, also the LIFO churn object size
+#define QUICK_BIN_LIMIT 64 // Quick-list length of the vs-quick heap
+#define POOL_BLOCK_COUNT 4096
+
+#define MAX_SAMPLES (1 << 20) // Timed operations per pattern run
+#define SAMPLE_PERIOD 256 // Operations between two footprint samples of the C library
+
+#define LIFO_ROUNDS 2000
+#define LIFO_DEPTH 64
+#define MIX_SLOTS 4096
+#define MIX_OPS 500000
+#define QUEUE_OBJECTS 250000
+#define QUEUE_CAPACITY 1024
+#define REALLOC_BUFFERS 64
+#define REALLOC_OPS 300000
+#define REALLOC_LIMIT 65536
+#define FRAG_ROUNDS 5
+#define FRAG_OBJECTS 8000
+
+static char heap_memory[HEAP_SIZE] __attribute__((aligned(64)));
+static char slab_memory[SLAB_SIZE] __attribute__((aligned(64)));
+static char pool_memory[POOL_BLOCK_SIZE * POOL_BLOCK_COUNT] __attribute__((aligned(64)));
+
+static vs_heap_t heap;
+static slab_t slab;
+static fs_pool_t pool;
+
+/**
+ * An allocator under test.
+ *
+ * Fields:
+ * - `name`: Name in the report.
+ * - `setup`: Resets the allocator before each pattern.
+ * - `teardown`: Releases what the allocator holds after each pattern. May be NULL.
+ * - `malloc`, `free`: The allocation API.
+ * - `realloc`: NULL if the allocator can't resize.
+ * - `observe`: Records a live allocation for the footprint, outside the timed section.
+ * - `peak`: Returns the peak footprint in bytes since setup.
+ * - `max_size`: Largest request the allocator serves. 0 for any size.
+ * - `thread_safe`: Whether producer/consumer may run on it.
+ */
+typedef struct Allocator
+{
+    const char* name;
+    void (*setup)();
+    void (*teardown)();
+    void* (*malloc)(size_t);
+    void (*free)(void*);
+    void* (*realloc)(void*, size_t);
+    void (*observe)(const void*, size_t);
+    size_t (*peak)();
+    size_t max_size;
+    int thread_safe;
+} Allocator;
+
+// Footprints. Ours are the high-water marks of their regions, the C library's is its arena plus its mappings.
+static size_t high_water;
+static size_t slab_high_water[SLAB_CLASS_COUNT];
+static size_t libc_peak;
+static size_t libc_samples;
+
+static void raise_high_water(size_t* mark, size_t end)
+{
+    if (end > *mark)
+        *mark = end;
+}
+
+static void reset_footprint()
+{
+    high_water = 0;
+    memset(slab_high_water, 0, sizeof(slab_high_water));
+    libc_peak = 0;
+    libc_samples = 0;
+}
+
+// Variable-size heap
+static void vs_setup()
+{
+    vs_init_heap(&heap, heap_memory, HEAP_SIZE);
+    reset_footprint();
+}
+
+// Variable-size heap with quick-lists for small sizes
+static void vs_quick_setup()
+{
+    vs_setup();
+    vs_set_quick_lists(&heap, QUICK_BIN_LIMIT);
+}
+
+static void* vs_bench_malloc(size_t size)
+{
+    return vs_malloc(&heap, size);
+}
+
+static void vs_bench_free(void* ptr)
+{
+    vs_free(&heap, ptr);
+}
+
+static void* vs_bench_realloc(void* ptr, size_t size)
+{
+    return vs_realloc(&heap, ptr, size);
+}
+
+static void heap_observe(const void* ptr, size_t size)
+{
+    raise_high_water(&high_water, (size_t)((const char*)ptr - heap_memory) + size);
+}
+
+static size_t heap_peak()
+{
+    return high_water;
+}
+
+// Fixed-size pool
+static void fs_setup()
+{
+    fs_init_pool(&pool, pool_memory, POOL_BLOCK_SIZE, POOL_BLOCK_COUNT);
+    reset_footprint();
+}
+
+static void* fs_bench_malloc(size_t size)
+{
+    return fs_malloc(&pool, size);
+}
+
+static void fs_bench_free(void* ptr)
+{
+    fs_free(&pool, ptr);
+}
+
+static void pool_observe(const void* ptr, size_t size)
+{
+    (void)size;
+    raise_high_water(&high_water, (size_t)((const char*)ptr - pool_memory) + POOL_BLOCK_SIZE);
+}
+
+// Slab allocator in front of the heap
+static void slab_setup()
+{
+    vs_init_heap(&heap, heap_memory, HEAP_SIZE);
+    slab_init(&slab, slab_memory, SLAB_SIZE, &heap);
+    reset_footprint();
+}
+
+static void* slab_bench_malloc(size_t size)
+{
+    return slab_malloc(&slab, size);
+}
+
+static void slab_bench_free(void* ptr)
+{
+    slab_free(&slab, ptr);
+}
+
+static void slab_observe(const void* ptr, size_t size)
+{
+    if (!slab_owns(&slab, ptr))
+    {
+        heap_observe(ptr, size);
+        return;
+    }
+
+    size_t offset = (size_t)((const char*)ptr - slab.memory);
+    size_t class_index = offset / slab.span;
+    raise_high_water(&slab_high_water[class_index], offset % slab.span + slab_class_size(class_index));
+}
+
+static size_t slab_peak()
+{
+    size_t peak = high_water;
+    for (size_t i = 0; i < SLAB_CLASS_COUNT; i++)
+    {
+        peak += slab_high_water[i];
+    }
+    return peak;
+}
+
+// Thread cache in front of the heap
+static void tc_setup()
+{
+    vs_init_heap(&heap, heap_memory, HEAP_SIZE);
+    tc_init(&pool, &heap);
+    reset_footprint();
+}
+
+// The C library
+static void libc_setup()
+{
+    reset_footprint();
+}
+
+static void libc_observe(const void* ptr, size_t size)
+{
+    (void)ptr;
+    (void)size;
+    if (libc_samples++ % SAMPLE_PERIOD)
+        return;
+
+#ifdef __GLIBC__
+    struct mallinfo2 info = mallinfo2();
+    raise_high_water(&libc_peak, info.arena + info.hblkhd);
+#endif
+}
+
+static size_t libc_peak_footprint()
+{
+    libc_observe(NULL, 0); // Final sample
+    return libc_peak;
+}
+
+static const Allocator allocators[] = {
+    { "vs", vs_setup, NULL, vs_bench_malloc, vs_bench_free, vs_bench_realloc, heap_observe, heap_peak, 0, 0 },
+    { "vs-quick", vs_quick_setup, NULL, vs_bench_malloc, vs_bench_free, vs_bench_realloc, heap_observe, heap_peak, 0, 0 },
+    { "fs", fs_setup, NULL, fs_bench_malloc, fs_bench_free, NULL, pool_observe, heap_peak, POOL_BLOCK_SIZE, 0 },
+    { "slab", slab_setup, NULL, slab_bench_malloc, slab_bench_free, NULL, slab_observe, slab_peak, 0, 0 },
+    { "tc", tc_setup, tc_flush, tc_vs_malloc, tc_vs_free, tc_vs_realloc, heap_observe, heap_peak, 0, 1 },
+    { "libc", libc_setup, NULL, malloc, free, realloc, libc_observe, libc_peak_footprint, 0, 1 },
+};
+
+#define ALLOCATOR_COUNT (sizeof(allocators) / sizeof(allocators[0]))
+
+/**
+ * Latency samples of one pattern run. The producer/consumer consumer thread records separately (see below).
+ */
+static uint32_t samples[MAX_SAMPLES];
+static size_t sample_count;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void record(uint64_t start, uint64_t end)
+{
+    if (sample_count < MAX_SAMPLES)
+        samples[sample_count++] = (uint32_t)(end - start < UINT32_MAX ? end - start : UINT32_MAX);
+}
+
+/**
+ * Deterministic xorshift generator, so that every allocator sees the same sequence.
+ */
+static uint64_t rng_state;
+
+static uint64_t next_random()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static size_t random_between(size_t low, size_t high)
+{
+    return low + (size_t)(next_random() % (high - low + 1));
+}
+
+/**
+ * 90% of requests up to 256 bytes, 9% up to 4 KiB, 1% up to 64 KiB.
+ */
+static size_t random_size()
+{
+    uint64_t bucket = next_random() % 100;
+    if (bucket < 90)
+        return random_between(8, 256);
+    if (bucket < 99)
+        return random_between(257, 4096);
+    return random_between(4097, 65536);
+}
+
+// Timed wrappers. The footprint is observed after the clock stops.
+static void* timed_malloc(const Allocator* a, size_t size)
+{
+    uint64_t start = now_ns();
+    void* ptr = a->malloc(size);
+    record(start, now_ns());
+    if (ptr)
+        a->observe(ptr, size);
+    return ptr;
+}
+
+static void timed_free(const Allocator* a, void* ptr)
+{
+    uint64_t start = now_ns();
+    a->free(ptr);
+    record(start, now_ns());
+}
+
+static void* timed_realloc(const Allocator* a, void* ptr, size_t size)
+{
+    uint64_t start = now_ns();
+    void* new_ptr = a->realloc(ptr, size);
+    record(start, now_ns());
+    if (new_ptr)
+        a->observe(new_ptr, size);
+    return new_ptr;
+}
+
+static void lifo_churn(const Allocator* a)
+{
+    void* stack[LIFO_DEPTH];
+    for (int round = 0; round < LIFO_ROUNDS; round++)
+    {
+        for (int i = 0; i < LIFO_DEPTH; i++)
+            stack[i] = timed_malloc(a, POOL_BLOCK_SIZE);
+        for (int i = LIFO_DEPTH - 1; i >= 0; i--)
+            timed_free(a, stack[i]);
+    }
+}
+
+static void random_mix(const Allocator* a)
+{
+    static void* slots[MIX_SLOTS];
+    memset(slots, 0, sizeof(slots));
+    for (int op = 0; op < MIX_OPS; op++)
+    {
+        size_t slot = (size_t)(next_random() % MIX_SLOTS);
+        if (slots[slot])
+        {
+            timed_free(a, slots[slot]);
+            slots[slot] = NULL;
+        }
+        else
+        {
+            slots[slot] = timed_malloc(a, random_size());
+        }
+    }
+    for (size_t slot = 0; slot < MIX_SLOTS; slot++)
+    {
+        if (slots[slot])
+            a->free(slots[slot]);
+    }
+}
+
+static void realloc_growth(const Allocator* a)
+{
+    void* buffers[REALLOC_BUFFERS] = { 0 };
+    size_t sizes[REALLOC_BUFFERS] = { 0 };
+    for (int op = 0; op < REALLOC_OPS; op++)
+    {
+        size_t i = (size_t)(next_random() % REALLOC_BUFFERS);
+        if (sizes[i] >= REALLOC_LIMIT) // Fully grown - Start over
+        {
+            timed_free(a, buffers[i]);
+            buffers[i] = NULL;
+            sizes[i] = 0;
+            continue;
+        }
+
+        sizes[i] += random_between(8, 256);
+        buffers[i] = timed_realloc(a, buffers[i], sizes[i]);
+    }
+    for (size_t i = 0; i < REALLOC_BUFFERS; i++)
+    {
+        if (buffers[i])
+            a->free(buffers[i]);
+    }
+}
+
+static void fragmentation(const Allocator* a)
+{
+    static void* objects[FRAG_OBJECTS];
+    for (int round = 0; round < FRAG_ROUNDS; round++)
+    {
+        for (size_t i = 0; i < FRAG_OBJECTS; i++)
+            objects[i] = timed_malloc(a, random_between(16, 1024));
+
+        // Punch holes, then ask for blocks that don't fit them
+        for (size_t i = 0; i < FRAG_OBJECTS; i += 2)
+            timed_free(a, objects[i]);
+        for (size_t i = 0; i < FRAG_OBJECTS; i += 2)
+            objects[i] = timed_malloc(a, random_between(1024, 4096));
+
+        for (size_t i = 0; i < FRAG_OBJECTS; i++)
+            timed_free(a, objects[i]);
+    }
+}
+
+/**
+ * A single-producer single-consumer ring of pointers handed from the allocating to the freeing thread.
+ */
+static void* queue[QUEUE_CAPACITY];
+static atomic_size_t queue_head; // Next slot to fill
+static atomic_size_t queue_tail; // Next slot to drain
+
+static void* producer(void* arg)
+{
+    const Allocator* a = arg; // Only this thread draws random numbers while the pattern runs
+    for (size_t i = 0; i < QUEUE_OBJECTS; i++)
+    {
+        void* ptr = timed_malloc(a, random_between(16, 512));
+        size_t head = atomic_load_explicit(&queue_head, memory_order_relaxed);
+        while (head - atomic_load_explicit(&queue_tail, memory_order_acquire) == QUEUE_CAPACITY)
+            sched_yield(); // Full - Wait for the consumer
+        queue[head % QUEUE_CAPACITY] = ptr;
+        atomic_store_explicit(&queue_head, head + 1, memory_order_release);
+    }
+    if (a->teardown)
+        a->teardown();
+    return NULL;
+}
+
+static uint32_t consumer_samples[QUEUE_OBJECTS];
+
+static void* consumer(void* arg)
+{
+    const Allocator* a = arg;
+    for (size_t i = 0; i < QUEUE_OBJECTS; i++)
+    {
+        size_t tail = atomic_load_explicit(&queue_tail, memory_order_relaxed);
+        while (atomic_load_explicit(&queue_head, memory_order_acquire) == tail)
+            sched_yield(); // Empty - Wait for the producer
+        void* ptr = queue[tail % QUEUE_CAPACITY];
+        atomic_store_explicit(&queue_tail, tail + 1, memory_order_release);
+
+        uint64_t start = now_ns();
+        a->free(ptr);
+        uint64_t end = now_ns();
+        consumer_samples[i] = (uint32_t)(end - start < UINT32_MAX ? end - start : UINT32_MAX);
+    }
+    if (a->teardown)
+        a->teardown();
+    return NULL;
+}
+
+static void producer_consumer(const Allocator* a)
+{
+    atomic_store(&queue_head, 0);
+    atomic_store(&queue_tail, 0);
+
+    pthread_t threads[2];
+    pthread_create(&threads[0], NULL, producer, (void*)a);
+    pthread_create(&threads[1], NULL, consumer, (void*)a);
+    pthread_join(threads[0], NULL);
+    pthread_join(threads[1], NULL);
+
+    // Merge the consumer's free latencies with the producer's malloc latencies
+    for (size_t i = 0; i < QUEUE_OBJECTS && sample_count < MAX_SAMPLES; i++)
+        samples[sample_count++] = consumer_samples[i];
+}
+
+/**
+ * A benchmark pattern.
+ *
+ * Fields:
+ * - `name`: Name in the report.
+ * - `run`: Runs the pattern on an allocator.
+ * - `max_size`: Largest request the pattern makes.
+ * - `needs_realloc`: Whether the pattern calls realloc.
+ * - `needs_threads`: Whether the pattern calls the allocator from two threads.
+ */
+typedef struct Pattern
+{
+    const char* name;
+    void (*run)(const Allocator*);
+    size_t max_size;
+    int needs_realloc;
+    int needs_threads;
+} Pattern;
+
+static const Pattern patterns[] = {
+    { "lifo-churn", lifo_churn, POOL_BLOCK_SIZE, 0, 0 },
+    { "random-mix", random_mix, 65536, 0, 0 },
+    { "producer-consumer", producer_consumer, 512, 0, 1 },
+    { "realloc-growth", realloc_growth, REALLOC_LIMIT + 256, 1, 0 },
+    { "fragmentation", fragmentation, 4096, 0, 0 },
+};
+
+#define PATTERN_COUNT (sizeof(patterns) / sizeof(patterns[0]))
+
+static int compare_samples(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t percentile(double q)
+{
+    return samples[(size_t)(q * (double)(sample_count - 1))];
+}
+
+/**
+ * Runs the whole suite and prints one row per pattern and allocator.
+ */
+int main()
+{
+    printf("%-18s %-8s %9s %10s %7s %7s %7s %12s\n",
+           "pattern", "alloc", "ops", "Mops/s", "p50", "p99", "p999", "peak KiB");
+
+    for (size_t p = 0; p < PATTERN_COUNT; p++)
+    {
+        const Pattern* pattern = &patterns[p];
+        for (size_t i = 0; i < ALLOCATOR_COUNT; i++)
+        {
+            const Allocator* a = &allocators[i];
+            if ((a->max_size && a->max_size < pattern->max_size) || (pattern->needs_realloc && !a->realloc)
+                || (pattern->needs_threads && !a->thread_safe))
+                continue;
+
+            a->setup();
+            sample_count = 0;
+            rng_state = 0x9E3779B97F4A7C15ULL + p; // Same sequence for every allocator
+
+            uint64_t start = now_ns();
+            pattern->run(a);
+            double seconds = (double)(now_ns() - start) / 1e9;
+            if (a->teardown)
+                a->teardown(); // The next allocator may re-initialize the same memory
+
+            qsort(samples, sample_count, sizeof(samples[0]), compare_samples);
+            printf("%-18s %-8s %9zu %10.2f %7u %7u %7u %12zu\n", pattern->name, a->name, sample_count,
+                   (double)sample_count / seconds / 1e6, percentile(0.5), percentile(0.99), percentile(0.999),
+                   a->peak() / 1024);
+        }
+    }
+
+    return 0;
+}
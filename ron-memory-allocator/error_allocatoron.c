@@ -0,0 +1,169 @@
+/**
+ * Error reporting for the allocators, without I/O on the allocation or failure paths.
+ *
+ * - Every failure sets a thread-local error code, read with ron_last_error (like errno)
+ * - An optional handler is called with the failure, on the failing thread
+ * - ron_log_error is a handler that records failures into a lock-free ring buffer, which the
+ *   application drains with ron_read_error_log whenever it wants: at a safe point, from another thread...
+ * - ron_print_error is a handler that prints each failure, for debugging and the self-tests only
+ *
+ * No handler is registered by default, so a failure costs a store and a branch.
+ */
+
+#include "error_allocatoron.h"
+
+#include <stdio.h> // Used by ron_print_error only
+
+static _Thread_local ron_error_t last_error = RON_OK;
+
+static ron_error_handler_t error_handler = NULL;
+static void* error_context = NULL;
+
+/**
+ * Registers the handler called on every failure, replacing the previous one.
+ * Register it before the allocators are shared between threads.
+ * @param handler The handler, or NULL to only record the per-thread error code
+ * @param context Passed to every call of the handler
+ */
+void ron_set_error_handler(ron_error_handler_t handler, void* context)
+{
+    error_context = context;
+    error_handler = handler;
+}
+
+/**
+ * Records a failure in the calling thread's error code and passes it to the handler.
+ * Used by the allocators, through RON_ERROR.
+ * @param error The failure
+ * @param function The allocator function that failed
+ * @param ptr The pointer involved, or NULL
+ */
+void ron_report_error(ron_error_t error, const char* function, const void* ptr)
+{
+    last_error = error;
+    if (error_handler)
+        error_handler(error, function, ptr, error_context);
+}
+
+/**
+ * Returns the last failure reported on the calling thread. Successful calls do not reset it.
+ * @return The error code, RON_OK if none was reported since the last ron_clear_error
+ */
+ron_error_t ron_last_error()
+{
+    return last_error;
+}
+
+/**
+ * Resets the calling thread's error code to RON_OK.
+ */
+void ron_clear_error()
+{
+    last_error = RON_OK;
+}
+
+/**
+ * Describes an error code.
+ * @param error The error code
+ * @return A static, human-readable message
+ */
+const char* ron_strerror(ron_error_t error)
+{
+    switch (error)
+    {
+    case RON_OK:
+        return "No error";
+    case RON_ENOMEM:
+        return "Out of memory";
+    case RON_EINVAL:
+        return "Invalid pointer";
+    case RON_EDOUBLEFREE:
+        return "Block already free";
+    case RON_ETOOBIG:
+        return "Request too large for the allocator";
+    case RON_EALIGN:
+        return "Alignment must be a power of two";
+    case RON_ECONFIG:
+        return "Invalid allocator configuration";
+    case RON_ESIZE:
+        return "Size does not match the allocation";
+    case RON_EIO:
+        return "Input/output error on the backing file";
+    }
+    return "Unknown error";
+}
+
+/**
+ * Handler that appends the failure to a ring-buffer log, overwriting the oldest entry when full.
+ *
+ * Any number of threads may log at once: each one claims a position with a fetch-and-add on the head,
+ * then fills its slot like a seqlock writer. The slot's sequence is cleared while the fields are written
+ * and set to position + 1 once they are complete, so readers can detect torn or overwritten entries.
+ *
+ * @param context The ron_error_log_t to write into
+ */
+void ron_log_error(ron_error_t error, const char* function, const void* ptr, void* context)
+{
+    ron_error_log_t* log = context;
+    uint64_t position = atomic_fetch_add_explicit(&log->head, 1, memory_order_relaxed);
+    RonErrorSlot* slot = &log->slots[position & (RON_ERROR_LOG_SIZE - 1)];
+
+    atomic_store_explicit(&slot->sequence, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&slot->error, (int)error, memory_order_relaxed);
+    atomic_store_explicit(&slot->function, function, memory_order_relaxed);
+    atomic_store_explicit(&slot->ptr, (uintptr_t)ptr, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+}
+
+/**
+ * Reads the entries logged since the cursor, oldest first.
+ * Entries that were overwritten before being read are skipped, as are entries still being written
+ * when the log is full (any entry still being written otherwise ends the read).
+ * @param log The log to read
+ * @param cursor The position to read from, 0 initially. Advanced past the entries returned.
+ * @param out Receives the entries
+ * @param capacity The number of entries out can hold
+ * @return The number of entries read
+ */
+size_t ron_read_error_log(const ron_error_log_t* log, uint64_t* cursor, ron_error_entry_t* out, size_t capacity)
+{
+    uint64_t head = atomic_load_explicit(&log->head, memory_order_acquire);
+    if (head - *cursor > RON_ERROR_LOG_SIZE) // The oldest unread entries are gone
+        *cursor = head - RON_ERROR_LOG_SIZE;
+
+    size_t count = 0;
+    while (*cursor < head && count < capacity)
+    {
+        const RonErrorSlot* slot = &log->slots[*cursor & (RON_ERROR_LOG_SIZE - 1)];
+        uint64_t before = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        ron_error_entry_t entry = {
+            .sequence = *cursor,
+            .error = (ron_error_t)atomic_load_explicit(&slot->error, memory_order_relaxed),
+            .function = atomic_load_explicit(&slot->function, memory_order_relaxed),
+            .ptr = (const void*)atomic_load_explicit(&slot->ptr, memory_order_relaxed),
+        };
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t after = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+
+        if (before == *cursor + 1 && after == before)
+            out[count++] = entry;
+        else if (before <= *cursor && head - *cursor < RON_ERROR_LOG_SIZE) // Still being written
+            break;
+        ++*cursor;
+    }
+
+    return count;
+}
+
+/**
+ * Handler that prints each failure to stdout. It blocks on stdio, so it is meant for debugging.
+ */
+void ron_print_error(ron_error_t error, const char* function, const void* ptr, void* context)
+{
+    (void)context;
+    if (ptr)
+        printf("%s: %s (%p)\n", function, ron_strerror(error), ptr);
+    else
+        printf("%s: %s\n", function, ron_strerror(error));
+}
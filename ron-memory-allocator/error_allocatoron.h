@@ -0,0 +1,94 @@
+/**
+ * Error reporting shared by the allocators: error codes, a per-thread last error and a pluggable handler.
+ * See error_allocatoron.c for the design notes.
+ */
+
+#ifndef ERROR_ALLOCATORON_H
+#define ERROR_ALLOCATORON_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RON_ERROR_LOG_SIZE 256 // Entries kept by a ring-buffer log. Must be a power of two.
+
+/**
+ * The failures the allocators report. Failing calls still return NULL (or 1 from initializers);
+ * the code tells why.
+ */
+typedef enum ron_error_t
+{
+    RON_OK = 0,
+    RON_ENOMEM, // No free memory for the request
+    RON_EINVAL, // The pointer was not returned by this allocator
+    RON_EDOUBLEFREE, // The block is already free
+    RON_ETOOBIG, // The request exceeds what the allocator can serve
+    RON_EALIGN, // The alignment is not a power of two
+    RON_ECONFIG, // Invalid initialization parameters
+    RON_ESIZE, // The size given to a sized free does not match the block (RON_HARDENED builds)
+    RON_EIO, // The backing file of a persistent heap could not be read or written
+} ron_error_t;
+
+/**
+ * Called on every reported failure, on the failing thread, before the allocator returns.
+ * It runs on the allocation path, so it should not block (see ron_log_error).
+ * @param error The failure
+ * @param function The allocator function that failed
+ * @param ptr The pointer involved (frees), or NULL
+ * @param context The context registered with the handler
+ */
+typedef void (*ron_error_handler_t)(ron_error_t error, const char* function, const void* ptr, void* context);
+
+/**
+ * One entry read back from a ron_error_log_t.
+ *
+ * Fields:
+ * - `sequence`: Position of the entry in the log, counting from 0. Gaps mean entries were overwritten.
+ * - `error`, `function`, `ptr`: The arguments of the reported failure.
+ */
+typedef struct ron_error_entry_t
+{
+    uint64_t sequence;
+    ron_error_t error;
+    const char* function;
+    const void* ptr;
+} ron_error_entry_t;
+
+/**
+ * A slot of the ring-buffer log, written by any thread without a lock (see error_allocatoron.c).
+ */
+typedef struct RonErrorSlot
+{
+    _Atomic uint64_t sequence;
+    atomic_int error;
+    _Atomic(const char*) function;
+    _Atomic uintptr_t ptr;
+} RonErrorSlot;
+
+/**
+ * A fixed-size ring of the most recent failures. Zero-initialize it before use.
+ *
+ * Fields:
+ * - `head`: Number of entries ever written.
+ * - `slots`: The last RON_ERROR_LOG_SIZE entries.
+ */
+typedef struct ron_error_log_t
+{
+    _Atomic uint64_t head;
+    RonErrorSlot slots[RON_ERROR_LOG_SIZE];
+} ron_error_log_t;
+
+void ron_set_error_handler(ron_error_handler_t handler, void* context);
+void ron_report_error(ron_error_t error, const char* function, const void* ptr);
+ron_error_t ron_last_error();
+void ron_clear_error();
+const char* ron_strerror(ron_error_t error);
+
+void ron_log_error(ron_error_t error, const char* function, const void* ptr, void* context);
+size_t ron_read_error_log(const ron_error_log_t* log, uint64_t* cursor, ron_error_entry_t* out, size_t capacity);
+void ron_print_error(ron_error_t error, const char* function, const void* ptr, void* context);
+
+// Reports a failure of the calling function
+#define RON_ERROR(error, ptr) ron_report_error(error, __func__, ptr)
+
+#endif
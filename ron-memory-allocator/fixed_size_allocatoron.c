@@ -2,169 +2,1044 @@
  *
  * A simple fixed-size memory allocator using a free list.
  *
- * - Statically allocated pool
+ * - Caller-provided memory region, block size and block count chosen at runtime
+ * - Any number of independent pools (fs_pool_t handles)
  * - O(1) allocation and deallocation
  * - LIFO free list (last freed block is allocated first)
  * - No fragmentation (all blocks are identical size)
- * - Wasteful for allocations smaller than BLOCK_SIZE
+ * - Wasteful for allocations smaller than the block size
+ * - Optional lock-free free list (FS_LOCK_FREE) shared by any number of threads
+ * - Optional out-of-band bitmap metadata (FS_BITMAP) that leaves the whole block to the client
+ * - Optional hot-path counters (RON_STATS) and an fs_get_stats snapshot of the pool
+ * - Lock-free remote frees: other threads push blocks onto a queue the owner drains when it runs out
+ * - Sized free (fs_free_sized) that trusts the caller and skips the checks, unless built with RON_HARDENED
+ * - fs_calloc only clears blocks that were handed out before, in a pool declared zeroed with fs_set_zeroed
  *
  * Operates on a fixed memory pool without calling malloc/free.
  */
 
-#include <stdio.h> // Used for printf
-#include <stdlib.h> // Used for size_t
+#include "fixed_size_allocatoron.h"
+#include "error_allocatoron.h"
+#include "stats_allocatoron.h"
+#include "profile_allocatoron.h"
+#include "zero_allocatoron.h"
 
-#define BLOCK_SIZE 32 // Size of each block in bytes (must be >= sizeof(FreeBlock) and 8-byte aligned)
-#define BLOCK_COUNT 8 // Number of blocks in the pool
-#define POOL_SIZE (BLOCK_SIZE * BLOCK_COUNT) // Total pool size in bytes
-
-/**
- * Memory pool - Aligned to 8 bytes.
- * The pool is initialized by fs_init_allocator.
- *
- * 8-byte alignment ensures compatibility with all data types:
- * - Satisfies alignment requirements for 64-bit pointers and doubles
- * - Prevents crashes on strict-alignment architectures (ARM, SPARC)
- * - Avoids performance penalties on x86/x64 from misaligned access
- *
- * Uses 'char' type (exactly 1 byte) to enable byte-level pointer arithmetic.
- */
-char memory_pool[POOL_SIZE] __attribute__((aligned(8)));
+#include <stdint.h> // Used for uintptr_t
+#include <stdio.h> // Used by fs_dump_memory
+#include <stdlib.h> // Used for size_t
+#include <string.h> // Used for memset
 
 /**
  * Represents a free block of memory.
  * Each block points to the next free block in the free list.
  *
- * The "used" flag increases header size but enables O(1) double-free detection.
+ * The mark increases header size but enables O(1) double-free detection: a free block holds FREE_MARK,
+ * a used one any other value (fs_malloc writes 0). Client data rarely matches the mark by accident,
+ * so a block that the client zeroed, like every fs_calloc block, still frees normally.
  * Alternative approaches:
- * - No flag: Would require O(n) traversal of free_list to detect double-free
+ * - No mark: Would require O(n) traversal of free_list to detect double-free
  * - Separate bitset: Would save in-block space but add external overhead
+ *
+ * In the lock-free build both fields are atomic, and blocks are linked by index
+ * (block number + 1, 0 for the end of the list) so that the list head fits in one CAS-able word.
+ *
+ * The bitmap build keeps no metadata inside blocks (see below) and only uses this type for its size limit.
  */
+#ifdef FS_LOCK_FREE
+typedef struct FreeBlock
+{
+    _Atomic uint32_t mark;
+    _Atomic uint32_t next;
+} FreeBlock;
+#else
 typedef struct FreeBlock
 {
-    int used;
+    uint32_t mark;
     struct FreeBlock* next;
 } FreeBlock;
+#endif
+
+#define FREE_MARK 0x45455246u // "FREE" in little-endian byte order
 
+#ifdef FS_LOCK_FREE
 /**
- * A linked list of free blocks.
- * On allocation free blocks are removed from the list.
- * When a block is freed it is added to the list.
+ * The free list is a lock-free LIFO stack (Treiber stack).
+ *
+ * The head packs the index of the top block (low 32 bits, 0 when empty) with a generation
+ * counter (high 32 bits) that changes on every update. A thread whose view of the head is stale
+ * therefore fails its compare-and-swap even if the same block is back on top (the ABA problem).
  */
-FreeBlock* free_list = NULL;
+#define HEAD_INDEX(head) ((uint32_t)(head))
+#define HEAD_NEXT(head, index) ((((head) >> 32) + 1) << 32 | (uint64_t)(index))
+
+static FreeBlock* block_at(const fs_pool_t* pool, uint32_t index)
+{
+    return (FreeBlock*)(pool->memory + pool->block_size * (size_t)(index - 1));
+}
+#endif
 
+#ifdef FS_BITMAP
 /**
- * Initializes the fixed memory allocator.
- * The pool is pre-allocated with BLOCK_COUNT free blocks that are added to the free list.
+ * The bitmap build tracks allocation state out of band, one bit per block (set = free).
+ *
+ * - The client can't corrupt the metadata, and every byte of a block is usable payload
+ * - fs_free validates a block without touching its cache line
+ * - 64 blocks are inspected per word with ctz/popcount
+ * - Allocation takes the lowest free block instead of the most recently freed one
+ *
+ * The bitmap lives in the last block(s) of the region, which are reserved on initialization.
+ */
+#define WORD_BITS 64
+
+static int bit_is_set(const fs_pool_t* pool, size_t index)
+{
+    return (pool->bitmap[index / WORD_BITS] >> (index % WORD_BITS)) & 1;
+}
+
+/**
+ * Sets (free) or clears (used) the bits of count consecutive blocks, a word at a time.
+ */
+static void set_bits(fs_pool_t* pool, size_t index, size_t count, int free)
+{
+    while (count)
+    {
+        size_t word = index / WORD_BITS;
+        size_t shift = index % WORD_BITS;
+        size_t bits = WORD_BITS - shift < count ? WORD_BITS - shift : count;
+        uint64_t mask = (bits == WORD_BITS ? ~0ULL : ((1ULL << bits) - 1)) << shift;
+
+        if (free)
+            pool->bitmap[word] |= mask;
+        else
+            pool->bitmap[word] &= ~mask;
+
+        index += bits;
+        count -= bits;
+    }
+}
+
+/**
+ * Returns the index of the first block at or after index whose bit equals the requested state.
+ * Whole words that can't match are skipped with a single comparison.
+ * @return The block index, or block_count if there is none.
+ */
+static size_t find_bit(const fs_pool_t* pool, size_t index, int free)
+{
+    while (index < pool->block_count)
+    {
+        uint64_t word = pool->bitmap[index / WORD_BITS];
+        if (!free)
+            word = ~word;
+        word &= ~0ULL << (index % WORD_BITS); // Ignore the bits before index
+
+        if (word)
+        {
+            size_t found = index - index % WORD_BITS + (size_t)__builtin_ctzll(word);
+            return found < pool->block_count ? found : pool->block_count;
+        }
+        index += WORD_BITS - index % WORD_BITS;
+    }
+    return pool->block_count;
+}
+#endif
+
+/**
+ * Initializes a fixed-size pool over a memory region.
+ * The region is split into block_count free blocks that are added to the free list.
  * The allocator checks that all sizes are valid and sets limits for its memory space.
+ * In the bitmap build the last blocks hold the bitmap, so fewer than block_count blocks are usable.
+ * @param pool The pool handle to initialize
+ * @param memory The region to manage. Must be 8-byte aligned and hold block_size * block_count bytes.
+ * @param block_size Size of each block in bytes. Must be 8-byte aligned and larger than a FreeBlock
+ * (any non-zero multiple of 8 in the bitmap build).
+ * @param block_count Number of blocks in the pool
  * @return 0 on successful initialization. 1 Otherwise.
  */
-int fs_init_allocator()
+int fs_init_pool(fs_pool_t* pool, void* memory, size_t block_size, size_t block_count)
 {
-    // Walks over the memory pool and initializes the free list
-    FreeBlock* curr = (FreeBlock*)memory_pool;
-    free_list = curr;
+#ifdef FS_BITMAP
+    size_t min_block_size = 8;
+    size_t word_count = (block_count + WORD_BITS - 1) / WORD_BITS;
+    size_t reserved = (word_count * sizeof(uint64_t) + block_size - 1) / (block_size ? block_size : 1);
+#else
+    size_t min_block_size = sizeof(FreeBlock) + 1;
+#endif
 
-    if (POOL_SIZE < BLOCK_SIZE || BLOCK_SIZE <= 0 ||
-        BLOCK_COUNT < 0 || BLOCK_SIZE % 8 != 0 ||
-        BLOCK_SIZE <= sizeof(FreeBlock))
+    if (!pool || !memory || (uintptr_t)memory % 8 != 0 || block_count == 0 ||
+        block_size % 8 != 0 || block_size < min_block_size
+#ifdef FS_BITMAP
+        || block_count <= reserved // No room left for blocks after the bitmap
+#endif
+#ifdef FS_LOCK_FREE
+        || block_count >= UINT32_MAX // Indices must fit the low half of the head
+#endif
+        )
     {
-        printf("Invalid pool size\n");
-        printf("Block size must be aligned to 8\n");
-        printf("Block size must be at least %zu bytes - size of FreeBlock\n", sizeof(FreeBlock));
-
+        RON_ERROR(RON_ECONFIG, memory);
         return 1;
     }
 
+    pool->memory = memory;
+    pool->block_size = block_size;
+    pool->block_count = block_count;
+#ifndef FS_LOCK_FREE
+    atomic_init(&pool->remote_frees, NULL);
+#endif
+#ifdef FS_LOCK_FREE
+    atomic_init(&pool->fresh, pool->memory + block_size * block_count); // Unknown contents (see fs_set_zeroed)
+#else
+    pool->fresh = pool->memory + block_size * block_count;
+#endif
+
+#if defined(FS_BITMAP)
+    // Reserve the tail of the region for the bitmap and mark every remaining block free
+    pool->block_count = block_count - reserved;
+    pool->word_count = (pool->block_count + WORD_BITS - 1) / WORD_BITS;
+    pool->bitmap = (uint64_t*)(pool->memory + pool->block_size * pool->block_count);
+    pool->hint = 0;
+    memset(pool->bitmap, 0, pool->word_count * sizeof(uint64_t)); // Bits past the last block stay used
+    set_bits(pool, 0, pool->block_count, 1);
+#elif defined(FS_LOCK_FREE)
+    // Link every block to its successor by index. Not safe to run concurrently with other calls.
+    for (uint32_t i = 1; i <= block_count; i++)
+    {
+        atomic_init(&block_at(pool, i)->mark, FREE_MARK);
+        atomic_init(&block_at(pool, i)->next, i < block_count ? i + 1 : 0);
+    }
+    atomic_init(&pool->free_list, 1);
+#else
+    // Walks over the memory pool and initializes the free list
+    FreeBlock* curr = (FreeBlock*)pool->memory;
+    pool->free_list = curr;
+
     // Initialize all blocks except the last one
-    for (int i = 0; i < BLOCK_COUNT - 1; i++)
+    for (size_t i = 0; i < block_count - 1; i++)
     {
-        curr->used = 0;
-        // Advance by BLOCK_SIZE bytes to the next block.
-        curr->next = (FreeBlock*)(memory_pool + BLOCK_SIZE * (i + 1));
+        curr->mark = FREE_MARK;
+        // Advance by block_size bytes to the next block.
+        curr->next = (FreeBlock*)(pool->memory + block_size * (i + 1));
         curr = curr->next;
     }
 
     // Initialize last block
-    curr->used = 0;
+    curr->mark = FREE_MARK;
     curr->next = NULL;
+#endif
 
     return 0;
 }
 
+/**
+ * Remote frees.
+ *
+ * A pool is owned by one thread (or guarded by one lock), but any thread may return a block to it
+ * with fs_free_remote: the block is pushed onto the pool's remote_frees stack with one compare-and-swap
+ * and never touches the free list. The owner takes the whole stack with one atomic exchange when its
+ * free list runs dry and frees the blocks as usual, so validation and double-free detection still happen.
+ * Pushes never conflict with the exchange in a way that loses blocks, and there is no ABA problem since
+ * the owner never pops single entries.
+ *
+ * A queued block is linked through its next word, past the mark that fs_free checks (through its
+ * first word in the bitmap build, which keeps no metadata in blocks). The lock-free build needs
+ * no queue: fs_free_remote is fs_free.
+ */
+#ifndef FS_LOCK_FREE
+static void** remote_link(void* block)
+{
+#ifdef FS_BITMAP
+    return (void**)block;
+#else
+    return (void**)&((FreeBlock*)block)->next;
+#endif
+}
+#endif
+
+/**
+ * Frees every block queued by other threads (see above).
+ * @return The number of blocks taken from the queue.
+ */
+static size_t drain_remote(fs_pool_t* pool)
+{
+#ifdef FS_LOCK_FREE
+    (void)pool;
+    return 0;
+#else
+    void* block = atomic_exchange_explicit(&pool->remote_frees, NULL, memory_order_acquire);
+    size_t drained = 0;
+    while (block)
+    {
+        void* next = *remote_link(block); // Overwritten once the block is free
+        fs_free(pool, block);
+        block = next;
+        drained++;
+    }
+    return drained;
+#endif
+}
+
+/**
+ * Frees a block on behalf of a thread that does not own the pool.
+ * Safe to call concurrently with any other call on the pool. The block becomes available to the owner
+ * on its next allocation that finds the pool empty, or on fs_drain_remote.
+ * The block must be in use: a queued free block would overwrite its free-list link before the owner
+ * can detect the double free.
+ * @param pool The pool the block was allocated from
+ * @param ptr A pointer to the used memory
+ */
+void fs_free_remote(fs_pool_t* pool, void* ptr)
+{
+    if (!fs_owns(pool, ptr)) // Only reads fields that never change after initialization
+    {
+        RON_ERROR(RON_EINVAL, ptr);
+        STAT_ADD(STAT_FS_INVALID_FREE, 1);
+        return;
+    }
+
+#ifdef FS_LOCK_FREE
+    fs_free(pool, ptr);
+#else
+    void* head = atomic_load_explicit(&pool->remote_frees, memory_order_relaxed);
+    do
+    {
+        *remote_link(ptr) = head;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->remote_frees, &head, ptr, memory_order_release,
+                                                    memory_order_relaxed));
+    STAT_ADD(STAT_FS_REMOTE_FREE, 1);
+#endif
+}
+
+/**
+ * Frees the blocks other threads returned with fs_free_remote. Must be called by the pool's owner.
+ * Allocations do this on their own when the pool runs out.
+ * @param pool The pool to drain
+ */
+void fs_drain_remote(fs_pool_t* pool)
+{
+    drain_remote(pool);
+}
+
+/**
+ * Known-zero memory.
+ *
+ * The region of a pool often starts out zeroed (static storage, fresh mappings), and blocks are handed
+ * out in address order until the first frees: from the start of the free list, or the lowest set bit.
+ * pool->fresh is the end of the highest block ever handed out, so every block past it still holds the
+ * region's initial contents, apart from the FreeBlock header initialization wrote into it (none in the
+ * bitmap build). It starts at the end of the region, which tells nothing, until fs_set_zeroed moves it
+ * to the start. fs_calloc then only clears the header of a block past the mark, and the whole block otherwise.
+ */
+#ifdef FS_BITMAP
+#define DIRTY_PREFIX 0 // Bytes of a never handed out block that initialization wrote to
+#else
+#define DIRTY_PREFIX sizeof(FreeBlock)
+#endif
+
+static _Thread_local int took_fresh; // Set when the calling thread moves a pool's mark (see fs_calloc)
+
+/**
+ * Records that a block is handed out. Moving the mark past the block sets took_fresh.
+ */
+static void touch_block(fs_pool_t* pool, char* block)
+{
+#ifdef FS_LOCK_FREE
+    // A block past the mark can only be touched by the thread that popped it
+    char* fresh = atomic_load_explicit(&pool->fresh, memory_order_relaxed);
+    while (block >= fresh)
+    {
+        if (atomic_compare_exchange_weak_explicit(&pool->fresh, &fresh, block + pool->block_size,
+                                                  memory_order_relaxed, memory_order_relaxed))
+        {
+            took_fresh = 1;
+            return;
+        }
+    }
+#else
+    if (block >= pool->fresh)
+    {
+        pool->fresh = block + pool->block_size;
+        took_fresh = 1;
+    }
+#endif
+}
+
+/**
+ * Declares that the pool's region was zero-filled when the pool was initialized (static storage,
+ * or pages fresh from the OS), so fs_calloc can skip the blocks that were never handed out.
+ * Must be called before the first allocation.
+ * @param pool The pool to mark
+ */
+void fs_set_zeroed(fs_pool_t* pool)
+{
+#ifdef FS_LOCK_FREE
+    atomic_store_explicit(&pool->fresh, pool->memory, memory_order_relaxed);
+#else
+    pool->fresh = pool->memory;
+#endif
+}
+
 /**
  * Allocates a block in the memory pool.
  * Allocation is done simply by removing a block from the free list.
+ * @param pool The pool to allocate from
  * @param size The size of the block to allocate. Since this is a fixed size memory allocator,
  * the size is used to make sure that the user doesn't try to allocate more than the block size.
  * @return A pointer to the usable allocated memory
  */
-void* fs_malloc(size_t size)
+void* fs_malloc(fs_pool_t* pool, size_t size)
 {
-    if (free_list == NULL) // Out of memory
+#if defined(FS_BITMAP)
+    if (size > pool->block_size) // Too big
+    {
+        RON_ERROR(RON_ETOOBIG, NULL);
+        return NULL;
+    }
+
+    // Words below the hint are known to be full
+    size_t index = find_bit(pool, pool->hint * WORD_BITS, 1);
+    if (index == pool->block_count && drain_remote(pool))
+        index = find_bit(pool, pool->hint * WORD_BITS, 1);
+    if (index == pool->block_count) // Out of memory
+    {
+        pool->hint = pool->word_count;
+        RON_ERROR(RON_ENOMEM, NULL);
+        STAT_ADD(STAT_FS_OOM, 1);
+        return NULL;
+    }
+
+    pool->hint = index / WORD_BITS;
+    set_bits(pool, index, 1, 0); // Mark as used
+
+    char* block = pool->memory + pool->block_size * index;
+    touch_block(pool, block);
+    STAT_ADD(STAT_FS_MALLOC, 1);
+    PROF_MALLOC(block, pool->block_size);
+    return block;
+#elif defined(FS_LOCK_FREE)
+    if (size > pool->block_size) // Too big
     {
-        printf("Out of memory\n");
+        RON_ERROR(RON_ETOOBIG, NULL);
         return NULL;
     }
-    if (size > BLOCK_SIZE) // Too big
+
+    // Pop the head. If another thread changed the list meanwhile, the CAS reloads the head and retries.
+    uint64_t head = atomic_load_explicit(&pool->free_list, memory_order_acquire);
+    FreeBlock* block;
+    do
     {
-        printf("The fixed size allocator can't allocate more than %d\n", BLOCK_SIZE);
+        if (!HEAD_INDEX(head)) // Out of memory
+        {
+            RON_ERROR(RON_ENOMEM, NULL);
+            STAT_ADD(STAT_FS_OOM, 1);
+            return NULL;
+        }
+        block = block_at(pool, HEAD_INDEX(head));
+        // The block may already be owned by a faster thread. The value is then stale, but the CAS fails.
+        uint32_t next = atomic_load_explicit(&block->next, memory_order_relaxed);
+        if (atomic_compare_exchange_weak_explicit(&pool->free_list, &head, HEAD_NEXT(head, next),
+                                                  memory_order_acquire, memory_order_acquire))
+            break;
+    } while (1);
+
+    atomic_store_explicit(&block->mark, 0, memory_order_relaxed); // Mark as used
+
+    touch_block(pool, (char*)block);
+    STAT_ADD(STAT_FS_MALLOC, 1);
+    PROF_MALLOC(block, pool->block_size);
+    return (void*)block;
+#else
+    if (pool->free_list == NULL) // Blocks freed by other threads may be waiting
+        drain_remote(pool);
+    if (pool->free_list == NULL) // Out of memory
+    {
+        RON_ERROR(RON_ENOMEM, NULL);
+        STAT_ADD(STAT_FS_OOM, 1);
+        return NULL;
+    }
+    if (size > pool->block_size) // Too big
+    {
+        RON_ERROR(RON_ETOOBIG, NULL);
         return NULL;
     }
 
-    FreeBlock* block = free_list; // Get the head of the free list
-    free_list = free_list->next; // Advance the head
-    block->used = 1; // Mark as used
+    FreeBlock* block = pool->free_list; // Get the head of the free list
+    pool->free_list = pool->free_list->next; // Advance the head
+    block->mark = 0; // Mark as used
     block->next = NULL; // Clear next pointer
 
+    touch_block(pool, (char*)block);
+    STAT_ADD(STAT_FS_MALLOC, 1);
+    PROF_MALLOC(block, pool->block_size);
     return (void*)block;
+#endif
+}
+
+/**
+ * Allocates a zeroed block for count elements of the given size.
+ * In a pool declared with fs_set_zeroed, a block that was never handed out is only cleared where
+ * initialization wrote to it (see above).
+ * @param pool The pool to allocate from
+ * @param count The number of elements
+ * @param size The size of each element. count * size must not exceed the block size.
+ * @return A pointer to the zeroed memory, or NULL on failure.
+ */
+void* fs_calloc(fs_pool_t* pool, size_t count, size_t size)
+{
+    if (size && count > SIZE_MAX / size)
+    {
+        RON_ERROR(RON_ETOOBIG, NULL);
+        return NULL;
+    }
+
+    took_fresh = 0;
+    void* ptr = fs_malloc(pool, count * size);
+    if (ptr)
+        ron_zero(ptr, took_fresh && DIRTY_PREFIX < count * size ? DIRTY_PREFIX : count * size);
+    return ptr;
 }
 
 /**
  * Frees a used block of memory.
  * Freeing a block is done by adding it back to the free list.
  * This is done in a LIFO manner where the freshly freed block is the new head of the free list.
+ * @param pool The pool the block was allocated from
  * @param ptr A pointer to the used memory
  */
-void fs_free(void* ptr)
+void fs_free(fs_pool_t* pool, void* ptr)
 {
     // Validate pointer: must be non-NULL, within pool bounds, and block-aligned
-    if (!ptr || (char*)ptr < memory_pool || (char*)ptr >= (memory_pool + POOL_SIZE)
-        || ((char*)ptr - memory_pool) % BLOCK_SIZE != 0)
+    if (!fs_owns(pool, ptr))
     {
-        printf("Invalid pointer\n");
+        RON_ERROR(RON_EINVAL, ptr);
+        STAT_ADD(STAT_FS_INVALID_FREE, 1);
         return;
     }
 
+#if defined(FS_BITMAP)
+    size_t index = (size_t)((char*)ptr - pool->memory) / pool->block_size;
+    if (bit_is_set(pool, index)) // Double free detection
+    {
+        RON_ERROR(RON_EDOUBLEFREE, ptr);
+        STAT_ADD(STAT_FS_INVALID_FREE, 1);
+        return;
+    }
+
+    set_bits(pool, index, 1, 1); // Mark as free
+    if (index / WORD_BITS < pool->hint)
+        pool->hint = index / WORD_BITS;
+    STAT_ADD(STAT_FS_FREE, 1);
+    PROF_FREE(ptr);
+#elif defined(FS_LOCK_FREE)
     FreeBlock* block = (FreeBlock*)ptr;
-    if (!block->used) // Double free detection
+
+    // Double free detection - Only one of several racing frees observes a used mark
+    if (atomic_exchange_explicit(&block->mark, FREE_MARK, memory_order_relaxed) == FREE_MARK)
     {
-        printf("Block already free\n");
+        RON_ERROR(RON_EDOUBLEFREE, ptr);
+        STAT_ADD(STAT_FS_INVALID_FREE, 1);
         return;
     }
 
-    block->used = 0; // Mark as free
-    block->next = free_list; // Insert the new free block
-    free_list = block; // Advance the head
+    // Push as the new head
+    uint32_t index = (uint32_t)(((char*)ptr - pool->memory) / pool->block_size) + 1;
+    uint64_t head = atomic_load_explicit(&pool->free_list, memory_order_relaxed);
+    do
+    {
+        atomic_store_explicit(&block->next, HEAD_INDEX(head), memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->free_list, &head, HEAD_NEXT(head, index),
+                                                    memory_order_release, memory_order_relaxed));
+    STAT_ADD(STAT_FS_FREE, 1);
+    PROF_FREE(ptr);
+#else
+    FreeBlock* block = (FreeBlock*)ptr;
+    if (block->mark == FREE_MARK) // Double free detection
+    {
+        RON_ERROR(RON_EDOUBLEFREE, ptr);
+        STAT_ADD(STAT_FS_INVALID_FREE, 1);
+        return;
+    }
 
+    block->mark = FREE_MARK; // Mark as free
+    block->next = pool->free_list; // Insert the new free block
+    pool->free_list = block; // Advance the head
+    STAT_ADD(STAT_FS_FREE, 1);
+    PROF_FREE(ptr);
+#endif
+}
+
+/**
+ * Frees a block whose size the caller knows.
+ * The pointer is trusted: the bounds and alignment checks and the double-free check of fs_free are
+ * skipped, so the free only writes to the block (or the bitmap). Built with RON_HARDENED, the pointer
+ * and the size are verified and the call reports misuse like fs_free.
+ * @param pool The pool the block was allocated from
+ * @param ptr A pointer to the used memory, returned by this pool
+ * @param size The size the block was allocated with. Must not exceed the block size.
+ */
+void fs_free_sized(fs_pool_t* pool, void* ptr, size_t size)
+{
+#ifdef RON_HARDENED
+    if (fs_owns(pool, ptr) && size > pool->block_size)
+    {
+        RON_ERROR(RON_ESIZE, ptr);
+        STAT_ADD(STAT_FS_INVALID_FREE, 1);
+        return;
+    }
+    fs_free(pool, ptr);
+#else
+    (void)size; // Every block of the pool has the same size
+
+#if defined(FS_BITMAP)
+    size_t index = (size_t)((char*)ptr - pool->memory) / pool->block_size;
+    set_bits(pool, index, 1, 1); // Mark as free
+    if (index / WORD_BITS < pool->hint)
+        pool->hint = index / WORD_BITS;
+#elif defined(FS_LOCK_FREE)
+    FreeBlock* block = (FreeBlock*)ptr;
+    atomic_store_explicit(&block->mark, FREE_MARK, memory_order_relaxed); // Mark as free
+
+    uint32_t index = (uint32_t)(((char*)ptr - pool->memory) / pool->block_size) + 1;
+    uint64_t head = atomic_load_explicit(&pool->free_list, memory_order_relaxed);
+    do
+    {
+        atomic_store_explicit(&block->next, HEAD_INDEX(head), memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->free_list, &head, HEAD_NEXT(head, index),
+                                                    memory_order_release, memory_order_relaxed));
+#else
+    FreeBlock* block = (FreeBlock*)ptr;
+    block->mark = FREE_MARK; // Mark as free
+    block->next = pool->free_list;
+    pool->free_list = block;
+#endif
+    STAT_ADD(STAT_FS_FREE, 1);
+    PROF_FREE(ptr);
+#endif
+}
+
+/**
+ * Allocates several blocks in one call. The size is validated once and the blocks leave the
+ * free list as one chain, so the per-call overhead is paid once per batch.
+ * @param pool The pool to allocate from
+ * @param size The size of each block to allocate. Must not exceed the block size.
+ * @param count The number of blocks to allocate
+ * @param out Receives the allocated blocks. Must hold count pointers.
+ * @return The number of blocks allocated, fewer than count if the pool runs out.
+ */
+size_t fs_malloc_batch(fs_pool_t* pool, size_t size, size_t count, void** out)
+{
+    if (size > pool->block_size) // Too big
+    {
+        RON_ERROR(RON_ETOOBIG, NULL);
+        return 0;
+    }
+
+    size_t taken = 0;
+#if defined(FS_BITMAP)
+    // Take the lowest free blocks word by word, writing each bitmap word back once
+    size_t word = pool->hint;
+    for (; word < pool->word_count && taken < count; word++)
+    {
+        uint64_t bits = pool->bitmap[word];
+        while (bits && taken < count)
+        {
+            size_t index = word * WORD_BITS + (size_t)__builtin_ctzll(bits);
+            bits &= bits - 1; // Mark as used
+            out[taken++] = pool->memory + pool->block_size * index;
+        }
+        pool->bitmap[word] = bits;
+    }
+    pool->hint = taken == count && word ? word - 1 : word; // The last word visited may still have free blocks
+#elif defined(FS_LOCK_FREE)
+    // Detach up to count blocks from the top with a single CAS
+    uint64_t head = atomic_load_explicit(&pool->free_list, memory_order_acquire);
+    uint32_t rest;
+    do
+    {
+        rest = HEAD_INDEX(head);
+        taken = 0;
+        while (rest && rest <= pool->block_count && taken < count)
+        {
+            // Blocks may be owned by a faster thread, so the links can be stale, but the CAS then fails
+            rest = atomic_load_explicit(&block_at(pool, rest)->next, memory_order_relaxed);
+            taken++;
+        }
+        if (rest > pool->block_count) // A stale link - Reload the head
+        {
+            head = atomic_load_explicit(&pool->free_list, memory_order_acquire);
+            continue;
+        }
+        if (!taken)
+            break;
+        if (atomic_compare_exchange_weak_explicit(&pool->free_list, &head, HEAD_NEXT(head, rest),
+                                                  memory_order_acquire, memory_order_acquire))
+            break;
+    } while (1);
+
+    // The chain is now private, so its links can be followed safely
+    uint32_t index = HEAD_INDEX(head);
+    for (size_t i = 0; i < taken; i++)
+    {
+        FreeBlock* block = block_at(pool, index);
+        index = atomic_load_explicit(&block->next, memory_order_relaxed);
+        atomic_store_explicit(&block->mark, 0, memory_order_relaxed); // Mark as used
+        out[i] = (void*)block;
+    }
+#else
+    FreeBlock* block = pool->free_list;
+    while (block && taken < count)
+    {
+        FreeBlock* next = block->next;
+        block->mark = 0; // Mark as used
+        block->next = NULL; // Clear next pointer
+        out[taken++] = (void*)block;
+        block = next;
+    }
+    pool->free_list = block; // Detach the whole chain at once
+#endif
+    for (size_t i = 0; i < taken; i++)
+    {
+        touch_block(pool, out[i]);
+        PROF_MALLOC(out[i], pool->block_size);
+    }
+
+    // Blocks freed by other threads may cover the rest
+    if (taken < count && drain_remote(pool))
+    {
+        STAT_ADD(STAT_FS_MALLOC, taken);
+        return taken + fs_malloc_batch(pool, size, count - taken, out + taken);
+    }
+
+    if (taken < count)
+    {
+        RON_ERROR(RON_ENOMEM, NULL);
+        STAT_ADD(STAT_FS_OOM, 1);
+    }
+
+    STAT_ADD(STAT_FS_MALLOC, taken);
+    return taken;
+}
+
+/**
+ * Frees several used blocks in one call.
+ * Each pointer is still validated, but the blocks are linked into a chain first
+ * and the chain joins the free list in one operation (one CAS in the lock-free build).
+ * Invalid pointers and double frees are reported and skipped.
+ * @param pool The pool the blocks were allocated from
+ * @param ptrs The blocks to free
+ * @param count The number of pointers in ptrs
+ */
+void fs_free_batch(fs_pool_t* pool, void** ptrs, size_t count)
+{
+#if defined(FS_BITMAP)
+    // The bitmap has no list to splice, so each block only costs a bit update
+    for (size_t i = 0; i < count; i++)
+    {
+        fs_free(pool, ptrs[i]);
+    }
+#elif defined(FS_LOCK_FREE)
+    uint32_t first = 0;
+    FreeBlock* last = NULL;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!fs_owns(pool, ptrs[i]))
+        {
+            RON_ERROR(RON_EINVAL, ptrs[i]);
+            STAT_ADD(STAT_FS_INVALID_FREE, 1);
+            continue;
+        }
+
+        FreeBlock* block = (FreeBlock*)ptrs[i];
+        if (atomic_exchange_explicit(&block->mark, FREE_MARK, memory_order_relaxed) == FREE_MARK) // Double free detection
+        {
+            RON_ERROR(RON_EDOUBLEFREE, ptrs[i]);
+            STAT_ADD(STAT_FS_INVALID_FREE, 1);
+            continue;
+        }
+
+        atomic_store_explicit(&block->next, first, memory_order_relaxed);
+        first = (uint32_t)(((char*)block - pool->memory) / pool->block_size) + 1;
+        if (!last)
+            last = block;
+        STAT_ADD(STAT_FS_FREE, 1);
+        PROF_FREE(block);
+    }
+    if (!last)
+        return;
+
+    // Push the whole chain as the new top
+    uint64_t head = atomic_load_explicit(&pool->free_list, memory_order_relaxed);
+    do
+    {
+        atomic_store_explicit(&last->next, HEAD_INDEX(head), memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->free_list, &head, HEAD_NEXT(head, first),
+                                                    memory_order_release, memory_order_relaxed));
+#else
+    FreeBlock* first = NULL;
+    FreeBlock* last = NULL;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!fs_owns(pool, ptrs[i]))
+        {
+            RON_ERROR(RON_EINVAL, ptrs[i]);
+            STAT_ADD(STAT_FS_INVALID_FREE, 1);
+            continue;
+        }
+
+        FreeBlock* block = (FreeBlock*)ptrs[i];
+        if (block->mark == FREE_MARK) // Double free detection
+        {
+            RON_ERROR(RON_EDOUBLEFREE, ptrs[i]);
+            STAT_ADD(STAT_FS_INVALID_FREE, 1);
+            continue;
+        }
+
+        block->mark = FREE_MARK; // Mark as free
+        block->next = first;
+        first = block;
+        if (!last)
+            last = block;
+        STAT_ADD(STAT_FS_FREE, 1);
+        PROF_FREE(block);
+    }
+    if (!last)
+        return;
+
+    last->next = pool->free_list; // Splice the chain in front of the free list
+    pool->free_list = first;
+#endif
+}
+
+/**
+ * Checks whether a pointer names a block of the pool, without reading the block.
+ * @param pool The pool to check against
+ * @param ptr The pointer to check
+ * @return 1 if the pointer is non-NULL, within pool bounds, and block-aligned. 0 Otherwise.
+ */
+int fs_owns(const fs_pool_t* pool, const void* ptr)
+{
+    const char* end = pool->memory + pool->block_size * pool->block_count;
+    return ptr && (const char*)ptr >= pool->memory && (const char*)ptr < end
+        && ((const char*)ptr - pool->memory) % pool->block_size == 0;
+}
+
+/**
+ * Takes a snapshot of the allocator counters and of the pool's occupancy.
+ *
+ * The counters are summed over all threads and cover every pool of the process, since each thread
+ * accumulates its own (see stats_allocatoron.c). They stay 0 unless the library is built with RON_STATS.
+ * The free block count is computed from the pool: a popcount of the bitmap, or a walk of the free list.
+ * In the lock-free build the walk races with other threads, so the count is approximate under concurrency.
+ *
+ * @param pool The pool to inspect
+ * @param stats Receives the snapshot
+ */
+void fs_get_stats(const fs_pool_t* pool, fs_stats_t* stats)
+{
+    uint64_t totals[STAT_COUNT];
+    stats_collect(totals);
+
+    stats->mallocs = totals[STAT_FS_MALLOC];
+    stats->frees = totals[STAT_FS_FREE];
+    stats->oom = totals[STAT_FS_OOM];
+    stats->invalid_frees = totals[STAT_FS_INVALID_FREE];
+    stats->remote_frees = totals[STAT_FS_REMOTE_FREE];
+    stats->block_count = pool->block_count;
+
+#if defined(FS_BITMAP)
+    stats->free_blocks = fs_free_count(pool);
+#elif defined(FS_LOCK_FREE)
+    // Stale links end the walk instead of leaving the pool
+    size_t free_blocks = 0;
+    uint32_t index = HEAD_INDEX(atomic_load_explicit(&pool->free_list, memory_order_acquire));
+    while (index && index <= pool->block_count && free_blocks < pool->block_count)
+    {
+        index = atomic_load_explicit(&block_at(pool, index)->next, memory_order_relaxed);
+        free_blocks++;
+    }
+    stats->free_blocks = free_blocks;
+#else
+    size_t free_blocks = 0;
+    for (const FreeBlock* block = pool->free_list; block; block = block->next)
+    {
+        free_blocks++;
+    }
+    stats->free_blocks = free_blocks;
+#endif
 }
 
 /**
  * Prints a list of blocks, their sizes and free/used status
+ * @param pool The pool to print
  */
-void dump_memory()
+void fs_dump_memory(const fs_pool_t* pool)
 {
     printf("Memory Dump:\n");
 
-    for (int i = 0; i < BLOCK_COUNT; i++)
+    for (size_t i = 0; i < pool->block_count; i++)
     {
-        FreeBlock* block = (FreeBlock*)(memory_pool + BLOCK_SIZE * i);
-        printf("\tBlock at %p, size %d, used %d\n", block, BLOCK_SIZE, block->used);
+        FreeBlock* block = (FreeBlock*)(pool->memory + pool->block_size * i);
+#ifdef FS_BITMAP
+        int used = !bit_is_set(pool, i);
+#else
+        int used = block->mark != FREE_MARK;
+#endif
+        printf("\tBlock at %p, size %zu, used %d\n", (void*)block, pool->block_size, used);
     }
 
     printf("End Memory Dump\n");
 }
 
+#ifdef FS_BITMAP
+/**
+ * Allocates a run of adjacent blocks, for example to back an array of objects.
+ * Free runs are found by alternating ctz searches for the next free and the next used block.
+ * @param pool The pool to allocate from
+ * @param count The number of adjacent blocks to allocate
+ * @return A pointer to the first block of the run, or NULL if there is no long enough run.
+ */
+void* fs_malloc_contiguous(fs_pool_t* pool, size_t count)
+{
+    if (count == 0 || count > pool->block_count)
+    {
+        RON_ERROR(RON_ENOMEM, NULL);
+        STAT_ADD(STAT_FS_OOM, 1);
+        return NULL;
+    }
+
+    size_t start = find_bit(pool, pool->hint * WORD_BITS, 1);
+    while (start + count <= pool->block_count)
+    {
+        size_t end = find_bit(pool, start, 0); // End of this free run
+        if (end - start >= count)
+        {
+            set_bits(pool, start, count, 0); // Mark as used
+            touch_block(pool, pool->memory + pool->block_size * (start + count - 1)); // The run's last block
+            STAT_ADD(STAT_FS_MALLOC, count);
+            PROF_MALLOC(pool->memory + pool->block_size * start, pool->block_size * count);
+            return pool->memory + pool->block_size * start;
+        }
+        start = find_bit(pool, end, 1); // Start of the next free run
+    }
+
+    RON_ERROR(RON_ENOMEM, NULL);
+    STAT_ADD(STAT_FS_OOM, 1);
+    return NULL;
+}
+
+/**
+ * Frees a run of adjacent blocks allocated by fs_malloc_contiguous.
+ * @param pool The pool the run was allocated from
+ * @param ptr A pointer to the first block of the run
+ * @param count The number of blocks in the run
+ */
+void fs_free_contiguous(fs_pool_t* pool, void* ptr, size_t count)
+{
+    if (!fs_owns(pool, ptr) || count == 0 ||
+        (size_t)((char*)ptr - pool->memory) / pool->block_size + count > pool->block_count)
+    {
+        RON_ERROR(RON_EINVAL, ptr);
+        STAT_ADD(STAT_FS_INVALID_FREE, 1);
+        return;
+    }
+
+    size_t index = (size_t)((char*)ptr - pool->memory) / pool->block_size;
+    if (find_bit(pool, index, 1) < index + count) // Double free detection
+    {
+        RON_ERROR(RON_EDOUBLEFREE, ptr);
+        STAT_ADD(STAT_FS_INVALID_FREE, 1);
+        return;
+    }
+
+    set_bits(pool, index, count, 1); // Mark as free
+    if (index / WORD_BITS < pool->hint)
+        pool->hint = index / WORD_BITS;
+    STAT_ADD(STAT_FS_FREE, count);
+    PROF_FREE(ptr);
+}
+
+/**
+ * Counts the free blocks of the pool with one popcount per 64 blocks.
+ * @param pool The pool to inspect
+ * @return The number of free blocks
+ */
+size_t fs_free_count(const fs_pool_t* pool)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < pool->word_count; i++)
+    {
+        count += (size_t)__builtin_popcountll(pool->bitmap[i]);
+    }
+    return count;
+}
+#endif
+
+#ifdef RON_SELF_TEST
+#define BLOCK_SIZE 32 // Size of each block in bytes (must be > sizeof(FreeBlock) and 8-byte aligned)
+#define BLOCK_COUNT 8 // Number of blocks in the pool
+#define POOL_SIZE (BLOCK_SIZE * BLOCK_COUNT) // Total pool size in bytes
+
+/**
+ * Memory pool - Aligned to 8 bytes.
+ * The pool is initialized by fs_init_pool.
+ *
+ * 8-byte alignment ensures compatibility with all data types:
+ * - Satisfies alignment requirements for 64-bit pointers and doubles
+ * - Prevents crashes on strict-alignment architectures (ARM, SPARC)
+ * - Avoids performance penalties on x86/x64 from misaligned access
+ *
+ * Uses 'char' type (exactly 1 byte) to enable byte-level pointer arithmetic.
+ */
+static char memory_pool[POOL_SIZE] __attribute__((aligned(8)));
+
+static fs_pool_t pool;
+
+#include <pthread.h>
+
+/**
+ * Frees the blocks it is given into the main thread's pool.
+ */
+static void* remote_free(void* arg)
+{
+    void** blocks = arg;
+    for (size_t i = 0; blocks[i]; i++)
+        fs_free_remote(&pool, blocks[i]);
+    return NULL;
+}
+
+#ifdef FS_LOCK_FREE
+
+#define STRESS_THREADS 4
+#define STRESS_ITERATIONS 100000
+
+/**
+ * Repeatedly holds two blocks at a time and checks that no other thread was handed the same block.
+ * @return The number of conflicts and failed allocations seen
+ */
+static void* stress(void* arg)
+{
+    size_t id = (size_t)arg;
+    size_t errors = 0;
+    for (int i = 0; i < STRESS_ITERATIONS; i++)
+    {
+        // The second word is past the in-block metadata, so it is owned by the client
+        size_t* a = fs_malloc(&pool, sizeof(size_t) * 2);
+        if (a)
+            a[1] = id;
+        size_t* b = fs_malloc(&pool, sizeof(size_t) * 2);
+        if (b)
+            b[1] = id;
+
+        if (!a || !b || a[1] != id || b[1] != id)
+            errors++;
+
+        if (b)
+            fs_free(&pool, b);
+        if (a)
+            fs_free(&pool, a);
+    }
+    return (void*)errors;
+}
+#endif
+
 /**
  * The main function initializes the allocator and acts as a test suite.
  *
@@ -173,43 +1048,183 @@ void dump_memory()
  * - Freeing all memory
  * - Double Free
  * - Invalid pointers
+ * - Independent pools
+ * - Batch allocation and deallocation
+ * - Statistics
+ * - Error codes and the ring-buffer log
+ * - Remote frees from another thread
+ * - Sized free
+ * - Calloc
+ * - Concurrent allocation and deallocation (lock-free build only)
+ * - Contiguous runs and occupancy (bitmap build only)
  */
 int main()
 {
+    ron_set_error_handler(ron_print_error, NULL); // Failures are silent by default
+
     // Initialize allocator
-    if (fs_init_allocator())
+    if (fs_init_pool(&pool, memory_pool, BLOCK_SIZE, BLOCK_COUNT))
     {
         printf("ERROR: Failed to initialize allocator\n");
         return 1;
     }
     printf("Initial State:\n");
-    dump_memory();
+    fs_dump_memory(&pool);
 
     printf("\nTest: Allocate until out of memory\n");
     void* blocks[BLOCK_COUNT + 1];
     // One extra iteration to trigger 'Out of memory'
     for (int i = 0; i <= BLOCK_COUNT; i++) {
-        blocks[i] = fs_malloc(8);
+        blocks[i] = fs_malloc(&pool, 8);
         if (blocks[i])
             printf("\tAllocated block %d: %p\n", i, blocks[i]);
     }
-    dump_memory(); // Should print full memory
+    fs_dump_memory(&pool); // Should print full memory
 
     printf("\nTest: Free all blocks\n");
     for (int i = 0; i <= BLOCK_COUNT; i++) {
-        fs_free(blocks[i]); // Last free should print 'Invalid pointer'
+        fs_free(&pool, blocks[i]); // Last free should print 'Invalid pointer'
     }
-    dump_memory(); // Should print empty memory
+    fs_dump_memory(&pool); // Should print empty memory
 
     printf("\nTest: Double-free\n");
-    void* ptr = fs_malloc(8);
-    fs_free(ptr);
-    fs_free(ptr); // Should print "Block already free"
+    void* ptr = fs_malloc(&pool, 8);
+    fs_free(&pool, ptr);
+    fs_free(&pool, ptr); // Should print "Block already free"
 
     printf("\nTest: Invalid pointers\n");
-    fs_free(NULL);
-    fs_free((void*)(memory_pool + 7)); // Unaligned
-    fs_free((void*)(memory_pool + POOL_SIZE + 1)); // Out of bounds
+    fs_free(&pool, NULL);
+    fs_free(&pool, (void*)(memory_pool + 7)); // Unaligned
+    fs_free(&pool, (void*)(memory_pool + POOL_SIZE + 1)); // Out of bounds
+
+    printf("\nTest: Independent pools\n");
+    static char other_memory[64 * 4] __attribute__((aligned(8)));
+    fs_pool_t other;
+    fs_init_pool(&other, other_memory, 64, 4); // A second pool with its own block size
+    void* small = fs_malloc(&pool, 32);
+    void* large = fs_malloc(&other, 64);
+    fs_free(&pool, large); // Should print 'Invalid pointer'
+    fs_free(&other, large);
+    fs_free(&pool, small);
+    fs_dump_memory(&other); // Should print empty memory
+
+    printf("\nTest: Batch allocate/free\n");
+    void* batch[BLOCK_COUNT + 1];
+    size_t taken = fs_malloc_batch(&pool, 8, BLOCK_COUNT + 1, batch); // Should print 'Out of memory'
+    printf("\tAllocated %zu blocks in one batch\n", taken);
+    batch[taken] = memory_pool + 7; // Invalid pointers are skipped
+    fs_free_batch(&pool, batch, taken + 1); // Should print 'Invalid pointer'
+    fs_free_batch(&pool, batch, 1); // Should print "Block already free"
+    fs_dump_memory(&pool); // Should print empty memory
+
+    printf("\nTest: Statistics\n");
+    void* held = fs_malloc(&pool, 8);
+    fs_stats_t stats;
+    fs_get_stats(&pool, &stats);
+    printf("\tFree blocks: %zu of %zu\n", stats.free_blocks, stats.block_count); // Should print one less than all
+    printf("\tCounted: %llu mallocs, %llu frees, %llu OOM, %llu invalid frees\n", (unsigned long long)stats.mallocs,
+           (unsigned long long)stats.frees, (unsigned long long)stats.oom,
+           (unsigned long long)stats.invalid_frees); // All 0 without RON_STATS
+    fs_free(&pool, held);
+
+    printf("\nTest: Error codes and log\n");
+    static ron_error_log_t log;
+    ron_set_error_handler(ron_log_error, &log); // Failures are queued instead of printed
+    void* logged = fs_malloc(&pool, 8);
+    fs_free(&pool, logged);
+    fs_free(&pool, logged);
+    printf("\tLast error: %s\n", ron_strerror(ron_last_error())); // Should print 'Block already free'
+    fs_malloc(&pool, BLOCK_SIZE + 1);
+    ron_set_error_handler(ron_print_error, NULL);
+    uint64_t cursor = 0;
+    ron_error_entry_t entries[4];
+    size_t logged_count = ron_read_error_log(&log, &cursor, entries, 4);
+    for (size_t i = 0; i < logged_count; i++)
+    {
+        printf("\tLogged %llu: %s: %s\n", (unsigned long long)entries[i].sequence, entries[i].function,
+               ron_strerror(entries[i].error)); // Should print the double free, then the oversized request
+    }
+    ron_clear_error();
+
+    printf("\nTest: Remote frees\n");
+    void* owned[BLOCK_COUNT + 1] = { NULL };
+    fs_malloc_batch(&pool, BLOCK_SIZE, pool.block_count, owned); // The whole pool
+    pthread_t remote;
+    pthread_create(&remote, NULL, remote_free, owned);
+    pthread_join(remote, NULL);
+    fs_get_stats(&pool, &stats);
+    printf("\tFree blocks before the next allocation: %zu\n", stats.free_blocks); // Should print 0 (all without a queue)
+    void* drained = fs_malloc(&pool, BLOCK_SIZE); // Takes the queue
+    fs_get_stats(&pool, &stats);
+    printf("\tAllocated after draining: %s, free blocks: %zu\n", drained ? "yes" : "no",
+           stats.free_blocks); // Should print yes and one less than all
+    fs_free(&pool, drained);
+    fs_dump_memory(&pool); // Should print empty memory
+
+    printf("\nTest: Sized free\n");
+    void* sized = fs_malloc(&pool, 24);
+    fs_free_sized(&pool, sized, 24);
+    printf("\tBlock reused: %s\n", fs_malloc(&pool, 24) == sized ? "yes" : "no"); // Should print yes
+#ifdef RON_HARDENED
+    fs_free_sized(&pool, sized, BLOCK_SIZE + 1); // Should print 'Size does not match the allocation'
+#endif
+    fs_free_sized(&pool, sized, 24);
+    fs_dump_memory(&pool); // Should print empty memory
+
+    printf("\nTest: Calloc\n");
+    static char zeroed_memory[64 * 4] __attribute__((aligned(8))); // Static storage starts out zero
+    fs_pool_t zeroed;
+    fs_init_pool(&zeroed, zeroed_memory, 64, 4);
+    fs_set_zeroed(&zeroed);
+    unsigned char* cleared = fs_calloc(&zeroed, 8, 8);
+    memset(cleared, 0xAB, 64); // Dirty the block, then hand it out again
+    fs_free(&zeroed, cleared);
+    cleared = fs_calloc(&zeroed, 8, 8);
+    int all_zero = 1;
+    for (size_t i = 0; i < 64; i++)
+        all_zero &= cleared[i] == 0;
+    printf("\tReused block cleared: %s\n", all_zero ? "yes" : "no"); // Should print yes
+    fs_calloc(&zeroed, SIZE_MAX / 2, 4); // Should print 'Request too large for the allocator'
+    fs_free(&zeroed, cleared);
+    fs_dump_memory(&zeroed); // Should print empty memory
+
+#ifdef FS_BITMAP
+    printf("\nTest: Contiguous runs and occupancy\n");
+    fs_stats_t before;
+    fs_get_stats(&pool, &before);
+    void* single = fs_malloc(&pool, BLOCK_SIZE); // The full block is payload
+    void* run = fs_malloc_contiguous(&pool, 3);
+    printf("\tRun starts after the single block: %s\n",
+           (char*)run == (char*)single + BLOCK_SIZE ? "yes" : "no"); // Should print yes
+    printf("\tFree blocks: %zu of %zu\n", fs_free_count(&pool), pool.block_count); // Should print 3 of 7
+    fs_free(&pool, single);
+    fs_malloc_contiguous(&pool, 4); // Should print 'Out of memory' (the free blocks are split)
+    fs_free_contiguous(&pool, run, 3);
+    fs_free_contiguous(&pool, run, 3); // Should print "Block already free"
+    fs_free_contiguous(&pool, run, pool.block_count); // Should print 'Invalid pointer' (past the pool)
+    fs_dump_memory(&pool); // Should print empty memory
+    fs_stats_t after;
+    fs_get_stats(&pool, &after);
+    printf("\tCounted: %llu mallocs, %llu frees, %llu OOM, %llu invalid frees\n",
+           (unsigned long long)(after.mallocs - before.mallocs), (unsigned long long)(after.frees - before.frees),
+           (unsigned long long)(after.oom - before.oom),
+           (unsigned long long)(after.invalid_frees - before.invalid_frees)); // Should print 4, 4, 1, 2 (0 without RON_STATS)
+#endif
+
+#ifdef FS_LOCK_FREE
+    printf("\nTest: Concurrent allocate/free\n");
+    pthread_t threads[STRESS_THREADS];
+    for (size_t i = 0; i < STRESS_THREADS; i++)
+        pthread_create(&threads[i], NULL, stress, (void*)i);
+    for (int i = 0; i < STRESS_THREADS; i++)
+    {
+        void* errors;
+        pthread_join(threads[i], &errors);
+        printf("\tThread %d: %zu errors\n", i, (size_t)errors); // Should print 0
+    }
+    fs_dump_memory(&pool); // Should print empty memory
+#endif
 
     return 0;
 }
+#endif
@@ -0,0 +1,100 @@
+/**
+ * Public interface of the fixed-size pool allocator.
+ * See fixed_size_allocatoron.c for the design notes.
+ */
+
+#ifndef FIXED_SIZE_ALLOCATORON_H
+#define FIXED_SIZE_ALLOCATORON_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(FS_BITMAP) && defined(FS_LOCK_FREE)
+#error "FS_BITMAP and FS_LOCK_FREE are mutually exclusive"
+#endif
+
+#include <stdatomic.h>
+
+/**
+ * A fixed-size pool over a caller-provided memory region.
+ * Pools are independent, so each core, connection or subsystem can own one.
+ *
+ * Fields:
+ * - `memory`: Start of the region. Must be 8-byte aligned.
+ * - `block_size`: Size of each block in bytes.
+ * - `block_count`: Number of blocks in the region (usable ones in the bitmap build).
+ * - `free_list`: Head of the free list (see fixed_size_allocatoron.c). Not used by the bitmap build.
+ * - `bitmap`: One bit per block, set when the block is free (bitmap build only).
+ * - `word_count`: Number of 64-bit words in the bitmap (bitmap build only).
+ * - `hint`: Lowest bitmap word that may have a free block (bitmap build only).
+ * - `remote_frees`: Blocks freed by other threads, waiting for the owner (see fs_free_remote).
+ *   Not used by the lock-free build.
+ * - `fresh`: End of the highest block ever handed out. Blocks past it were never used (see fs_calloc).
+ */
+typedef struct fs_pool_t
+{
+    char* memory;
+    size_t block_size;
+    size_t block_count;
+#if defined(FS_BITMAP)
+    uint64_t* bitmap;
+    size_t word_count;
+    size_t hint;
+#elif defined(FS_LOCK_FREE)
+    _Atomic uint64_t free_list;
+#else
+    struct FreeBlock* free_list;
+#endif
+#ifndef FS_LOCK_FREE
+    _Atomic(void*) remote_frees;
+    char* fresh;
+#else
+    _Atomic(char*) fresh;
+#endif
+} fs_pool_t;
+
+/**
+ * A snapshot taken by fs_get_stats.
+ *
+ * Counters, summed over all threads and pools (0 unless built with RON_STATS):
+ * - `mallocs`, `frees`: Successful allocations and deallocations, batches included.
+ * - `oom`: Allocations (or batches) that found the pool exhausted.
+ * - `invalid_frees`: Frees of invalid or already free pointers.
+ * - `remote_frees`: Blocks queued by fs_free_remote.
+ *
+ * Occupancy of the inspected pool (always available):
+ * - `block_count`: Number of usable blocks.
+ * - `free_blocks`: Number of free blocks.
+ */
+typedef struct fs_stats_t
+{
+    uint64_t mallocs;
+    uint64_t frees;
+    uint64_t oom;
+    uint64_t invalid_frees;
+    uint64_t remote_frees;
+    size_t block_count;
+    size_t free_blocks;
+} fs_stats_t;
+
+int fs_init_pool(fs_pool_t* pool, void* memory, size_t block_size, size_t block_count);
+void* fs_malloc(fs_pool_t* pool, size_t size);
+void* fs_calloc(fs_pool_t* pool, size_t count, size_t size);
+void fs_set_zeroed(fs_pool_t* pool);
+void fs_free(fs_pool_t* pool, void* ptr);
+size_t fs_malloc_batch(fs_pool_t* pool, size_t size, size_t count, void** out);
+void fs_free_sized(fs_pool_t* pool, void* ptr, size_t size);
+void fs_free_batch(fs_pool_t* pool, void** ptrs, size_t count);
+void fs_free_remote(fs_pool_t* pool, void* ptr);
+void fs_drain_remote(fs_pool_t* pool);
+int fs_owns(const fs_pool_t* pool, const void* ptr);
+void fs_get_stats(const fs_pool_t* pool, fs_stats_t* stats);
+void fs_dump_memory(const fs_pool_t* pool);
+
+#ifdef FS_BITMAP
+void* fs_malloc_contiguous(fs_pool_t* pool, size_t count);
+void fs_free_contiguous(fs_pool_t* pool, void* ptr, size_t count);
+size_t fs_free_count(const fs_pool_t* pool);
+#endif
+
+#endif
@@ -0,0 +1,384 @@
+/**
+ * A NUMA-aware allocator: one variable-size heap per memory node.
+ *
+ * - One mapping is reserved for all heaps and cut into equal slices, one per node. Each slice is bound
+ *   to its node before anything touches it, so its pages are placed on that node whichever thread
+ *   faults them in (a plain static pool lands on the node of the first thread that touches it).
+ * - Allocations are served by the heap of the calling thread's node. The node is looked up with
+ *   getcpu and cached per thread for NH_NODE_REFRESH allocations, so a migrated thread follows soon.
+ * - Frees are routed by address, like the slab allocator: a block always goes back to its home heap,
+ *   never to the freeing thread's, so remote memory is not reused locally. Reallocations also stay home.
+ * - Each heap has its own lock, so threads on different nodes do not contend: a free from another node
+ *   is pushed onto the home heap's remote-free queue without the lock (see vs_free_remote) and drained
+ *   by the home node's next allocation that misses. A heap that runs out
+ *   fails the request rather than handing out remote memory: size the slices for each node's share.
+ * - nh_map_region binds any region to a node, for node-local fixed-size pools, slabs or arenas.
+ *
+ * Binding is best-effort: the slices use a preferred policy (a full node spills to others instead of
+ * failing), and on kernels or platforms without NUMA support the allocator runs as a single node.
+ */
+
+#define _GNU_SOURCE // MAP_NORESERVE and syscall are extensions to POSIX
+
+#include "numa_allocatoron.h"
+#include "error_allocatoron.h"
+#include "variable_size_allocatoron.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+
+/**
+ * Parses a sysfs node list such as "0" or "0-1,3".
+ * @return The highest node in the list plus one, or 0 if it could not be read.
+ */
+static int parse_node_list(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return 0;
+
+    int count = 0, node;
+    char separator = ',';
+    while (separator != '\n' && fscanf(file, "%d%c", &node, &separator) == 2)
+    {
+        if (node + 1 > count) // Ranges are ascending, so the last node read is the highest
+            count = node + 1;
+    }
+    fclose(file);
+
+    return count;
+}
+
+/**
+ * Returns the number of memory nodes of the machine. 1 without NUMA support.
+ */
+int nh_node_count()
+{
+    static _Atomic int cached = 0; // Every thread computes the same value, so relaxed accesses suffice
+    int count = atomic_load_explicit(&cached, memory_order_relaxed);
+    if (!count)
+    {
+        count = parse_node_list("/sys/devices/system/node/online");
+        if (count < 1)
+            count = 1;
+        atomic_store_explicit(&cached, count, memory_order_relaxed);
+    }
+    return count;
+}
+
+/**
+ * Returns the memory node of the CPU the calling thread runs on. 0 without NUMA support.
+ * Cached per thread and refreshed every NH_NODE_REFRESH calls.
+ */
+int nh_current_node()
+{
+    static _Thread_local int node = 0;
+    static _Thread_local unsigned int calls = 0;
+
+    if (calls++ % NH_NODE_REFRESH == 0)
+    {
+#ifdef __linux__
+        unsigned int cpu, current;
+        if (syscall(SYS_getcpu, &cpu, &current, NULL) == 0)
+            node = (int)current;
+#endif
+    }
+    return node;
+}
+
+/**
+ * Sets a range's NUMA policy to prefer a node. Pages already faulted in are not moved.
+ */
+static void bind_pages(void* memory, size_t size, int node)
+{
+#ifdef __linux__
+    unsigned long mask = 1UL << node;
+    syscall(SYS_mbind, memory, size, MPOL_PREFERRED, &mask, 8 * sizeof(mask), 0); // Best-effort
+#else
+    (void)memory;
+    (void)size;
+    (void)node;
+#endif
+}
+
+static size_t round_to_pages(size_t size)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (size + page - 1) / page * page;
+}
+
+/**
+ * Maps a region whose pages are placed on a memory node when they are first touched.
+ * Suitable as the memory of any allocator, e.g. a node-local fixed-size pool.
+ * @param size The size of the region in bytes. Rounded up to whole pages.
+ * @param node The node to place the pages on, below nh_node_count()
+ * @return The page-aligned region, or NULL if it could not be mapped.
+ */
+void* nh_map_region(size_t size, int node)
+{
+    if (!size || node < 0 || node >= nh_node_count() || node >= (int)(8 * sizeof(unsigned long)))
+    {
+        RON_ERROR(RON_ECONFIG, NULL);
+        return NULL;
+    }
+
+    size = round_to_pages(size);
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        RON_ERROR(RON_ENOMEM, NULL);
+        return NULL;
+    }
+    bind_pages(memory, size, node);
+
+    return memory;
+}
+
+/**
+ * Unmaps a region returned by nh_map_region.
+ * @param memory The region
+ * @param size The size it was mapped with
+ */
+void nh_unmap_region(void* memory, size_t size)
+{
+    munmap(memory, round_to_pages(size));
+}
+
+/**
+ * Initializes one heap per memory node (at most NH_MAX_NODES).
+ * Address space is reserved for every slice up front, but pages are only committed as they are used.
+ * @param heap The handle to initialize
+ * @param node_size The size of each node's heap in bytes. Rounded up to whole pages.
+ * @return 0 on successful initialization. 1 Otherwise.
+ */
+int nh_init(nh_heap_t* heap, size_t node_size)
+{
+    int node_count = nh_node_count() < NH_MAX_NODES ? nh_node_count() : NH_MAX_NODES;
+    size_t span = round_to_pages(node_size);
+    if (!heap || !node_size || span > SIZE_MAX / (size_t)node_count)
+    {
+        RON_ERROR(RON_ECONFIG, NULL);
+        return 1;
+    }
+
+    char* memory = mmap(NULL, span * (size_t)node_count, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        RON_ERROR(RON_ENOMEM, NULL);
+        return 1;
+    }
+
+    heap->memory = memory;
+    heap->span = span;
+    heap->node_count = node_count;
+    for (int i = 0; i < node_count; i++)
+    {
+        bind_pages(memory + (size_t)i * span, span, i); // Before vs_init_heap writes the first header
+        if (vs_init_heap(&heap->nodes[i].heap, memory + (size_t)i * span, span))
+        {
+            munmap(memory, span * (size_t)node_count);
+            return 1;
+        }
+        pthread_mutex_init(&heap->nodes[i].lock, NULL);
+    }
+
+    return 0;
+}
+
+/**
+ * Unmaps all node heaps. The handle must be re-initialized before it is used again.
+ * @param heap The heap to tear down
+ */
+void nh_destroy(nh_heap_t* heap)
+{
+    for (int i = 0; i < heap->node_count; i++)
+    {
+        vs_destroy_heap(&heap->nodes[i].heap);
+        pthread_mutex_destroy(&heap->nodes[i].lock);
+    }
+    munmap(heap->memory, heap->span * (size_t)heap->node_count);
+    heap->node_count = 0;
+}
+
+/**
+ * Returns the node whose heap a pointer belongs to.
+ * @param heap The heap to check against
+ * @param ptr The pointer to check
+ * @return The node index, or -1 if the pointer is outside every node's slice.
+ */
+int nh_node_of(const nh_heap_t* heap, const void* ptr)
+{
+    if ((const char*)ptr < heap->memory || (const char*)ptr >= heap->memory + heap->span * (size_t)heap->node_count)
+        return -1;
+    return (int)(((const char*)ptr - heap->memory) / heap->span);
+}
+
+/**
+ * Returns the heap of the calling thread's node (nodes beyond NH_MAX_NODES share the last heap).
+ */
+static nh_node_t* local_node(nh_heap_t* heap)
+{
+    int node = nh_current_node();
+    return &heap->nodes[node < heap->node_count ? node : heap->node_count - 1];
+}
+
+/**
+ * Allocates memory on the calling thread's node.
+ * @param heap The heap to allocate from
+ * @param size The size of the memory to allocate
+ * @return A pointer to the allocated usable memory.
+ */
+void* nh_malloc(nh_heap_t* heap, size_t size)
+{
+    nh_node_t* node = local_node(heap);
+
+    pthread_mutex_lock(&node->lock);
+    void* ptr = vs_malloc(&node->heap, size);
+    pthread_mutex_unlock(&node->lock);
+
+    return ptr;
+}
+
+/**
+ * Frees memory into the heap of the node it was allocated on, whichever thread frees it.
+ * Frees from another node are queued and become reusable once the home node's allocations miss.
+ * @param heap The heap the memory was allocated from
+ * @param ptr A pointer to the memory that should be freed
+ */
+void nh_free(nh_heap_t* heap, void* ptr)
+{
+    int home = nh_node_of(heap, ptr);
+    if (home < 0)
+    {
+        RON_ERROR(RON_EINVAL, ptr);
+        return;
+    }
+
+    nh_node_t* node = &heap->nodes[home];
+    if (node != local_node(heap)) // Queued lock-free for the home node
+    {
+        vs_free_remote(&node->heap, ptr);
+        return;
+    }
+    pthread_mutex_lock(&node->lock);
+    vs_free(&node->heap, ptr);
+    pthread_mutex_unlock(&node->lock);
+}
+
+/**
+ * Reallocates memory within the heap of the node it was allocated on.
+ * @param heap The heap the memory was allocated from
+ * @param ptr A pointer to the memory that will be reallocated. NULL allocates on the calling thread's node.
+ * @param new_size The new size of the allocated memory. 0 frees the memory.
+ * @return A pointer to the usable reallocated memory.
+ */
+void* nh_realloc(nh_heap_t* heap, void* ptr, size_t new_size)
+{
+    if (!ptr)
+        return nh_malloc(heap, new_size);
+
+    int home = nh_node_of(heap, ptr);
+    if (home < 0)
+    {
+        RON_ERROR(RON_EINVAL, ptr);
+        return NULL;
+    }
+
+    nh_node_t* node = &heap->nodes[home];
+    pthread_mutex_lock(&node->lock);
+    void* new_ptr = vs_realloc(&node->heap, ptr, new_size);
+    pthread_mutex_unlock(&node->lock);
+
+    return new_ptr;
+}
+
+#ifdef RON_SELF_TEST
+#define NODE_SIZE ((size_t)1 << 20)
+
+/**
+ * Returns the node a touched page actually lives on, or -1 if the kernel can't tell.
+ */
+static int page_node(void* ptr)
+{
+#ifdef __linux__
+    int node;
+    if (syscall(SYS_get_mempolicy, &node, NULL, 0, ptr, MPOL_F_NODE | MPOL_F_ADDR) == 0)
+        return node;
+#else
+    (void)ptr;
+#endif
+    return -1;
+}
+
+static void* remote_free(void* arg)
+{
+    void** args = arg;
+    nh_free(args[0], args[1]);
+    return NULL;
+}
+
+/**
+ * The main function initializes the allocator and acts as a test suite.
+ *
+ * The implemented tests are:
+ * - Allocation on the caller's node
+ * - Frees from another thread go back to the home heap
+ * - Node-bound regions for other allocators
+ * - Invalid pointers
+ */
+int main()
+{
+    ron_set_error_handler(ron_print_error, NULL); // Failures are silent by default
+
+    static nh_heap_t heap;
+    if (nh_init(&heap, NODE_SIZE))
+    {
+        printf("ERROR: Failed to initialize allocator\n");
+        return 1;
+    }
+    printf("\t%d node(s), caller on node %d\n", heap.node_count, nh_current_node());
+
+    printf("\nTest: Allocate on the caller's node\n");
+    char* local = nh_malloc(&heap, 100000);
+    memset(local, 1, 100000); // First touch
+    int node = nh_node_of(&heap, local);
+    int placed = page_node(local + 50000);
+    printf("\tServed by the local heap: %s\n", node == local_node(&heap) - heap.nodes ? "yes" : "no"); // Should print yes
+    printf("\tPages on that node: %s\n", placed < 0 || placed == node ? "yes" : "no"); // Should print yes
+
+    printf("\nTest: Free from another thread\n");
+    void* args[2] = { &heap, local };
+    pthread_t thread;
+    pthread_create(&thread, NULL, remote_free, args);
+    pthread_join(thread, NULL);
+    pthread_mutex_lock(&heap.nodes[node].lock);
+    vs_drain_remote(&heap.nodes[node].heap); // In case the thread ran on another node
+    pthread_mutex_unlock(&heap.nodes[node].lock);
+    vs_dump_memory(&heap.nodes[node].heap); // Should print 1 free block
+
+    printf("\nTest: Node-bound region\n");
+    void* region = nh_map_region(4096, node);
+    memset(region, 0, 4096);
+    placed = page_node(region);
+    printf("\tRegion on node %d: %s\n", node, placed < 0 || placed == node ? "yes" : "no"); // Should print yes
+    nh_unmap_region(region, 4096);
+
+    printf("\nTest: Invalid pointers\n");
+    static char outside[16];
+    nh_free(&heap, outside); // Should print 'Invalid pointer'
+    nh_map_region(4096, nh_node_count()); // Should print 'Invalid allocator configuration'
+
+    nh_destroy(&heap);
+    return 0;
+}
+#endif
@@ -0,0 +1,60 @@
+/**
+ * Public interface of the NUMA-aware allocator: one variable-size heap per memory node.
+ * See numa_allocatoron.c for the design notes.
+ */
+
+#ifndef NUMA_ALLOCATORON_H
+#define NUMA_ALLOCATORON_H
+
+#include "variable_size_allocatoron.h"
+
+#include <pthread.h>
+#include <stddef.h>
+
+#define NH_MAX_NODES 16 // Most memory nodes a heap spreads over. Higher nodes share the last heap.
+#define NH_NODE_REFRESH 4096 // Allocations between two lookups of the calling thread's node
+
+/**
+ * The heap of one memory node.
+ *
+ * Fields:
+ * - `lock`: Guards the heap. Taken by local allocations and frees; frees from other nodes are queued
+ *   lock-free on the heap instead.
+ * - `heap`: Heap over the node's slice of the region, whose pages live on that node.
+ */
+typedef struct nh_node_t
+{
+    pthread_mutex_t lock;
+    vs_heap_t heap;
+} nh_node_t;
+
+/**
+ * A set of node-bound heaps carved out of one mapping.
+ *
+ * Fields:
+ * - `memory`: Start of the mapping.
+ * - `span`: Bytes of the mapping given to each node. Node i owns [memory + i * span, memory + (i + 1) * span).
+ * - `node_count`: Number of nodes (and heaps).
+ * - `nodes`: The per-node heaps.
+ */
+typedef struct nh_heap_t
+{
+    char* memory;
+    size_t span;
+    int node_count;
+    nh_node_t nodes[NH_MAX_NODES];
+} nh_heap_t;
+
+int nh_node_count();
+int nh_current_node();
+void* nh_map_region(size_t size, int node);
+void nh_unmap_region(void* memory, size_t size);
+
+int nh_init(nh_heap_t* heap, size_t node_size);
+void nh_destroy(nh_heap_t* heap);
+void* nh_malloc(nh_heap_t* heap, size_t size);
+void nh_free(nh_heap_t* heap, void* ptr);
+void* nh_realloc(nh_heap_t* heap, void* ptr, size_t new_size);
+int nh_node_of(const nh_heap_t* heap, const void* ptr);
+
+#endif
@@ -0,0 +1,548 @@
+/**
+ * A per-CPU cache layer in front of the slab allocator.
+ *
+ * - Each CPU keeps small magazines (LIFO stacks) of recently freed blocks, one per slab size class
+ * - Allocation and deallocation are served from the magazine of the CPU the thread runs on
+ * - On Linux x86-64 the fast paths are restartable sequences (rseq): no atomics and no locks, the kernel
+ *   restarts a sequence that was preempted, migrated or interrupted by a signal before its commit
+ * - Elsewhere, or if the C library did not register rseq, each CPU's magazines have a spin lock. It is
+ *   only contended by threads that were migrated in the middle of an operation.
+ * - Magazines are refilled from and flushed to the slab's pools with their batch API, under one lock
+ * - Requests above SLAB_MAX_SIZE, and frees of blocks outside the slab region, go straight to the slab
+ *   (and its heap for larger requests) under that lock
+ *
+ * Unlike the thread cache (thread_cache_allocatoron.c), the cached memory scales with the number of CPUs,
+ * not of threads: a thread owns no state, so thousands of mostly idle threads cost nothing, and a thread
+ * exit flushes nothing. Blocks freed on another CPU simply join that CPU's magazine.
+ *
+ * A cached block is only checked for its alignment: a double free is detected once the block returns
+ * to its pool, or not at all if both copies are handed out again first.
+ */
+
+#define _GNU_SOURCE // sched_getcpu
+
+#include "percpu_allocatoron.h"
+#include "error_allocatoron.h"
+#include "fixed_size_allocatoron.h"
+#include "slab_allocatoron.h"
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__x86_64__) && defined(__has_include)
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#define PC_RSEQ
+#endif
+#endif
+
+#ifdef PC_RSEQ
+/**
+ * Restartable sequences.
+ *
+ * The C library registers a struct rseq for every thread; the kernel keeps its cpu_id current. A sequence
+ * reads the CPU number, picks that CPU's magazine, and ends with a single store of the magazine's count
+ * (the commit). Before its first instruction it points rseq_cs at a descriptor of its code range: if the
+ * thread is preempted, migrated or signalled inside the range, the kernel resumes it at the abort handler,
+ * which starts over. The handler must be preceded by RSEQ_SIG, the signature the C library registered.
+ *
+ * The count is only written by the commit, so an aborted sequence leaves the magazine unchanged:
+ * a push writes its block above the count first, where no other sequence reads it.
+ */
+#define RSEQ_DESCRIPTOR(start, commit, abort)                                                                  \
+    ".pushsection __rseq_cs, \"aw\"\n\t"                                                                       \
+    ".balign 32\n\t"                                                                                           \
+    "3:\n\t"                                                                                                   \
+    ".long 0, 0\n\t" /* version, flags */                                                                      \
+    ".quad " start ", " commit " - " start ", " abort "\n\t"                                                   \
+    ".popsection\n\t"                                                                                          \
+    "leaq 3b(%%rip), %%rax\n\t"                                                                                \
+    "movq %%rax, %c[rseq_cs](%[rs])\n\t"
+
+#define RSEQ_ABORT_HANDLER(abort, label)                                                                       \
+    ".pushsection __rseq_failure, \"ax\"\n\t"                                                                  \
+    ".byte 0x0f, 0xb9, 0x3d\n\t" /* ud1 with the signature as operand, never executed */                       \
+    ".long " RSEQ_STRINGIFY(RSEQ_SIG) "\n\t"                                                                   \
+    abort ":\n\t"                                                                                              \
+    "jmp %l[" label "]\n\t"                                                                                    \
+    ".popsection\n\t"
+
+#define RSEQ_STRINGIFY(x) RSEQ_STRINGIFY_(x)
+#define RSEQ_STRINGIFY_(x) #x
+
+static struct rseq* thread_rseq()
+{
+    return (struct rseq*)((char*)__builtin_thread_pointer() + __rseq_offset);
+}
+
+/**
+ * Pops the top block of a CPU's magazine.
+ * @return 1 if a block was stored to out, 0 if the magazine is empty, -1 if the sequence was aborted.
+ */
+static int rseq_pop(struct rseq* rs, uint32_t cpu, pc_magazine_t* magazine, void** out)
+{
+    __asm__ goto(RSEQ_DESCRIPTOR("1f", "2f", "4f")
+                 "1:\n\t"
+                 "cmpl %[cpu], %c[cpu_id](%[rs])\n\t" // The thread moved since cpu was read
+                 "jnz %l[aborted]\n\t"
+                 "movq (%[magazine]), %%rcx\n\t"
+                 "testq %%rcx, %%rcx\n\t"
+                 "jz %l[empty]\n\t"
+                 "movq (%[magazine], %%rcx, 8), %%rax\n\t" // blocks[count - 1]
+                 "movq %%rax, (%[out])\n\t"
+                 "decq %%rcx\n\t"
+                 "movq %%rcx, (%[magazine])\n\t" // Commit
+                 "2:\n\t"
+                 RSEQ_ABORT_HANDLER("4", "aborted")
+                 :
+                 : [rs] "r"(rs), [cpu] "r"(cpu), [magazine] "r"(magazine), [out] "r"(out),
+                   [cpu_id] "i"(offsetof(struct rseq, cpu_id)), [rseq_cs] "i"(offsetof(struct rseq, rseq_cs))
+                 : "rax", "rcx", "memory", "cc"
+                 : empty, aborted);
+    return 1;
+empty:
+    return 0;
+aborted:
+    return -1;
+}
+
+/**
+ * Pushes a block onto a CPU's magazine.
+ * @return 1 if the block was cached, 0 if the magazine is full, -1 if the sequence was aborted.
+ */
+static int rseq_push(struct rseq* rs, uint32_t cpu, pc_magazine_t* magazine, void* ptr)
+{
+    __asm__ goto(RSEQ_DESCRIPTOR("1f", "2f", "4f")
+                 "1:\n\t"
+                 "cmpl %[cpu], %c[cpu_id](%[rs])\n\t"
+                 "jnz %l[aborted]\n\t"
+                 "movq (%[magazine]), %%rcx\n\t"
+                 "cmpq $%c[capacity], %%rcx\n\t"
+                 "jae %l[full]\n\t"
+                 "movq %[ptr], 8(%[magazine], %%rcx, 8)\n\t" // blocks[count]
+                 "incq %%rcx\n\t"
+                 "movq %%rcx, (%[magazine])\n\t" // Commit
+                 "2:\n\t"
+                 RSEQ_ABORT_HANDLER("4", "aborted")
+                 :
+                 : [rs] "r"(rs), [cpu] "r"(cpu), [magazine] "r"(magazine), [ptr] "r"(ptr),
+                   [capacity] "i"(PC_MAGAZINE_SIZE), [cpu_id] "i"(offsetof(struct rseq, cpu_id)),
+                   [rseq_cs] "i"(offsetof(struct rseq, rseq_cs))
+                 : "rax", "rcx", "memory", "cc"
+                 : full, aborted);
+    return 1;
+full:
+    return 0;
+aborted:
+    return -1;
+}
+
+/**
+ * Returns the CPU the calling thread last ran on, as seen by its rseq area.
+ */
+static uint32_t rseq_cpu(struct rseq* rs)
+{
+    return __atomic_load_n(&rs->cpu_id_start, __ATOMIC_RELAXED);
+}
+#endif
+
+/**
+ * Takes the spin lock of the calling thread's CPU.
+ * @return The locked CPU, or NULL if the CPU has no cache.
+ */
+static pc_cpu_t* lock_cpu(pc_heap_t* heap)
+{
+#ifdef __linux__
+    int cpu = sched_getcpu();
+#else
+    int cpu = 0;
+#endif
+    if (cpu < 0 || (size_t)cpu >= heap->cpu_count)
+        return NULL;
+
+    pc_cpu_t* locked = &heap->cpus[cpu];
+    while (atomic_exchange_explicit(&locked->lock, 1, memory_order_acquire))
+    {
+        while (atomic_load_explicit(&locked->lock, memory_order_relaxed)) // Spin on a load, not on the exchange
+            ;
+    }
+    return locked;
+}
+
+static void unlock_cpu(pc_cpu_t* locked)
+{
+    atomic_store_explicit(&locked->lock, 0, memory_order_release);
+}
+
+/**
+ * Takes the top block of a class from the calling thread's CPU.
+ * @return 1 if a block was stored to out, 0 if the magazine is empty or the CPU has no cache.
+ */
+static int cache_pop(pc_heap_t* heap, size_t class_index, void** out)
+{
+#ifdef PC_RSEQ
+    if (heap->rseq)
+    {
+        struct rseq* rs = thread_rseq();
+        int result;
+        do
+        {
+            uint32_t cpu = rseq_cpu(rs);
+            if (cpu >= heap->cpu_count)
+                return 0;
+            result = rseq_pop(rs, cpu, &heap->cpus[cpu].classes[class_index], out);
+        } while (result < 0); // Preempted, migrated or signalled: start over on the current CPU
+        return result;
+    }
+#endif
+
+    pc_cpu_t* cpu = lock_cpu(heap);
+    if (!cpu)
+        return 0;
+
+    pc_magazine_t* magazine = &cpu->classes[class_index];
+    int popped = magazine->count > 0;
+    if (popped)
+        *out = magazine->blocks[--magazine->count];
+    unlock_cpu(cpu);
+    return popped;
+}
+
+/**
+ * Caches a block of a class on the calling thread's CPU.
+ * @return 1 if the block was cached, 0 if the magazine is full or the CPU has no cache.
+ */
+static int cache_push(pc_heap_t* heap, size_t class_index, void* ptr)
+{
+#ifdef PC_RSEQ
+    if (heap->rseq)
+    {
+        struct rseq* rs = thread_rseq();
+        int result;
+        do
+        {
+            uint32_t cpu = rseq_cpu(rs);
+            if (cpu >= heap->cpu_count)
+                return 0;
+            result = rseq_push(rs, cpu, &heap->cpus[cpu].classes[class_index], ptr);
+        } while (result < 0);
+        return result;
+    }
+#endif
+
+    pc_cpu_t* cpu = lock_cpu(heap);
+    if (!cpu)
+        return 0;
+
+    pc_magazine_t* magazine = &cpu->classes[class_index];
+    int pushed = magazine->count < PC_MAGAZINE_SIZE;
+    if (pushed)
+        magazine->blocks[magazine->count++] = ptr;
+    unlock_cpu(cpu);
+    return pushed;
+}
+
+/**
+ * Returns blocks of one class to its pool in one batch.
+ */
+static void release_blocks(pc_heap_t* heap, size_t class_index, void** blocks, size_t count)
+{
+    pthread_mutex_lock(&heap->lock);
+    fs_free_batch(&heap->slab->classes[class_index], blocks, count);
+    pthread_mutex_unlock(&heap->lock);
+}
+
+/**
+ * Initializes a per-CPU cache layer over a slab allocator.
+ * The caches are mapped for every configured CPU, so threads on any CPU can use them.
+ * @param heap The handle to initialize
+ * @param slab The shared slab allocator, with a heap for larger requests if those are needed.
+ *             Must not be used directly while the layer is in use.
+ * @return 0 on successful initialization. 1 Otherwise.
+ */
+int pc_init(pc_heap_t* heap, slab_t* slab)
+{
+    if (!heap || !slab)
+    {
+        RON_ERROR(RON_ECONFIG, NULL);
+        return 1;
+    }
+
+    long configured = sysconf(_SC_NPROCESSORS_CONF);
+    heap->cpu_count = configured > 0 ? (size_t)configured : 1;
+    heap->cpus = mmap(NULL, heap->cpu_count * sizeof(pc_cpu_t), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0); // Zero pages: empty magazines, unlocked
+    if (heap->cpus == MAP_FAILED)
+    {
+        heap->cpus = NULL;
+        RON_ERROR(RON_ENOMEM, NULL);
+        return 1;
+    }
+
+    heap->slab = slab;
+    pthread_mutex_init(&heap->lock, NULL);
+#ifdef PC_RSEQ
+    heap->rseq = __rseq_size > 0; // 0 if registration was disabled, e.g. with the glibc.pthread.rseq tunable
+#else
+    heap->rseq = 0;
+#endif
+    return 0;
+}
+
+/**
+ * Returns every cached block to the slab and unmaps the caches.
+ * No thread may use the layer during or after the call.
+ * @param heap The per-CPU heap to destroy
+ */
+void pc_destroy(pc_heap_t* heap)
+{
+    for (size_t cpu = 0; cpu < heap->cpu_count; cpu++)
+    {
+        for (size_t i = 0; i < SLAB_CLASS_COUNT; i++)
+        {
+            pc_magazine_t* magazine = &heap->cpus[cpu].classes[i];
+            if (magazine->count)
+                release_blocks(heap, i, magazine->blocks, magazine->count);
+        }
+    }
+
+    munmap(heap->cpus, heap->cpu_count * sizeof(pc_cpu_t));
+    heap->cpus = NULL;
+    heap->cpu_count = 0;
+    pthread_mutex_destroy(&heap->lock);
+}
+
+/**
+ * Allocates memory from the calling thread's CPU cache.
+ * On a miss, a batch of blocks is taken from the class's pool: one is returned and the others are cached.
+ * @param heap The per-CPU heap to allocate from
+ * @param size The size of the memory to allocate
+ * @return A pointer to the usable allocated memory
+ */
+void* pc_malloc(pc_heap_t* heap, size_t size)
+{
+    void* ptr;
+    if (size > SLAB_MAX_SIZE) // Not cached
+    {
+        pthread_mutex_lock(&heap->lock);
+        ptr = slab_malloc(heap->slab, size);
+        pthread_mutex_unlock(&heap->lock);
+        return ptr;
+    }
+
+    size_t class_index = slab_class_index(size);
+    if (cache_pop(heap, class_index, &ptr))
+        return ptr;
+
+    void* blocks[PC_BATCH_SIZE];
+    pthread_mutex_lock(&heap->lock);
+    size_t taken = fs_malloc_batch(&heap->slab->classes[class_index], size, PC_BATCH_SIZE, blocks);
+    ptr = taken ? blocks[0] : slab_malloc(heap->slab, size); // An exhausted class spills to the slab's heap
+    pthread_mutex_unlock(&heap->lock);
+
+    // The rest of the batch goes to whichever CPU the thread is on now
+    size_t cached = 1;
+    while (cached < taken && cache_push(heap, class_index, blocks[cached]))
+        cached++;
+    if (cached < taken)
+        release_blocks(heap, class_index, blocks + cached, taken - cached);
+
+    return ptr;
+}
+
+/**
+ * Frees memory into the calling thread's CPU cache.
+ * The memory may have been allocated on any CPU. A full magazine first returns a batch to the pool.
+ * @param heap The per-CPU heap the memory was allocated from
+ * @param ptr A pointer to the used memory
+ */
+void pc_free(pc_heap_t* heap, void* ptr)
+{
+    size_t class_index = slab_owns(heap->slab, ptr) ? (size_t)((char*)ptr - heap->slab->memory) / heap->slab->span
+                                                    : SLAB_CLASS_COUNT;
+
+    // Served by the slab's heap, or invalid - Let the slab handle it
+    if (class_index == SLAB_CLASS_COUNT || !fs_owns(&heap->slab->classes[class_index], ptr))
+    {
+        pthread_mutex_lock(&heap->lock);
+        slab_free(heap->slab, ptr);
+        pthread_mutex_unlock(&heap->lock);
+        return;
+    }
+
+    if (cache_push(heap, class_index, ptr))
+        return;
+
+    void* blocks[PC_BATCH_SIZE];
+    size_t count = 0;
+    while (count < PC_BATCH_SIZE && cache_pop(heap, class_index, &blocks[count]))
+        count++;
+    if (count)
+        release_blocks(heap, class_index, blocks, count);
+
+    if (!cache_push(heap, class_index, ptr)) // Refilled meanwhile by other threads, or no cache
+        release_blocks(heap, class_index, &ptr, 1);
+}
+
+/**
+ * Returns the blocks cached by the calling thread's CPU to the slab.
+ * Blocks cached later, or by other CPUs, stay cached until pc_destroy.
+ * @param heap The per-CPU heap to flush
+ */
+void pc_flush(pc_heap_t* heap)
+{
+    for (size_t i = 0; i < SLAB_CLASS_COUNT; i++)
+    {
+        void* blocks[PC_BATCH_SIZE];
+        size_t count;
+        do
+        {
+            count = 0;
+            while (count < PC_BATCH_SIZE && cache_pop(heap, i, &blocks[count]))
+                count++;
+            if (count)
+                release_blocks(heap, i, blocks, count);
+        } while (count == PC_BATCH_SIZE);
+    }
+}
+
+#ifdef RON_SELF_TEST
+#include "variable_size_allocatoron.h"
+
+#define SLAB_POOL_SIZE (SLAB_CLASS_COUNT * SLAB_MIN_SPAN * 2)
+#define HEAP_POOL_SIZE 16384
+#define THREAD_COUNT 64 // Far more threads than CPUs: the caches do not grow with them
+#define CHURN_ITERATIONS 20000
+
+static char slab_memory[SLAB_POOL_SIZE] __attribute__((aligned(8)));
+static char heap_memory[HEAP_POOL_SIZE] __attribute__((aligned(8)));
+
+static pc_heap_t pc;
+static void* handoff[PC_MAGAZINE_SIZE * 2];
+
+static void* producer(void* arg)
+{
+    (void)arg;
+    for (size_t i = 0; i < sizeof(handoff) / sizeof(handoff[0]); i++)
+        handoff[i] = pc_malloc(&pc, 40);
+    return NULL;
+}
+
+static void* consumer(void* arg)
+{
+    (void)arg;
+    for (size_t i = 0; i < sizeof(handoff) / sizeof(handoff[0]); i++)
+        pc_free(&pc, handoff[i]);
+    return NULL; // Nothing to flush on exit: the blocks stay with the CPU
+}
+
+static void* churn(void* arg)
+{
+    size_t failures = 0;
+    for (int i = 0; i < CHURN_ITERATIONS; i++)
+    {
+        size_t size = (size_t)(i % 7 + 1) * 24;
+        unsigned char* a = pc_malloc(&pc, size);
+        unsigned char* b = pc_malloc(&pc, size * 3);
+        if (!a || !b)
+        {
+            failures++;
+            continue;
+        }
+        a[0] = b[0] = (unsigned char)(size_t)arg;
+        if (a == b || a[0] != (unsigned char)(size_t)arg) // Two threads handed the same block
+            failures++;
+        pc_free(&pc, b);
+        pc_free(&pc, a);
+    }
+    return (void*)failures;
+}
+
+/**
+ * Returns the number of used blocks over all size classes of the slab.
+ */
+static size_t used_blocks(const slab_t* slab)
+{
+    size_t used = 0;
+    for (size_t i = 0; i < SLAB_CLASS_COUNT; i++)
+    {
+        fs_stats_t stats;
+        fs_get_stats(&slab->classes[i], &stats);
+        used += stats.block_count - stats.free_blocks;
+    }
+    return used;
+}
+
+/**
+ * The main function initializes the allocators and acts as a test suite.
+ *
+ * The implemented tests are:
+ * - Allocation and reuse through the CPU cache
+ * - Cross-thread frees
+ * - Concurrent churn on many more threads than CPUs
+ * - Requests the caches do not serve
+ * - Flushing and destroying the caches
+ */
+int main()
+{
+    ron_set_error_handler(ron_print_error, NULL); // Failures are silent by default
+
+    static vs_heap_t heap;
+    static slab_t slab;
+    if (vs_init_heap(&heap, heap_memory, HEAP_POOL_SIZE) || slab_init(&slab, slab_memory, SLAB_POOL_SIZE, &heap) ||
+        pc_init(&pc, &slab))
+    {
+        printf("ERROR: Failed to initialize allocator\n");
+        return 1;
+    }
+    printf("Fast paths: %s\n", pc.rseq ? "restartable sequences" : "per-CPU spin locks");
+
+    printf("\nTest: Reuse through the CPU cache\n");
+    void* first = pc_malloc(&pc, 100);
+    printf("\tBlocks taken from the pool: %zu\n", used_blocks(&slab)); // Should print PC_BATCH_SIZE (8)
+    pc_free(&pc, first);
+    printf("\tFreed block reused: %s\n", pc_malloc(&pc, 100) == first ? "yes" : "no"); // Should print yes
+    pc_free(&pc, first);
+
+    printf("\nTest: Allocate on one thread, free on another\n");
+    pthread_t thread;
+    pthread_create(&thread, NULL, producer, NULL);
+    pthread_join(thread, NULL);
+    pthread_create(&thread, NULL, consumer, NULL);
+    pthread_join(thread, NULL);
+    pc_flush(&pc);
+    printf("\tUsed blocks after the flush: %zu\n", used_blocks(&slab)); // Should print 0 (on a single CPU)
+
+    printf("\nTest: Concurrent churn\n");
+    pthread_t threads[THREAD_COUNT];
+    size_t failures = 0;
+    for (size_t i = 0; i < THREAD_COUNT; i++)
+        pthread_create(&threads[i], NULL, churn, (void*)(i + 1));
+    for (size_t i = 0; i < THREAD_COUNT; i++)
+    {
+        void* result;
+        pthread_join(threads[i], &result);
+        failures += (size_t)result;
+    }
+    printf("\tFailed or shared allocations: %zu\n", failures); // Should print 0
+    printf("\tCached blocks within the per-CPU bound: %s\n",
+           used_blocks(&slab) <= (size_t)PC_MAGAZINE_SIZE * SLAB_CLASS_COUNT * pc.cpu_count ? "yes" : "no"); // Should print yes
+
+    printf("\nTest: Uncached requests\n");
+    void* big = pc_malloc(&pc, 5000);
+    printf("\tRequest 5000 served by the heap: %s\n", vs_owns(&heap, big) ? "yes" : "no"); // Should print yes
+    pc_free(&pc, big);
+    pc_free(&pc, slab_memory + 1); // Should print 'Invalid pointer' (not a block start)
+
+    printf("\nTest: Destroy\n");
+    pc_destroy(&pc);
+    printf("\tUsed blocks: %zu\n", used_blocks(&slab)); // Should print 0
+    vs_dump_memory(&heap); // Should print 1 free block
+
+    return 0;
+}
+#endif
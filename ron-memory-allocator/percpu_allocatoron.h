@@ -0,0 +1,65 @@
+/**
+ * Public interface of the per-CPU cache layer in front of the slab allocator.
+ * See percpu_allocatoron.c for the design notes.
+ */
+
+#ifndef PERCPU_ALLOCATORON_H
+#define PERCPU_ALLOCATORON_H
+
+#include "slab_allocatoron.h"
+
+#include <pthread.h>
+#include <stddef.h>
+
+#define PC_MAGAZINE_SIZE 15 // Blocks a CPU may cache per size class
+#define PC_BATCH_SIZE 8 // Blocks moved per refill/flush of a magazine
+
+/**
+ * A LIFO stack of cached blocks of one size class. A cached block still counts as used by its pool.
+ * The count is the commit word of the restartable sequences, so it comes first (see percpu_allocatoron.c).
+ */
+typedef struct pc_magazine_t
+{
+    size_t count;
+    void* blocks[PC_MAGAZINE_SIZE];
+} pc_magazine_t;
+
+/**
+ * The caches of one CPU, on their own cache lines.
+ *
+ * Fields:
+ * - `lock`: Spin lock guarding the magazines when restartable sequences are not available. Unused otherwise.
+ * - `classes`: One magazine per slab size class.
+ */
+typedef struct pc_cpu_t
+{
+    _Alignas(64) _Atomic int lock;
+    pc_magazine_t classes[SLAB_CLASS_COUNT];
+} pc_cpu_t;
+
+/**
+ * A slab allocator shared by all threads, with one cache per CPU in front of it.
+ *
+ * Fields:
+ * - `slab`: The shared allocator. Only reached under `lock`: on refills, flushes and uncached requests.
+ * - `lock`: Guards `slab` and its heap for larger requests.
+ * - `cpus`: The per-CPU caches, mapped by pc_init.
+ * - `cpu_count`: Number of entries in `cpus`. Threads on higher CPUs bypass the caches.
+ * - `rseq`: 1 if the fast paths run as restartable sequences, 0 if they take the CPU's spin lock.
+ */
+typedef struct pc_heap_t
+{
+    slab_t* slab;
+    pthread_mutex_t lock;
+    pc_cpu_t* cpus;
+    size_t cpu_count;
+    int rseq;
+} pc_heap_t;
+
+int pc_init(pc_heap_t* heap, slab_t* slab);
+void pc_destroy(pc_heap_t* heap);
+void* pc_malloc(pc_heap_t* heap, size_t size);
+void pc_free(pc_heap_t* heap, void* ptr);
+void pc_flush(pc_heap_t* heap);
+
+#endif
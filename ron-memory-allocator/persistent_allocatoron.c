@@ -0,0 +1,848 @@
+/**
+ * A persistent variable-size heap: the pool is a memory-mapped file that outlives the process.
+ *
+ * - The file starts with a ph_header_t (format, clean flag, root object, free index), followed by blocks
+ *   in the format of the variable-size allocator: a size-and-flags header word, a footer in free blocks,
+ *   and a zero-sized used sentinel at the end of the file
+ * - Position-independent: the free lists link blocks by their offset from the start of the file, never by
+ *   address, so a restarted process can map the file anywhere and allocate right away
+ * - Clients link their own data the same way (ph_offset/ph_pointer) and reach it from the root object
+ *   slot (ph_set_root/ph_root), so structures built in the heap survive a restart without re-serialization
+ * - Two-level segregated-fit index, good-fit allocation, splitting and bidirectional coalescing, as in vs_malloc
+ * - Crash handling: the header's clean flag is cleared while the file is open. A file that was not closed
+ *   cleanly gets its free index rebuilt by ph_open from the boundary tags, which describe the whole block
+ *   sequence. A sequence that does not end exactly at the sentinel is refused.
+ * - One process at a time: the file is locked with flock while it is mapped
+ *
+ * Durability is the page cache's: ph_sync and ph_close write the mapping back with msync, and a process
+ * crash loses nothing the kernel already holds. An operation interrupted by a machine crash is not rolled back.
+ * Like vs_heap_t, a heap is not thread-safe.
+ */
+
+#define _GNU_SOURCE // flock is an extension to POSIX
+
+#include "persistent_allocatoron.h"
+#include "error_allocatoron.h"
+
+#include <fcntl.h>
+#include <stdio.h> // Used by ph_dump_memory
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ALIGN_SIZE_LOG2 PH_ALIGN_SIZE_LOG2 // Payload sizes are rounded up to multiples of 8 bytes
+#define ALIGN_SIZE ((uint64_t)1 << ALIGN_SIZE_LOG2)
+#define SL_INDEX_COUNT_LOG2 PH_SL_INDEX_COUNT_LOG2
+#define SL_INDEX_COUNT PH_SL_INDEX_COUNT
+#define FL_INDEX_COUNT PH_FL_INDEX_COUNT
+#define FL_INDEX_SHIFT (SL_INDEX_COUNT_LOG2 + ALIGN_SIZE_LOG2)
+#define SMALL_BLOCK_SIZE ((uint64_t)1 << FL_INDEX_SHIFT)
+
+/**
+ * A block of the file. Same layout as the MemBlock of the variable-size allocator,
+ * except that the free-list links are file offsets (0 for the end of a list).
+ *
+ * Fields:
+ * - `header`: The payload size in bytes, combined with BLOCK_USED and BLOCK_PREV_USED.
+ * - `next_free`: Offset of the next free block in the same bucket (free blocks only, in the payload).
+ * - `prev_free`: Offset of the previous free block in the same bucket (free blocks only, in the payload).
+ */
+typedef struct PhBlock
+{
+    uint64_t header;
+    uint64_t next_free;
+    uint64_t prev_free;
+} PhBlock;
+
+#define BLOCK_USED ((uint64_t)1) // The block is in use
+#define BLOCK_PREV_USED ((uint64_t)2) // The physically previous block is in use (no footer to read)
+#define BLOCK_FLAGS (BLOCK_USED | BLOCK_PREV_USED)
+
+#define BLOCK_HEADER_SIZE offsetof(PhBlock, next_free) // Overhead of a used block
+
+// A free block must hold its free-list links and its footer
+#define MIN_BLOCK_SIZE (sizeof(PhBlock) - BLOCK_HEADER_SIZE + sizeof(uint64_t))
+
+// Largest payload the free index can describe
+#define MAX_BLOCK_SIZE (((uint64_t)1 << PH_FL_INDEX_MAX) - BLOCK_HEADER_SIZE)
+
+// The blocks start right after the file header
+#define FIRST_BLOCK_OFFSET ((sizeof(ph_header_t) + ALIGN_SIZE - 1) & ~(ALIGN_SIZE - 1))
+
+// Smallest file that holds the header, one minimal block and the sentinel
+#define MIN_FILE_SIZE (FIRST_BLOCK_OFFSET + 2 * BLOCK_HEADER_SIZE + MIN_BLOCK_SIZE)
+
+static ph_header_t* file_header(const ph_heap_t* heap)
+{
+    return (ph_header_t*)heap->base;
+}
+
+static PhBlock* block_at(const ph_heap_t* heap, uint64_t offset)
+{
+    return offset ? (PhBlock*)(heap->base + offset) : NULL;
+}
+
+static uint64_t block_offset(const ph_heap_t* heap, const PhBlock* block)
+{
+    return block ? (uint64_t)((const char*)block - heap->base) : 0;
+}
+
+static PhBlock* first_block(const ph_heap_t* heap)
+{
+    return (PhBlock*)(heap->base + FIRST_BLOCK_OFFSET);
+}
+
+static PhBlock* sentinel_block(const ph_heap_t* heap)
+{
+    return (PhBlock*)(heap->base + heap->size - BLOCK_HEADER_SIZE);
+}
+
+static uint64_t block_size(const PhBlock* block)
+{
+    return block->header & ~BLOCK_FLAGS;
+}
+
+static void block_set_size(PhBlock* block, uint64_t size)
+{
+    block->header = size | (block->header & BLOCK_FLAGS);
+}
+
+static int block_is_used(const PhBlock* block)
+{
+    return (block->header & BLOCK_USED) != 0;
+}
+
+static int block_is_prev_used(const PhBlock* block)
+{
+    return (block->header & BLOCK_PREV_USED) != 0;
+}
+
+static void* block_to_ptr(const PhBlock* block)
+{
+    return (char*)block + BLOCK_HEADER_SIZE;
+}
+
+static PhBlock* block_from_ptr(const void* ptr)
+{
+    return (PhBlock*)((char*)ptr - BLOCK_HEADER_SIZE);
+}
+
+/**
+ * Returns the physically next block. The file ends with a used sentinel, so the result is always valid.
+ */
+static PhBlock* block_next(const PhBlock* block)
+{
+    return (PhBlock*)((char*)block_to_ptr(block) + block_size(block));
+}
+
+/**
+ * Returns the physically previous block. Only valid when that block is free (BLOCK_PREV_USED clear).
+ */
+static PhBlock* block_prev(const PhBlock* block)
+{
+    uint64_t prev_size = *((const uint64_t*)block - 1); // Footer of the previous block
+    return (PhBlock*)((char*)block - prev_size - BLOCK_HEADER_SIZE);
+}
+
+/**
+ * Marks a block as free: clears its used flag, writes its footer and informs the next block.
+ */
+static void block_mark_free(PhBlock* block)
+{
+    PhBlock* next = block_next(block);
+    block->header &= ~BLOCK_USED;
+    *((uint64_t*)next - 1) = block_size(block);
+    next->header &= ~BLOCK_PREV_USED;
+}
+
+/**
+ * Marks a block as used and informs the next block that it no longer has a footer to read.
+ */
+static void block_mark_used(PhBlock* block)
+{
+    block->header |= BLOCK_USED;
+    block_next(block)->header |= BLOCK_PREV_USED;
+}
+
+/**
+ * Rounds a requested size up to the allocator's alignment.
+ */
+static uint64_t align_size(uint64_t size)
+{
+    if (size < MIN_BLOCK_SIZE)
+        return MIN_BLOCK_SIZE;
+    return (size + (ALIGN_SIZE - 1)) & ~(ALIGN_SIZE - 1);
+}
+
+/**
+ * Returns the index of the most significant set bit (size must be non-zero).
+ */
+static int fls_size(uint64_t size)
+{
+    return 63 - __builtin_clzll((unsigned long long)size);
+}
+
+/**
+ * Computes the bucket a block of the given size belongs to.
+ */
+static void mapping_insert(uint64_t size, int* fl, int* sl)
+{
+    if (size < SMALL_BLOCK_SIZE)
+    {
+        // Small sizes share the first class and are split linearly
+        *fl = 0;
+        *sl = (int)(size / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT));
+    }
+    else
+    {
+        int bit = fls_size(size);
+        *sl = (int)(size >> (bit - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+        *fl = bit - (FL_INDEX_SHIFT - 1);
+    }
+}
+
+/**
+ * Computes the first bucket whose every block is guaranteed to fit the given size.
+ */
+static void mapping_search(uint64_t size, int* fl, int* sl)
+{
+    if (size >= SMALL_BLOCK_SIZE)
+        size += ((uint64_t)1 << (fls_size(size) - SL_INDEX_COUNT_LOG2)) - 1;
+    mapping_insert(size, fl, sl);
+}
+
+/**
+ * Finds a non-empty bucket at or above [fl][sl] using find-first-set on the bitmaps.
+ * @return The head of that bucket, or NULL if no free block is large enough.
+ */
+static PhBlock* search_suitable_block(const ph_heap_t* heap, int* fl, int* sl)
+{
+    const ph_header_t* header = file_header(heap);
+    if (*fl >= FL_INDEX_COUNT)
+        return NULL;
+
+    // Look for a non-empty bucket in the same first-level class
+    uint32_t sl_map = header->sl_bitmap[*fl] & (~0U << *sl);
+    if (!sl_map)
+    {
+        // Fall back to the next non-empty first-level class
+        uint64_t fl_map = (*fl + 1 < FL_INDEX_COUNT) ? header->fl_bitmap & (~0ULL << (*fl + 1)) : 0;
+        if (!fl_map)
+            return NULL;
+
+        *fl = __builtin_ctzll(fl_map);
+        sl_map = header->sl_bitmap[*fl];
+    }
+    *sl = __builtin_ctz(sl_map);
+
+    return block_at(heap, header->free_blocks[*fl][*sl]);
+}
+
+/**
+ * Links a free block into the head of its bucket and updates the bitmaps.
+ */
+static void insert_free_block(ph_heap_t* heap, PhBlock* block)
+{
+    ph_header_t* header = file_header(heap);
+    int fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+
+    block->prev_free = 0;
+    block->next_free = header->free_blocks[fl][sl];
+    if (block->next_free)
+        block_at(heap, block->next_free)->prev_free = block_offset(heap, block);
+    header->free_blocks[fl][sl] = block_offset(heap, block);
+
+    header->fl_bitmap |= 1ULL << fl;
+    header->sl_bitmap[fl] |= 1U << sl;
+}
+
+/**
+ * Unlinks a free block from its bucket and clears the bitmaps if the bucket becomes empty.
+ */
+static void remove_free_block(ph_heap_t* heap, PhBlock* block)
+{
+    ph_header_t* header = file_header(heap);
+    int fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+
+    if (block->prev_free)
+        block_at(heap, block->prev_free)->next_free = block->next_free;
+    else
+        header->free_blocks[fl][sl] = block->next_free;
+    if (block->next_free)
+        block_at(heap, block->next_free)->prev_free = block->prev_free;
+
+    if (!header->free_blocks[fl][sl])
+    {
+        header->sl_bitmap[fl] &= ~(1U << sl);
+        if (!header->sl_bitmap[fl])
+            header->fl_bitmap &= ~(1ULL << fl);
+    }
+}
+
+/**
+ * Absorbs the physically next block, which must be free, into this block.
+ * The merged neighbour leaves the free index. The caller is responsible for the flags of what follows.
+ */
+static void merge_next(ph_heap_t* heap, PhBlock* block)
+{
+    PhBlock* next = block_next(block);
+    remove_free_block(heap, next);
+    block_set_size(block, block_size(block) + BLOCK_HEADER_SIZE + block_size(next));
+}
+
+/**
+ * Splits the tail of a used block into a new free block if the surplus fits a header and a minimal payload.
+ * The remainder is merged with a free successor and inserted into the free index.
+ * @param block The block to trim. Must be marked used.
+ * @param size The payload size the block keeps.
+ */
+static void split_block(ph_heap_t* heap, PhBlock* block, uint64_t size)
+{
+    if (block_size(block) < size + BLOCK_HEADER_SIZE + MIN_BLOCK_SIZE)
+        return;
+
+    PhBlock* rem = (PhBlock*)((char*)block_to_ptr(block) + size);
+    rem->header = (block_size(block) - size - BLOCK_HEADER_SIZE) | BLOCK_PREV_USED;
+    block_set_size(block, size);
+
+    // Keep the invariant that no two free blocks are adjacent
+    if (!block_is_used(block_next(rem)))
+        merge_next(heap, rem);
+
+    block_mark_free(rem);
+    insert_free_block(heap, rem);
+}
+
+/**
+ * Coalesces a used block with its free neighbours and returns the result to the free index.
+ */
+static void free_block(ph_heap_t* heap, PhBlock* block)
+{
+    if (!block_is_used(block_next(block)))
+        merge_next(heap, block);
+
+    if (!block_is_prev_used(block))
+    {
+        PhBlock* prev = block_prev(block);
+        remove_free_block(heap, prev);
+        block_set_size(prev, block_size(prev) + BLOCK_HEADER_SIZE + block_size(block));
+        block = prev;
+    }
+
+    block_mark_free(block);
+    insert_free_block(heap, block);
+}
+
+/**
+ * Lays out a new file: the header, one free block spanning the rest of the file, and the sentinel.
+ */
+static void format_file(ph_heap_t* heap)
+{
+    ph_header_t* header = file_header(heap);
+    memset(header, 0, sizeof(*header));
+    header->magic = PH_MAGIC;
+    header->version = PH_VERSION;
+    header->size = heap->size;
+
+    sentinel_block(heap)->header = BLOCK_USED;
+    PhBlock* first = first_block(heap);
+    first->header = (heap->size - FIRST_BLOCK_OFFSET - 2 * BLOCK_HEADER_SIZE) | BLOCK_PREV_USED;
+    block_mark_free(first);
+    insert_free_block(heap, first);
+}
+
+/**
+ * Rebuilds the free index of a file that was not closed cleanly.
+ *
+ * The index may be stale, but the block headers alone describe the block sequence. The walk checks
+ * every size against the end of the file, merges adjacent free blocks an interrupted free left behind,
+ * rewrites the footers and BLOCK_PREV_USED flags, and links every free block into a fresh index.
+ * @return 0 on success. 1 if the sequence does not end exactly at the sentinel.
+ */
+static int rebuild_index(ph_heap_t* heap)
+{
+    ph_header_t* header = file_header(heap);
+    header->fl_bitmap = 0;
+    memset(header->sl_bitmap, 0, sizeof(header->sl_bitmap));
+    memset(header->free_blocks, 0, sizeof(header->free_blocks));
+
+    PhBlock* sentinel = sentinel_block(heap);
+    if (sentinel->header & ~BLOCK_PREV_USED & ~BLOCK_USED || !block_is_used(sentinel))
+        return 1;
+
+    PhBlock* run = NULL; // Free blocks being merged into one
+    PhBlock* block = first_block(heap);
+    while (block != sentinel)
+    {
+        uint64_t size = block_size(block);
+        uint64_t room = (uint64_t)((char*)sentinel - (char*)block_to_ptr(block));
+        if (size < MIN_BLOCK_SIZE || size > room)
+            return 1;
+
+        PhBlock* next = block_next(block);
+        if (block_is_used(block))
+        {
+            if (run)
+            {
+                block_mark_free(run); // Clears this block's BLOCK_PREV_USED
+                insert_free_block(heap, run);
+                run = NULL;
+            }
+            else
+                block->header |= BLOCK_PREV_USED;
+        }
+        else if (run)
+            block_set_size(run, block_size(run) + BLOCK_HEADER_SIZE + size);
+        else
+        {
+            block->header |= BLOCK_PREV_USED; // Free blocks only follow used ones
+            run = block;
+        }
+        block = next;
+    }
+
+    if (run)
+    {
+        block_mark_free(run);
+        insert_free_block(heap, run);
+    }
+    else
+        sentinel->header |= BLOCK_PREV_USED;
+
+    return 0;
+}
+
+/**
+ * Writes the first page (the header) back to the file.
+ */
+static int sync_header(const ph_heap_t* heap)
+{
+    return msync(heap->base, (size_t)sysconf(_SC_PAGESIZE), MS_SYNC);
+}
+
+/**
+ * Opens a heap file, creating and formatting it if it is empty or does not exist.
+ * An existing file keeps its size. If it was not closed cleanly, its free index is rebuilt first
+ * and heap->recovered is set.
+ * @param heap The handle to initialize
+ * @param path The heap file
+ * @param size The size of a new file in bytes, rounded down to the alignment. Ignored for an existing file.
+ * @return 0 on successful initialization. 1 Otherwise.
+ */
+int ph_open(ph_heap_t* heap, const char* path, size_t size)
+{
+    if (!heap || !path)
+    {
+        RON_ERROR(RON_ECONFIG, NULL);
+        return 1;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        RON_ERROR(RON_EIO, NULL);
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) || flock(fd, LOCK_EX | LOCK_NB)) // Locked while another process has it open
+    {
+        RON_ERROR(RON_EIO, NULL);
+        close(fd);
+        return 1;
+    }
+
+    int created = st.st_size == 0;
+    if (created)
+    {
+        size &= ~(size_t)(ALIGN_SIZE - 1);
+        if (size < MIN_FILE_SIZE || size - FIRST_BLOCK_OFFSET - 2 * BLOCK_HEADER_SIZE > MAX_BLOCK_SIZE)
+        {
+            RON_ERROR(RON_ECONFIG, NULL);
+            close(fd);
+            return 1;
+        }
+        if (ftruncate(fd, (off_t)size))
+        {
+            RON_ERROR(RON_EIO, NULL);
+            close(fd);
+            return 1;
+        }
+    }
+    else
+        size = (size_t)st.st_size;
+
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+    {
+        RON_ERROR(RON_ENOMEM, NULL);
+        close(fd);
+        return 1;
+    }
+    heap->base = base;
+    heap->size = size;
+    heap->fd = fd;
+    heap->recovered = 0;
+
+    ph_header_t* header = file_header(heap);
+    if (created)
+        format_file(heap);
+    else if (size < MIN_FILE_SIZE || header->magic != PH_MAGIC || header->version != PH_VERSION
+             || header->size != size || (!header->clean && rebuild_index(heap))
+             || (header->root && !ph_owns(heap, ph_pointer(heap, header->root))))
+    {
+        RON_ERROR(RON_ECONFIG, NULL);
+        munmap(base, size);
+        close(fd);
+        return 1;
+    }
+    else
+        heap->recovered = !header->clean;
+
+    // Marked open before anything else changes, so a crash from here on is detected by the next ph_open
+    header->clean = 0;
+    sync_header(heap);
+
+    return 0;
+}
+
+/**
+ * Writes every change made to the heap back to its file.
+ * @param heap The heap to write back
+ * @return 0 on success. 1 if the file could not be written.
+ */
+int ph_sync(ph_heap_t* heap)
+{
+    if (msync(heap->base, heap->size, MS_SYNC))
+    {
+        RON_ERROR(RON_EIO, NULL);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Writes the heap back, marks the file clean and unmaps it. The handle must be re-opened before it is used again.
+ * If the write-back fails, the file stays marked open, so the next ph_open rebuilds the free index.
+ * @param heap The heap to close
+ */
+void ph_close(ph_heap_t* heap)
+{
+    if (!ph_sync(heap))
+    {
+        file_header(heap)->clean = 1;
+        sync_header(heap);
+    }
+    munmap(heap->base, heap->size);
+    close(heap->fd); // Releases the lock
+    heap->base = NULL;
+    heap->size = 0;
+    heap->fd = -1;
+}
+
+/**
+ * Allocates a block in the heap file.
+ * @param heap The heap to allocate from
+ * @param size The size of the memory to allocate
+ * @return A pointer to the usable allocated memory, valid until the heap is closed (see ph_offset).
+ */
+void* ph_malloc(ph_heap_t* heap, size_t size)
+{
+    if (size > MAX_BLOCK_SIZE)
+    {
+        RON_ERROR(RON_ENOMEM, NULL);
+        return NULL;
+    }
+    uint64_t aligned = align_size(size);
+
+    int fl, sl;
+    mapping_search(aligned, &fl, &sl);
+    PhBlock* block = search_suitable_block(heap, &fl, &sl);
+    if (!block)
+    {
+        RON_ERROR(RON_ENOMEM, NULL);
+        return NULL;
+    }
+
+    remove_free_block(heap, block);
+    block_mark_used(block);
+    split_block(heap, block, aligned);
+
+    return block_to_ptr(block);
+}
+
+/**
+ * Frees a block of the heap file. Freeing the root object also clears the root.
+ * @param heap The heap the block was allocated from
+ * @param ptr A pointer to the memory that should be freed
+ */
+void ph_free(ph_heap_t* heap, void* ptr)
+{
+    if (!ph_owns(heap, ptr))
+    {
+        RON_ERROR(RON_EINVAL, ptr);
+        return;
+    }
+
+    PhBlock* block = block_from_ptr(ptr);
+    if (!block_is_used(block))
+    {
+        RON_ERROR(RON_EDOUBLEFREE, ptr);
+        return;
+    }
+
+    if (file_header(heap)->root == ph_offset(heap, ptr))
+        file_header(heap)->root = 0;
+    free_block(heap, block);
+}
+
+/**
+ * Resizes a block of the heap file, in place when the block or its free successor is large enough.
+ * A moved root object stays the root.
+ * @param heap The heap the block was allocated from
+ * @param ptr A pointer to the memory that will be reallocated. NULL allocates.
+ * @param new_size The new size of the allocated memory. 0 frees the memory.
+ * @return A pointer to the usable reallocated memory.
+ */
+void* ph_realloc(ph_heap_t* heap, void* ptr, size_t new_size)
+{
+    if (!ptr)
+        return ph_malloc(heap, new_size);
+    if (!new_size)
+    {
+        ph_free(heap, ptr);
+        return NULL;
+    }
+    if (!ph_owns(heap, ptr) || !block_is_used(block_from_ptr(ptr)))
+    {
+        RON_ERROR(RON_EINVAL, ptr);
+        return NULL;
+    }
+    if (new_size > MAX_BLOCK_SIZE)
+    {
+        RON_ERROR(RON_ENOMEM, NULL);
+        return NULL;
+    }
+
+    PhBlock* block = block_from_ptr(ptr);
+    uint64_t aligned = align_size(new_size);
+    PhBlock* next = block_next(block);
+    if (aligned > block_size(block) && !block_is_used(next)
+        && block_size(block) + BLOCK_HEADER_SIZE + block_size(next) >= aligned)
+    {
+        merge_next(heap, block);
+        block_mark_used(block); // The block after the merged neighbour loses its footer
+    }
+    if (aligned <= block_size(block))
+    {
+        split_block(heap, block, aligned);
+        return ptr;
+    }
+
+    void* new_ptr = ph_malloc(heap, new_size);
+    if (new_ptr)
+    {
+        memcpy(new_ptr, ptr, block_size(block));
+        int root = file_header(heap)->root == ph_offset(heap, ptr);
+        ph_free(heap, ptr);
+        if (root)
+            ph_set_root(heap, new_ptr);
+    }
+    return new_ptr;
+}
+
+/**
+ * Stores the object a restarted process starts from, usually the top of a data structure in the heap.
+ * @param heap The heap
+ * @param ptr A block of the heap, or NULL to clear the root
+ */
+void ph_set_root(ph_heap_t* heap, void* ptr)
+{
+    if (ptr && !ph_owns(heap, ptr))
+    {
+        RON_ERROR(RON_EINVAL, ptr);
+        return;
+    }
+    file_header(heap)->root = ph_offset(heap, ptr);
+}
+
+/**
+ * Returns the root object stored with ph_set_root, or NULL if there is none.
+ */
+void* ph_root(const ph_heap_t* heap)
+{
+    return ph_pointer(heap, file_header(heap)->root);
+}
+
+/**
+ * Converts a pointer into the heap to its offset in the file, which stays valid across restarts.
+ * Store offsets, not pointers, in persistent data structures.
+ * @return The offset, or 0 for NULL.
+ */
+uint64_t ph_offset(const ph_heap_t* heap, const void* ptr)
+{
+    return ptr ? (uint64_t)((const char*)ptr - heap->base) : 0;
+}
+
+/**
+ * Converts an offset returned by ph_offset back to a pointer into the current mapping.
+ * @return The pointer, or NULL for offset 0.
+ */
+void* ph_pointer(const ph_heap_t* heap, uint64_t offset)
+{
+    return offset ? heap->base + offset : NULL;
+}
+
+/**
+ * Checks whether a pointer is a plausible payload of the heap, without reading its header.
+ */
+int ph_owns(const ph_heap_t* heap, const void* ptr)
+{
+    const char* p = ptr;
+    return p >= (const char*)block_to_ptr(first_block(heap)) && p < (const char*)sentinel_block(heap)
+        && (uint64_t)(p - heap->base) % ALIGN_SIZE == 0;
+}
+
+/**
+ * Prints a list of blocks (by file offset), their sizes and free/used status, and the root object.
+ * @param heap The heap to print
+ */
+void ph_dump_memory(const ph_heap_t* heap)
+{
+    printf("Memory Dump:\n");
+    for (const PhBlock* curr = first_block(heap); block_size(curr); curr = block_next(curr))
+    {
+        printf("\tBlock at offset %llu, size %llu, used %d\n", (unsigned long long)block_offset(heap, curr),
+               (unsigned long long)block_size(curr), block_is_used(curr));
+    }
+    if (file_header(heap)->root)
+        printf("\tRoot object at offset %llu\n", (unsigned long long)file_header(heap)->root);
+    printf("End Memory Dump\n");
+}
+
+#ifdef RON_SELF_TEST
+#include <stdlib.h> // mkstemp
+
+#define FILE_SIZE (64 * 1024)
+#define NODE_COUNT 100
+
+/**
+ * A list node that lives in the heap file. Linked by offset, so the list survives a remap.
+ */
+typedef struct Node
+{
+    uint64_t next;
+    int value;
+} Node;
+
+/**
+ * Sums the values of the list hanging off the root object.
+ */
+static int list_sum(const ph_heap_t* heap)
+{
+    int sum = 0;
+    for (const Node* node = ph_root(heap); node; node = ph_pointer(heap, node->next))
+        sum += node->value;
+    return sum;
+}
+
+/**
+ * The main function initializes the allocator and acts as a test suite.
+ *
+ * The implemented tests are:
+ * - A list built on the heap, reachable from the root object
+ * - Reopening the file and walking the list
+ * - Freeing and reallocating after a restart
+ * - Recovery of a file that was not closed
+ * - Invalid files and pointers
+ */
+int main()
+{
+    ron_set_error_handler(ron_print_error, NULL); // Failures are silent by default
+
+    char path[] = "/tmp/persistent_allocatoron_XXXXXX";
+    int fd = mkstemp(path); // An empty file is formatted by ph_open
+    if (fd < 0)
+    {
+        printf("ERROR: Failed to create the heap file\n");
+        return 1;
+    }
+    close(fd);
+
+    ph_heap_t heap;
+    if (ph_open(&heap, path, FILE_SIZE))
+    {
+        printf("ERROR: Failed to initialize allocator\n");
+        unlink(path);
+        return 1;
+    }
+
+    printf("\nTest: Build a list under the root\n");
+    Node* head = NULL;
+    for (int i = 1; i <= NODE_COUNT; i++)
+    {
+        Node* node = ph_malloc(&heap, sizeof(Node));
+        node->value = i;
+        node->next = ph_offset(&heap, head);
+        head = node;
+    }
+    ph_set_root(&heap, head);
+    printf("\tSum: %d\n", list_sum(&heap)); // Should print 5050
+    ph_close(&heap);
+
+    printf("\nTest: Reopen and walk the list\n");
+    void* filler = mmap(NULL, FILE_SIZE, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0); // Takes the old address
+    ph_open(&heap, path, 0);
+    printf("\tRecovered: %s, sum: %d\n", heap.recovered ? "yes" : "no", list_sum(&heap)); // Should print no and 5050
+
+    printf("\nTest: Free and reallocate after the restart\n");
+    for (int i = 0; i < NODE_COUNT / 2; i++)
+    {
+        Node* node = ph_root(&heap);
+        ph_set_root(&heap, ph_pointer(&heap, node->next));
+        ph_free(&heap, node);
+    }
+    char* text = ph_realloc(&heap, ph_malloc(&heap, 8), 1000);
+    strcpy(text, "kept");
+    printf("\tSum: %d\n", list_sum(&heap)); // Should print 1275
+
+    printf("\nTest: Recovery after a crash\n");
+    file_header(&heap)->fl_bitmap = 0; // As if the crash hit in the middle of an update
+    munmap(heap.base, heap.size); // No ph_close: the file stays marked open
+    close(heap.fd);
+    ph_open(&heap, path, 0);
+    void* fresh = ph_malloc(&heap, 2000);
+    printf("\tRecovered: %s, sum: %d, allocated: %s\n", heap.recovered ? "yes" : "no", list_sum(&heap),
+           fresh ? "yes" : "no"); // Should print yes, 1275 and yes
+    ph_free(&heap, fresh);
+    ph_free(&heap, text);
+    while (ph_root(&heap))
+    {
+        Node* node = ph_root(&heap);
+        ph_set_root(&heap, ph_pointer(&heap, node->next));
+        ph_free(&heap, node);
+    }
+    ph_dump_memory(&heap); // Should print 1 free block
+
+    printf("\nTest: Invalid files and pointers\n");
+    ph_heap_t other;
+    ph_open(&other, path, 0); // Should print 'Input/output error on the backing file' (locked)
+    static char outside[16];
+    ph_free(&heap, outside); // Should print 'Invalid pointer'
+    ph_close(&heap);
+    fd = open(path, O_WRONLY);
+    if (fd >= 0)
+    {
+        (void)!write(fd, "not a heap", 10);
+        close(fd);
+    }
+    ph_open(&other, path, 0); // Should print 'Invalid allocator configuration'
+
+    munmap(filler, FILE_SIZE);
+    unlink(path);
+    return 0;
+}
+#endif
@@ -0,0 +1,77 @@
+/**
+ * Public interface of the persistent heap: a variable-size heap stored in a memory-mapped file.
+ * See persistent_allocatoron.c for the design notes.
+ */
+
+#ifndef PERSISTENT_ALLOCATORON_H
+#define PERSISTENT_ALLOCATORON_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * File format parameters. The free index has the same shape as the one of vs_heap_t, but wider:
+ * a file may hold blocks of up to 2^PH_FL_INDEX_MAX bytes.
+ */
+#define PH_MAGIC 0x50414548504E4F52ULL // "RONPHEAP" in little-endian byte order
+#define PH_VERSION 1
+#define PH_ALIGN_SIZE_LOG2 3
+#define PH_SL_INDEX_COUNT_LOG2 4
+#define PH_FL_INDEX_MAX 40
+#define PH_SL_INDEX_COUNT (1 << PH_SL_INDEX_COUNT_LOG2)
+#define PH_FL_INDEX_COUNT (PH_FL_INDEX_MAX - (PH_SL_INDEX_COUNT_LOG2 + PH_ALIGN_SIZE_LOG2) + 1)
+
+/**
+ * The first bytes of a heap file. Every link in the file is an offset from the start of the file,
+ * so the file can be mapped at any address. Offset 0 (this header) is never a block and means "none".
+ *
+ * Fields:
+ * - `magic`, `version`: Identify the format. ph_open refuses other files.
+ * - `clean`: 1 once ph_close has written everything back, 0 while a process has the heap open.
+ * - `size`: Size of the file in bytes.
+ * - `root`: Offset of the root object set with ph_set_root, 0 if there is none.
+ * - `fl_bitmap`, `sl_bitmap`, `free_blocks`: The free index (offsets of the bucket heads).
+ */
+typedef struct ph_header_t
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t clean;
+    uint64_t size;
+    uint64_t root;
+    uint64_t fl_bitmap;
+    uint32_t sl_bitmap[PH_FL_INDEX_COUNT];
+    uint64_t free_blocks[PH_FL_INDEX_COUNT][PH_SL_INDEX_COUNT];
+} ph_header_t;
+
+/**
+ * A heap file mapped by this process.
+ *
+ * Fields:
+ * - `base`: Start of the mapping (the file header).
+ * - `size`: Size of the mapping in bytes.
+ * - `fd`: The open file, locked against other processes.
+ * - `recovered`: 1 if the file was not closed cleanly and its free index was rebuilt by ph_open.
+ */
+typedef struct ph_heap_t
+{
+    char* base;
+    size_t size;
+    int fd;
+    int recovered;
+} ph_heap_t;
+
+int ph_open(ph_heap_t* heap, const char* path, size_t size);
+int ph_sync(ph_heap_t* heap);
+void ph_close(ph_heap_t* heap);
+void* ph_malloc(ph_heap_t* heap, size_t size);
+void ph_free(ph_heap_t* heap, void* ptr);
+void* ph_realloc(ph_heap_t* heap, void* ptr, size_t new_size);
+void ph_set_root(ph_heap_t* heap, void* ptr);
+void* ph_root(const ph_heap_t* heap);
+uint64_t ph_offset(const ph_heap_t* heap, const void* ptr);
+void* ph_pointer(const ph_heap_t* heap, uint64_t offset);
+int ph_owns(const ph_heap_t* heap, const void* ptr);
+void ph_dump_memory(const ph_heap_t* heap);
+
+#endif
@@ -0,0 +1,374 @@
+/**
+ * A drop-in replacement for the C library's allocator, built as a shared library (libron_malloc.so).
+ *
+ *     LD_PRELOAD=./libron_malloc.so <program>
+ *
+ * - Exports malloc, free, calloc, realloc, posix_memalign, aligned_alloc, memalign, valloc and
+ *   malloc_usable_size, so unmodified binaries allocate from the allocators of this repository
+ * - Requests up to SLAB_MAX_SIZE go to a slab allocator, larger ones and exhausted classes to a
+ *   variable-size heap, and requests from PRELOAD_LARGE_THRESHOLD up to its large-object path
+ * - Both regions are reserved once with MAP_NORESERVE and committed by the kernel on first touch,
+ *   so ownership is two range checks and the large-object lookup, all O(1)
+ * - calloc clears only memory that was handed out before: the untouched slab blocks and fresh large
+ *   mappings are known to be zero (see fs_calloc, vs_calloc), so their pages are never written
+ * - Heap blocks of at least PRELOAD_PURGE_MIN_SIZE that stay free for PRELOAD_PURGE_DECAY milliseconds
+ *   have their pages returned to the kernel (see vs_set_purging), so the footprint drops after a spike
+ * - Every payload is 16-byte aligned, like glibc's: slab requests below 32 bytes use the 32-byte class
+ *   (the 24-byte class is not 16-byte aligned), and heap requests go through vs_memalign
+ * - Foreign pointers (not from the regions, e.g. handed out by a library that called the C library's
+ *   allocator directly) are passed on to the next allocator in link order, found with dlsym(RTLD_NEXT)
+ * - A single lock guards both allocators. pthread_atfork handlers take it around fork, so a child forked
+ *   while another thread allocates inherits consistent allocators
+ * - Initialized on first use: the dynamic loader and other libraries' constructors allocate before
+ *   any constructor of this library would run
+ *
+ * The library is always built with FS_BITMAP: the in-block free mark of the other fixed-size builds
+ * would be overwritten by client data, and their free lists would touch the whole slab region at startup.
+ */
+
+#define _GNU_SOURCE // RTLD_NEXT, MAP_NORESERVE
+
+#include "error_allocatoron.h"
+#include "slab_allocatoron.h"
+#include "variable_size_allocatoron.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifndef FS_BITMAP
+#error "The preload library must be built with FS_BITMAP"
+#endif
+
+#define PRELOAD_SLAB_SIZE ((size_t)1 << 30) // Reserved for the slab classes (64 MiB each)
+#define PRELOAD_HEAP_SIZE ((size_t)1 << 31) // Reserved for the variable-size heap
+#define PRELOAD_CHUNK_SIZE ((size_t)64 << 20) // Growth step once the heap region is full
+#define PRELOAD_LARGE_THRESHOLD ((size_t)1 << 20) // Smallest request given a mapping of its own
+#define PRELOAD_LARGE_CACHE 8 // Freed large mappings kept for reuse
+#define PRELOAD_PURGE_DECAY 10000 // Milliseconds a large free heap block stays resident
+#define PRELOAD_PURGE_MIN_SIZE ((size_t)64 << 10) // Smallest free heap block purged
+#define PRELOAD_ALIGNMENT 16 // Alignment of every payload (max_align_t on x86-64 and AArch64)
+#define PRELOAD_MIN_SLAB_SIZE 32 // Smallest 16-byte aligned slab class
+
+#define RON_EXPORT __attribute__((visibility("default")))
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int initialized = 0; // 1 once the allocators are set up, -1 if that failed
+static slab_t slab;
+static vs_heap_t heap;
+
+// The allocator behind this one, for foreign pointers
+static void (*next_free)(void*);
+static void* (*next_realloc)(void*, size_t);
+static size_t (*next_usable_size)(void*);
+
+static void lock_allocators()
+{
+    pthread_mutex_lock(&lock);
+}
+
+static void unlock_allocators()
+{
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Reserves the regions and initializes the allocators. Called with the lock held.
+ * @return 0 on success. 1 if the regions could not be reserved.
+ */
+static int init_locked()
+{
+    if (initialized)
+        return initialized < 0;
+    initialized = -1;
+
+    char* slab_memory = mmap(NULL, PRELOAD_SLAB_SIZE, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    char* heap_memory = mmap(NULL, PRELOAD_HEAP_SIZE, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (slab_memory == MAP_FAILED || heap_memory == MAP_FAILED
+        || slab_init(&slab, slab_memory, PRELOAD_SLAB_SIZE, NULL) // Exhausted classes are handled here
+        || vs_init_heap(&heap, heap_memory, PRELOAD_HEAP_SIZE)
+        || vs_set_growth(&heap, PRELOAD_CHUNK_SIZE, 1)
+        || vs_set_large_objects(&heap, PRELOAD_LARGE_THRESHOLD, 0, PRELOAD_LARGE_CACHE))
+        return 1;
+    slab_set_zeroed(&slab); // Fresh anonymous pages
+    vs_set_purging(&heap, PRELOAD_PURGE_DECAY, PRELOAD_PURGE_MIN_SIZE, VS_PURGE_REGION); // The region is private
+
+    initialized = 1;
+    return 0;
+}
+
+static void prepare_fork()
+{
+    lock_allocators();
+}
+
+static void after_fork()
+{
+    unlock_allocators(); // The child's only thread is the one that took the lock
+}
+
+static void install_fork_handlers()
+{
+    pthread_atfork(prepare_fork, after_fork, after_fork);
+}
+
+/**
+ * Registers the fork handlers once. Outside the lock, because pthread_atfork may allocate.
+ */
+static void register_fork_handlers()
+{
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, install_fork_handlers);
+}
+
+static void lookup_next()
+{
+    next_free = (void (*)(void*))dlsym(RTLD_NEXT, "free");
+    next_realloc = (void* (*)(void*, size_t))dlsym(RTLD_NEXT, "realloc");
+    next_usable_size = (size_t (*)(void*))dlsym(RTLD_NEXT, "malloc_usable_size");
+}
+
+/**
+ * Resolves the next allocator in link order once. Outside the lock, because dlsym may allocate.
+ */
+static void resolve_next()
+{
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, lookup_next);
+}
+
+/**
+ * Allocates with the lock held. Slab first, then the heap.
+ */
+static void* malloc_locked(size_t size)
+{
+    if (init_locked())
+        return NULL;
+
+    if (size <= SLAB_MAX_SIZE)
+    {
+        void* ptr = slab_malloc(&slab, size < PRELOAD_MIN_SLAB_SIZE ? PRELOAD_MIN_SLAB_SIZE : size);
+        if (ptr)
+            return ptr;
+    }
+    return vs_memalign(&heap, PRELOAD_ALIGNMENT, size);
+}
+
+/**
+ * Allocates zeroed memory with the lock held, writing only what may hold old data.
+ */
+static void* calloc_locked(size_t size)
+{
+    if (init_locked())
+        return NULL;
+
+    if (size <= SLAB_MAX_SIZE)
+    {
+        void* ptr = slab_calloc(&slab, 1, size < PRELOAD_MIN_SLAB_SIZE ? PRELOAD_MIN_SLAB_SIZE : size);
+        if (ptr)
+            return ptr;
+    }
+    if (size >= PRELOAD_LARGE_THRESHOLD)
+        return vs_calloc(&heap, 1, size); // Large objects are 16-byte aligned already
+
+    void* ptr = vs_memalign(&heap, PRELOAD_ALIGNMENT, size);
+    if (ptr)
+        memset(ptr, 0, size); // Reused blocks hold stale data
+    return ptr;
+}
+
+/**
+ * Frees with the lock held.
+ * @return 0 if the pointer belonged to the allocators. 1 if it is foreign.
+ */
+static int free_locked(void* ptr)
+{
+    if (initialized > 0 && slab_owns(&slab, ptr))
+        slab_free(&slab, ptr);
+    else if (initialized > 0 && vs_owns(&heap, ptr))
+        vs_free(&heap, ptr);
+    else
+        return 1;
+    return 0;
+}
+
+/**
+ * Returns the usable size with the lock held, or 0 for a foreign pointer.
+ */
+static size_t usable_size_locked(void* ptr)
+{
+    if (initialized > 0 && slab_owns(&slab, ptr))
+        return slab_usable_size(&slab, ptr);
+    if (initialized > 0 && vs_owns(&heap, ptr))
+        return vs_usable_size(&heap, ptr);
+    return 0;
+}
+
+static void* checked(void* ptr)
+{
+    if (!ptr)
+        errno = ENOMEM;
+    return ptr;
+}
+
+/**
+ * Allocates memory for the exported functions. Not named malloc on purpose: the compiler would turn
+ * the malloc and memset of calloc into a call to calloc itself.
+ */
+static void* allocate(size_t size)
+{
+    lock_allocators();
+    void* ptr = malloc_locked(size);
+    unlock_allocators();
+    register_fork_handlers();
+
+    return checked(ptr);
+}
+
+RON_EXPORT void* malloc(size_t size)
+{
+    return allocate(size);
+}
+
+RON_EXPORT void free(void* ptr)
+{
+    if (!ptr)
+        return;
+
+    int saved_errno = errno; // free never sets errno, but releasing a chunk calls munmap
+    lock_allocators();
+    int foreign = free_locked(ptr);
+    unlock_allocators();
+
+    if (foreign)
+    {
+        resolve_next();
+        if (next_free)
+            next_free(ptr);
+    }
+    errno = saved_errno;
+}
+
+RON_EXPORT void* calloc(size_t count, size_t size)
+{
+    if (size && count > SIZE_MAX / size)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    lock_allocators();
+    void* ptr = calloc_locked(count * size);
+    unlock_allocators();
+    register_fork_handlers();
+
+    return checked(ptr);
+}
+
+RON_EXPORT void* realloc(void* ptr, size_t size)
+{
+    if (!ptr)
+        return allocate(size);
+    if (!size)
+    {
+        free(ptr);
+        return NULL;
+    }
+
+    lock_allocators();
+    if (initialized > 0 && vs_owns(&heap, ptr))
+    {
+        // Grows in place or remaps when it can, and otherwise moves to an aligned block. Reports pointers that
+        // are not used blocks.
+        void* new_ptr = vs_realloc_aligned(&heap, ptr, PRELOAD_ALIGNMENT, size);
+        unlock_allocators();
+        return checked(new_ptr);
+    }
+
+    size_t usable = usable_size_locked(ptr);
+    if (!usable) // Foreign - Let its allocator resize it
+    {
+        unlock_allocators();
+        resolve_next();
+        return checked(next_realloc ? next_realloc(ptr, size) : NULL);
+    }
+    if (size <= usable) // Still fits its slab block
+    {
+        unlock_allocators();
+        return ptr;
+    }
+
+    void* new_ptr = malloc_locked(size);
+    if (new_ptr)
+    {
+        memcpy(new_ptr, ptr, usable);
+        free_locked(ptr);
+    }
+    unlock_allocators();
+    return checked(new_ptr);
+}
+
+RON_EXPORT int posix_memalign(void** out, size_t alignment, size_t size)
+{
+    if (!alignment || alignment % sizeof(void*) || (alignment & (alignment - 1)))
+        return EINVAL;
+
+    void* ptr;
+    if (alignment <= PRELOAD_ALIGNMENT)
+        ptr = allocate(size);
+    else
+    {
+        lock_allocators();
+        ptr = init_locked() ? NULL : vs_memalign(&heap, alignment, size);
+        unlock_allocators();
+    }
+
+    if (!ptr)
+        return ENOMEM;
+    *out = ptr;
+    return 0;
+}
+
+RON_EXPORT void* aligned_alloc(size_t alignment, size_t size)
+{
+    if (alignment < sizeof(void*))
+        alignment = sizeof(void*); // Any power of two is valid here
+    void* ptr = NULL;
+    int error = posix_memalign(&ptr, alignment, size);
+    if (error)
+        errno = error;
+    return ptr;
+}
+
+RON_EXPORT void* memalign(size_t alignment, size_t size)
+{
+    return aligned_alloc(alignment, size);
+}
+
+RON_EXPORT void* valloc(size_t size)
+{
+    return aligned_alloc((size_t)sysconf(_SC_PAGESIZE), size);
+}
+
+RON_EXPORT size_t malloc_usable_size(void* ptr)
+{
+    if (!ptr)
+        return 0;
+
+    lock_allocators();
+    size_t usable = usable_size_locked(ptr);
+    unlock_allocators();
+
+    if (!usable)
+    {
+        resolve_next();
+        return next_usable_size ? next_usable_size(ptr) : 0;
+    }
+    return usable;
+}
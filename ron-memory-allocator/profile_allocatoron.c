@@ -0,0 +1,501 @@
+/**
+ * Sampled heap profiling: attributes live memory to the stacks that allocated it, at a cost low enough
+ * for production.
+ *
+ * - Sampling: each thread counts down the bytes it allocates. When the count crosses zero, the allocation
+ *   is sampled and the count restarts from an exponentially distributed interval of mean `rate` bytes,
+ *   so every byte has the same chance 1/rate of being sampled (the geometric sampling of tcmalloc)
+ *   and large allocations are sampled proportionally more often
+ * - The unsampled fast path is the decrement of a thread-local counter (prof_malloc). Frees check a
+ *   counter in a small filter of sampled addresses (prof_free) and only take the lock on a hit
+ * - Sampled allocations are kept with their stack trace in a side table (an open-addressing hash table
+ *   keyed by address, in mapped memory) until they are freed. Reallocations keep their sample.
+ * - prof_dump writes the live samples in the legacy text heap profile format that pprof reads:
+ *
+ *       heap profile: <objects>: <bytes> [<objects>: <bytes>] @ heap_v2/<rate>
+ *       <objects>: <bytes> [<objects>: <bytes>] @ <pc> <pc> ...
+ *       ...
+ *       MAPPED_LIBRARIES:
+ *       <the contents of /proc/self/maps>
+ *
+ *   One line per distinct stack. The counts are those of the samples; pprof scales them back to
+ *   estimates of the whole heap using the rate. Only live memory is tracked, so the bracketed
+ *   allocation totals repeat the in-use ones.
+ *
+ * The allocators call the hooks only when built with RON_PROFILE (see PROF_MALLOC). Profiling is stopped
+ * until prof_start is called; until then, each thread checks at most once per PROF_IDLE_BYTES allocated.
+ * Stack traces use glibc's backtrace. Elsewhere the samples are kept without a stack.
+ */
+
+#define _GNU_SOURCE // MAP_ANONYMOUS is an extension to POSIX mmap
+
+#include "profile_allocatoron.h"
+#include "error_allocatoron.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#ifdef __GLIBC__
+#include <execinfo.h>
+#endif
+
+#define PROF_IDLE_BYTES ((int64_t)1 << 20) // Bytes between two checks whether profiling was started
+#define PROF_TABLE_MIN_CAPACITY 1024 // First size of the side table (a power of two)
+#define PROF_SKIP_FRAMES 1 // prof_sample itself; the allocator's frame is kept
+
+_Thread_local int64_t prof_countdown; // 0, so each thread's first allocation checks the rate
+_Atomic uint8_t prof_filter[1 << PROF_FILTER_LOG2];
+
+/**
+ * A sampled allocation.
+ *
+ * Fields:
+ * - `ptr`: The allocation's address. 0 for an empty slot.
+ * - `size`: The requested size.
+ * - `depth`: Number of frames in `stack`.
+ * - `dumped`: The dump that last printed this sample's stack (see prof_dump).
+ * - `stack`: Return addresses, innermost first.
+ */
+typedef struct ProfSample
+{
+    uintptr_t ptr;
+    size_t size;
+    int depth;
+    unsigned int dumped;
+    void* stack[PROF_MAX_DEPTH];
+} ProfSample;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER; // Guards everything below
+static _Atomic size_t sample_rate; // 0 while stopped
+static ProfSample* table;
+static size_t capacity;
+static size_t count;
+static size_t sampled_bytes;
+static size_t dropped;
+static unsigned int dump_count;
+
+/**
+ * Returns the next pseudo-random number of the calling thread (xorshift64*).
+ */
+static uint64_t next_random()
+{
+    static _Thread_local uint64_t state;
+    if (!state)
+        state = ((uint64_t)(uintptr_t)&state ^ (uint64_t)time(NULL)) | 1; // Distinct per thread
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * Returns -ln(u) for u in (0, 1], without libm. Precise to about 1e-5, plenty for a sampling interval.
+ */
+static double negative_log(double u)
+{
+    // u = m * 2^e with m in [1, 2), from the bits of the double
+    uint64_t bits;
+    memcpy(&bits, &u, sizeof(bits));
+    int e = (int)((bits >> 52) & 0x7FF) - 1023;
+    bits = (bits & 0x000FFFFFFFFFFFFFULL) | 0x3FF0000000000000ULL;
+    double m;
+    memcpy(&m, &bits, sizeof(m));
+
+    // ln(m) = 2 atanh(z) with z = (m - 1) / (m + 1) in [0, 1/3)
+    double z = (m - 1) / (m + 1), z2 = z * z;
+    double ln_m = 2 * z * (1 + z2 * (1.0 / 3 + z2 * (1.0 / 5 + z2 * (1.0 / 7 + z2 / 9))));
+    return -(e * 0.69314718055994530942 + ln_m);
+}
+
+/**
+ * Draws the bytes until the next sample from an exponential distribution of mean `rate`.
+ */
+static int64_t next_interval(size_t rate)
+{
+    double u = ((double)(next_random() >> 11) + 1) / 9007199254740992.0; // (0, 1]
+    double interval = negative_log(u) * (double)rate;
+    return interval < 1 ? 1 : interval > (double)INT64_MAX / 2 ? INT64_MAX / 2 : (int64_t)interval;
+}
+
+static size_t table_slot(uintptr_t key)
+{
+    return (size_t)(((uint64_t)key >> 3) * 0x9E3779B97F4A7C15ULL >> 20) & (capacity - 1);
+}
+
+/**
+ * Returns the sample of an address, or NULL if it was not sampled. Called with the lock held.
+ */
+static ProfSample* table_find(const void* ptr)
+{
+    if (!capacity)
+        return NULL;
+    for (size_t i = table_slot((uintptr_t)ptr); table[i].ptr; i = (i + 1) & (capacity - 1))
+    {
+        if (table[i].ptr == (uintptr_t)ptr)
+            return &table[i];
+    }
+    return NULL;
+}
+
+/**
+ * Doubles the table (or maps the first one) and rehashes the samples. Called with the lock held.
+ * @return 0 on success. 1 if the mapping failed.
+ */
+static int table_grow()
+{
+    size_t new_capacity = capacity ? 2 * capacity : PROF_TABLE_MIN_CAPACITY;
+    ProfSample* new_table = mmap(NULL, new_capacity * sizeof(ProfSample), PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (new_table == MAP_FAILED)
+        return 1;
+
+    ProfSample* old_table = table;
+    size_t old_capacity = capacity;
+    table = new_table;
+    capacity = new_capacity;
+    for (size_t i = 0; i < old_capacity; i++)
+    {
+        if (!old_table[i].ptr)
+            continue;
+        size_t slot = table_slot(old_table[i].ptr);
+        while (table[slot].ptr)
+            slot = (slot + 1) & (capacity - 1);
+        table[slot] = old_table[i];
+    }
+    if (old_table)
+        munmap(old_table, old_capacity * sizeof(ProfSample));
+    return 0;
+}
+
+/**
+ * Adds a sample. Called with the lock held.
+ * @return 0 on success. 1 if the table was full and could not grow.
+ */
+static int table_insert(const ProfSample* sample)
+{
+    if (2 * (count + 1) > capacity && table_grow())
+        return 1;
+
+    size_t slot = table_slot(sample->ptr);
+    while (table[slot].ptr)
+        slot = (slot + 1) & (capacity - 1);
+    table[slot] = *sample;
+    count++;
+    sampled_bytes += sample->size;
+
+    _Atomic uint8_t* filter = prof_filter_slot((const void*)sample->ptr);
+    uint8_t hits = atomic_load_explicit(filter, memory_order_relaxed);
+    if (hits < UINT8_MAX) // A saturated counter stays set
+        atomic_store_explicit(filter, hits + 1, memory_order_relaxed);
+    return 0;
+}
+
+/**
+ * Removes a sample, shifting later entries of its probe sequence back so lookups never need tombstones.
+ * Called with the lock held.
+ */
+static void table_remove(ProfSample* sample)
+{
+    _Atomic uint8_t* filter = prof_filter_slot((const void*)sample->ptr);
+    uint8_t hits = atomic_load_explicit(filter, memory_order_relaxed);
+    if (hits < UINT8_MAX)
+        atomic_store_explicit(filter, hits - 1, memory_order_relaxed);
+    count--;
+    sampled_bytes -= sample->size;
+
+    size_t hole = (size_t)(sample - table);
+    table[hole].ptr = 0;
+    for (size_t i = (hole + 1) & (capacity - 1); table[i].ptr; i = (i + 1) & (capacity - 1))
+    {
+        size_t home = table_slot(table[i].ptr);
+        if (((i - home) & (capacity - 1)) >= ((i - hole) & (capacity - 1))) // May move back into the hole
+        {
+            table[hole] = table[i];
+            table[i].ptr = 0;
+            hole = i;
+        }
+    }
+}
+
+/**
+ * Starts sampling, or changes the rate. Threads pick up the new rate within PROF_IDLE_BYTES of allocation.
+ * @param rate Mean bytes between two samples, e.g. PROF_DEFAULT_RATE
+ * @return 0 on success. 1 if the rate is 0.
+ */
+int prof_start(size_t rate)
+{
+    if (!rate)
+    {
+        RON_ERROR(RON_ECONFIG, NULL);
+        return 1;
+    }
+
+#ifdef __GLIBC__
+    // The first backtrace loads the unwinder, which allocates. Do it here, outside any allocator call.
+    void* warm_up[1];
+    backtrace(warm_up, 1);
+#endif
+    atomic_store(&sample_rate, rate);
+    prof_countdown = 0; // The calling thread starts right away
+    return 0;
+}
+
+/**
+ * Stops sampling. Live samples stay in the profile until they are freed.
+ */
+void prof_stop()
+{
+    atomic_store(&sample_rate, 0);
+}
+
+/**
+ * Slow path of prof_malloc, taken when the calling thread's countdown crosses zero.
+ * Samples the allocation if the thread was already counting at the current rate, then restarts the countdown.
+ * @param ptr The allocation
+ * @param size Its size in bytes
+ */
+void prof_sample(void* ptr, size_t size)
+{
+    static _Thread_local size_t thread_rate; // The rate the countdown was drawn for, 0 when idle
+    size_t rate = atomic_load_explicit(&sample_rate, memory_order_relaxed);
+    if (!rate)
+    {
+        thread_rate = 0;
+        prof_countdown = PROF_IDLE_BYTES;
+        return;
+    }
+    int armed = thread_rate == rate;
+    thread_rate = rate;
+    prof_countdown = next_interval(rate);
+    if (!armed) // A countdown that started at another rate (or idle) would skew the samples
+        return;
+
+    ProfSample sample;
+    sample.ptr = (uintptr_t)ptr;
+    sample.size = size;
+    sample.dumped = 0;
+    sample.depth = 0;
+#ifdef __GLIBC__
+    void* frames[PROF_MAX_DEPTH + PROF_SKIP_FRAMES];
+    int depth = backtrace(frames, PROF_MAX_DEPTH + PROF_SKIP_FRAMES) - PROF_SKIP_FRAMES;
+    if (depth > 0)
+    {
+        memcpy(sample.stack, frames + PROF_SKIP_FRAMES, (size_t)depth * sizeof(void*));
+        sample.depth = depth;
+    }
+#endif
+
+    pthread_mutex_lock(&lock);
+    ProfSample* stale = table_find(ptr); // Freed through a path without a hook, e.g. a thread cache
+    if (stale)
+        table_remove(stale);
+    if (table_insert(&sample))
+        dropped++;
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Slow path of prof_free, taken when the filter says the address may be sampled.
+ * @param ptr The allocation being freed
+ */
+void prof_forget(const void* ptr)
+{
+    pthread_mutex_lock(&lock);
+    ProfSample* sample = table_find(ptr);
+    if (sample)
+        table_remove(sample);
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Slow path of prof_realloc: a sampled allocation was resized, and possibly moved. It keeps its stack.
+ * @param old_ptr The address before the reallocation
+ * @param new_ptr The address after it
+ * @param size The new size in bytes
+ */
+void prof_move(const void* old_ptr, void* new_ptr, size_t size)
+{
+    pthread_mutex_lock(&lock);
+    ProfSample* sample = table_find(old_ptr);
+    if (sample)
+    {
+        ProfSample moved = *sample;
+        table_remove(sample);
+        ProfSample* replaced = table_find(new_ptr); // The move went through an allocation that was sampled too
+        if (replaced)
+            table_remove(replaced);
+        moved.ptr = (uintptr_t)new_ptr;
+        moved.size = size;
+        table_insert(&moved); // Can't fail: the table has just lost an entry
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+static int same_stack(const ProfSample* a, const ProfSample* b)
+{
+    return a->depth == b->depth && memcmp(a->stack, b->stack, (size_t)a->depth * sizeof(void*)) == 0;
+}
+
+/**
+ * Writes the live samples as a heap profile that pprof reads (see the format above):
+ *
+ *     pprof --text <program> <dump>
+ *
+ * @param file The file to write to
+ * @return 0 on success. 1 if the file could not be written.
+ */
+int prof_dump(FILE* file)
+{
+    pthread_mutex_lock(&lock);
+    unsigned int dump = ++dump_count;
+
+    int failed = fprintf(file, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n", count, sampled_bytes, count,
+                         sampled_bytes, atomic_load(&sample_rate)) < 0;
+
+    // Samples are few (the live heap over the rate), so stacks are grouped by a quadratic scan
+    for (size_t i = 0; i < capacity && !failed; i++)
+    {
+        if (!table[i].ptr || table[i].dumped == dump)
+            continue;
+
+        size_t objects = 0, bytes = 0;
+        for (size_t j = i; j < capacity; j++)
+        {
+            if (table[j].ptr && table[j].dumped != dump && same_stack(&table[i], &table[j]))
+            {
+                table[j].dumped = dump;
+                objects++;
+                bytes += table[j].size;
+            }
+        }
+
+        fprintf(file, "%zu: %zu [%zu: %zu] @", objects, bytes, objects, bytes);
+        for (int frame = 0; frame < table[i].depth; frame++)
+            fprintf(file, " %p", table[i].stack[frame]);
+        failed = fprintf(file, "\n") < 0;
+    }
+    pthread_mutex_unlock(&lock);
+
+    // pprof maps the addresses to binaries with the process's mappings
+    fprintf(file, "\nMAPPED_LIBRARIES:\n");
+    FILE* maps = fopen("/proc/self/maps", "r");
+    if (maps)
+    {
+        char buffer[4096];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), maps)) > 0)
+            fwrite(buffer, 1, read, file);
+        fclose(maps);
+    }
+
+    if (failed || fflush(file))
+    {
+        RON_ERROR(RON_EIO, NULL);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Takes a snapshot of the profiler's state.
+ * @param stats Receives the snapshot
+ */
+void prof_get_stats(prof_stats_t* stats)
+{
+    pthread_mutex_lock(&lock);
+    stats->rate = atomic_load(&sample_rate);
+    stats->samples = count;
+    stats->sampled_bytes = sampled_bytes;
+    stats->dropped = dropped;
+    pthread_mutex_unlock(&lock);
+}
+
+#ifdef RON_SELF_TEST
+#include "variable_size_allocatoron.h"
+
+#define OBJECT_COUNT 1000
+#define OBJECT_SIZE 100
+#define TEST_RATE 1024
+
+static char objects[OBJECT_COUNT][OBJECT_SIZE] __attribute__((aligned(8)));
+
+/**
+ * Allocates the test objects the way an allocator built with RON_PROFILE reports them.
+ */
+static void __attribute__((noinline)) allocate_objects()
+{
+    for (int i = 0; i < OBJECT_COUNT; i++)
+        prof_malloc(objects[i], OBJECT_SIZE);
+}
+
+/**
+ * The main function initializes the profiler and acts as a test suite.
+ *
+ * The implemented tests are:
+ * - Sampling at the configured rate
+ * - Frees and reallocations of sampled memory
+ * - Dumping a heap profile
+ * - Sampling inside the variable-size allocator (RON_PROFILE builds)
+ */
+int main()
+{
+    ron_set_error_handler(ron_print_error, NULL); // Failures are silent by default
+
+    printf("\nTest: Sampling\n");
+    prof_start(TEST_RATE);
+    allocate_objects();
+    prof_stats_t stats;
+    prof_get_stats(&stats);
+    // About OBJECT_COUNT * OBJECT_SIZE / TEST_RATE = 97 samples are expected
+    printf("\tSamples near the expected 97: %s\n", stats.samples > 40 && stats.samples < 200 ? "yes" : "no");
+    printf("\tSampled bytes: %s\n", stats.sampled_bytes == stats.samples * OBJECT_SIZE ? "yes" : "no");
+
+    printf("\nTest: Frees and reallocations\n");
+    prof_realloc(objects[0], objects[1], 2 * OBJECT_SIZE); // Merged into its neighbour
+    for (int i = 1; i < OBJECT_COUNT / 2; i++)
+        prof_free(objects[i]);
+    prof_stats_t half;
+    prof_get_stats(&half);
+    printf("\tFewer samples after freeing half: %s\n", half.samples < stats.samples ? "yes" : "no"); // Should print yes
+
+    printf("\nTest: Dump\n");
+    FILE* dump = tmpfile();
+    prof_dump(dump);
+    rewind(dump);
+    char line[256] = "";
+    size_t objects_in_header = 0, stack_lines = 0;
+    if (fgets(line, sizeof(line), dump))
+        sscanf(line, "heap profile: %zu:", &objects_in_header);
+    while (fgets(line, sizeof(line), dump) && line[0] != '\n')
+        stack_lines++;
+    fclose(dump);
+    printf("\tHeader counts the samples: %s\n", objects_in_header == half.samples ? "yes" : "no"); // Should print yes
+    printf("\tStacks grouped: %s\n", stack_lines >= 1 && stack_lines <= half.samples ? "yes" : "no"); // Should print yes
+    for (int i = OBJECT_COUNT / 2; i < OBJECT_COUNT; i++)
+        prof_free(objects[i]);
+    prof_get_stats(&stats);
+    printf("\tSamples left: %zu\n", stats.samples); // Should print 0
+
+#ifdef RON_PROFILE
+    printf("\nTest: Sampling in the variable-size allocator\n");
+    static char memory[1 << 20] __attribute__((aligned(8)));
+    vs_heap_t heap;
+    vs_init_heap(&heap, memory, sizeof(memory));
+    void* blocks[OBJECT_COUNT];
+    for (int i = 0; i < OBJECT_COUNT; i++)
+        blocks[i] = vs_malloc(&heap, OBJECT_SIZE);
+    prof_get_stats(&stats);
+    printf("\tSampled: %s\n", stats.samples > 0 ? "yes" : "no"); // Should print yes
+    for (int i = 0; i < OBJECT_COUNT; i++)
+        vs_free(&heap, blocks[i]);
+    prof_get_stats(&stats);
+    printf("\tSamples left: %zu\n", stats.samples); // Should print 0
+#endif
+
+    prof_stop();
+    prof_start(0); // Should print 'Invalid allocator configuration'
+    return 0;
+}
+#endif
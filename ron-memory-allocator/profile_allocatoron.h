@@ -0,0 +1,88 @@
+/**
+ * Sampled heap profiling, compiled into the allocators when RON_PROFILE is defined.
+ * See profile_allocatoron.c for the design notes and the dump format.
+ */
+
+#ifndef PROFILE_ALLOCATORON_H
+#define PROFILE_ALLOCATORON_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define PROF_DEFAULT_RATE ((size_t)512 * 1024) // Mean bytes allocated between two samples
+#define PROF_MAX_DEPTH 32 // Stack frames kept per sample
+#define PROF_FILTER_LOG2 12 // The filter of sampled addresses has 2^PROF_FILTER_LOG2 counters
+
+/**
+ * A snapshot taken by prof_get_stats.
+ *
+ * Fields:
+ * - `rate`: Mean bytes between two samples. 0 while profiling is stopped.
+ * - `samples`: Sampled allocations that are still live.
+ * - `sampled_bytes`: Requested bytes of those allocations (not scaled up by the rate).
+ * - `dropped`: Samples lost because the side table could not grow.
+ */
+typedef struct prof_stats_t
+{
+    size_t rate;
+    size_t samples;
+    size_t sampled_bytes;
+    size_t dropped;
+} prof_stats_t;
+
+int prof_start(size_t rate);
+void prof_stop();
+int prof_dump(FILE* file);
+void prof_get_stats(prof_stats_t* stats);
+
+/**
+ * Hot-path hooks of the allocators. Each thread counts down the bytes until its next sample, so an
+ * allocation that is not sampled costs one decrement, and a free that was not sampled one filter load.
+ */
+extern _Thread_local int64_t prof_countdown;
+extern _Atomic uint8_t prof_filter[1 << PROF_FILTER_LOG2];
+
+void prof_sample(void* ptr, size_t size);
+void prof_forget(const void* ptr);
+void prof_move(const void* old_ptr, void* new_ptr, size_t size);
+
+/**
+ * Returns the filter counter of an address: non-zero when the address may be a live sample.
+ */
+static inline _Atomic uint8_t* prof_filter_slot(const void* ptr)
+{
+    uint64_t hash = ((uint64_t)(uintptr_t)ptr >> 3) * 0x9E3779B97F4A7C15ULL;
+    return &prof_filter[hash >> (64 - PROF_FILTER_LOG2)];
+}
+
+static inline void prof_malloc(void* ptr, size_t size)
+{
+    if ((prof_countdown -= (int64_t)size) <= 0 && ptr)
+        prof_sample(ptr, size);
+}
+
+static inline void prof_free(const void* ptr)
+{
+    if (atomic_load_explicit(prof_filter_slot(ptr), memory_order_relaxed))
+        prof_forget(ptr);
+}
+
+static inline void prof_realloc(const void* old_ptr, void* new_ptr, size_t size)
+{
+    if (new_ptr && atomic_load_explicit(prof_filter_slot(old_ptr), memory_order_relaxed))
+        prof_move(old_ptr, new_ptr, size);
+}
+
+#ifdef RON_PROFILE
+#define PROF_MALLOC(ptr, size) prof_malloc(ptr, size)
+#define PROF_FREE(ptr) prof_free(ptr)
+#define PROF_REALLOC(old_ptr, new_ptr, size) prof_realloc(old_ptr, new_ptr, size)
+#else
+#define PROF_MALLOC(ptr, size) ((void)0)
+#define PROF_FREE(ptr) ((void)0)
+#define PROF_REALLOC(old_ptr, new_ptr, size) ((void)0)
+#endif
+
+#endif
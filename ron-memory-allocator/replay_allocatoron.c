@@ -0,0 +1,335 @@
+/**
+ * Replays an allocation trace (see trace_allocatoron.h) on one of the allocators, as fast as possible.
+ *
+ * Usage: replay_allocatoron <trace> [vs|fs|libc] [fs block size]
+ *
+ * - vs: A growable variable-size heap (1 MiB chunks, one kept mapped when free)
+ * - fs: A fixed-size pool for requests up to the block size (default 64), the growable heap for the rest
+ * - libc: The C library's malloc
+ *
+ * The trace is streamed, so its length is not limited by memory. The report lists the replay time,
+ * the peak live bytes requested by the trace, the peak footprint of the allocator, and the
+ * fragmentation (1 - live / footprint) sampled every SAMPLE_PERIOD events.
+ */
+
+#define _GNU_SOURCE // mallinfo2
+
+#include "fixed_size_allocatoron.h"
+#include "trace_allocatoron.h"
+#include "variable_size_allocatoron.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#define CHUNK_SIZE ((size_t)1 << 20) // Growth step of the heap
+#define POOL_BLOCK_COUNT ((size_t)1 << 18)
+#define DEFAULT_BLOCK_SIZE 64
+#define SAMPLE_PERIOD 4096 // Events between two footprint samples
+
+/**
+ * An allocator to replay on.
+ *
+ * Fields:
+ * - `name`: Name on the command line and in the report.
+ * - `setup`: Initializes the allocator. Returns 0 on success.
+ * - `malloc`, `free`, `realloc`: The allocation API.
+ * - `footprint`: Returns the bytes currently held by the allocator.
+ */
+typedef struct Target
+{
+    const char* name;
+    int (*setup)();
+    void* (*malloc)(size_t);
+    void (*free)(void*);
+    void* (*realloc)(void*, size_t);
+    size_t (*footprint)();
+} Target;
+
+static vs_heap_t heap;
+static fs_pool_t pool;
+static char* pool_memory;
+static size_t pool_block_size = DEFAULT_BLOCK_SIZE;
+static size_t pool_high_water; // Bytes of the pool up to the highest block handed out
+
+// Growable heap
+static int vs_setup()
+{
+    return vs_init_heap(&heap, NULL, 0) || vs_set_growth(&heap, CHUNK_SIZE, 1);
+}
+
+static void* vs_replay_malloc(size_t size)
+{
+    return vs_malloc(&heap, size);
+}
+
+static void vs_replay_free(void* ptr)
+{
+    vs_free(&heap, ptr);
+}
+
+static void* vs_replay_realloc(void* ptr, size_t size)
+{
+    return vs_realloc(&heap, ptr, size);
+}
+
+static size_t vs_replay_footprint()
+{
+    return vs_footprint(&heap);
+}
+
+// Fixed-size pool in front of the growable heap
+static int fs_setup()
+{
+    pool_memory = malloc(pool_block_size * POOL_BLOCK_COUNT);
+    return !pool_memory || fs_init_pool(&pool, pool_memory, pool_block_size, POOL_BLOCK_COUNT) || vs_setup();
+}
+
+static void* fs_replay_malloc(size_t size)
+{
+    if (size <= pool_block_size)
+    {
+        char* ptr = fs_malloc(&pool, size);
+        if (ptr)
+        {
+            size_t end = (size_t)(ptr - pool_memory) + pool_block_size;
+            if (end > pool_high_water)
+                pool_high_water = end;
+            return ptr;
+        }
+    }
+    return vs_malloc(&heap, size);
+}
+
+static void fs_replay_free(void* ptr)
+{
+    if (fs_owns(&pool, ptr))
+        fs_free(&pool, ptr);
+    else
+        vs_free(&heap, ptr);
+}
+
+static void* fs_replay_realloc(void* ptr, size_t size)
+{
+    if (!ptr)
+        return fs_replay_malloc(size);
+    if (!size)
+    {
+        fs_replay_free(ptr);
+        return NULL;
+    }
+
+    int in_pool = fs_owns(&pool, ptr);
+    if (in_pool && size <= pool_block_size) // Still fits its block
+        return ptr;
+    if (!in_pool && size > pool_block_size) // Stays in the heap
+        return vs_realloc(&heap, ptr, size);
+
+    // Moves between the pool and the heap. Replayed payloads hold no data, so nothing is copied
+    // (a copy would also overwrite the in-block metadata of a pool block with garbage).
+    void* new_ptr = fs_replay_malloc(size);
+    if (new_ptr)
+        fs_replay_free(ptr);
+    return new_ptr;
+}
+
+static size_t fs_replay_footprint()
+{
+    return pool_high_water + vs_footprint(&heap);
+}
+
+// The C library
+static int libc_setup()
+{
+    return 0;
+}
+
+static size_t libc_footprint()
+{
+#ifdef __GLIBC__
+    struct mallinfo2 info = mallinfo2();
+    return info.arena + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+static const Target targets[] = {
+    { "vs", vs_setup, vs_replay_malloc, vs_replay_free, vs_replay_realloc, vs_replay_footprint },
+    { "fs", fs_setup, fs_replay_malloc, fs_replay_free, fs_replay_realloc, fs_replay_footprint },
+    { "libc", libc_setup, malloc, free, realloc, libc_footprint },
+};
+
+#define TARGET_COUNT (sizeof(targets) / sizeof(targets[0]))
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * The live objects of the replay, indexed by trace id.
+ */
+static void** objects;
+static uint32_t* sizes;
+static size_t object_capacity;
+
+/**
+ * Makes room for the given id in the object table.
+ * @return 0 on success. 1 if the C library is out of memory.
+ */
+static int reserve_id(uint32_t id)
+{
+    if (id < object_capacity)
+        return 0;
+
+    size_t capacity = object_capacity ? object_capacity : 1024;
+    while (capacity <= id)
+        capacity *= 2;
+
+    void** new_objects = realloc(objects, capacity * sizeof(*objects));
+    if (!new_objects)
+        return 1;
+    objects = new_objects;
+    uint32_t* new_sizes = realloc(sizes, capacity * sizeof(*sizes));
+    if (!new_sizes)
+        return 1;
+    sizes = new_sizes;
+
+    memset(objects + object_capacity, 0, (capacity - object_capacity) * sizeof(*objects));
+    memset(sizes + object_capacity, 0, (capacity - object_capacity) * sizeof(*sizes));
+    object_capacity = capacity;
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <trace> [vs|fs|libc] [fs block size]\n", argv[0]);
+        return 1;
+    }
+
+    const Target* target = &targets[0];
+    if (argc > 2)
+    {
+        target = NULL;
+        for (size_t i = 0; i < TARGET_COUNT; i++)
+        {
+            if (strcmp(argv[2], targets[i].name) == 0)
+                target = &targets[i];
+        }
+        if (!target)
+        {
+            printf("Unknown allocator %s\n", argv[2]);
+            return 1;
+        }
+    }
+    if (argc > 3)
+        pool_block_size = strtoul(argv[3], NULL, 10);
+
+    static trace_reader_t reader;
+    if (trace_open_reader(&reader, argv[1]))
+        return 1;
+    if (target->setup())
+    {
+        printf("ERROR: Failed to initialize allocator\n");
+        return 1;
+    }
+
+    size_t counts[4] = { 0 };
+    size_t failed = 0;
+    size_t live = 0, peak_live = 0;
+    size_t peak_footprint = 0, live_at_peak = 0;
+    double fragmentation_sum = 0;
+    size_t samples = 0;
+    uint64_t trace_ns = 0;
+    size_t events = 0;
+
+    uint64_t start = now_ns();
+    const trace_event_t* event;
+    while ((event = trace_next(&reader)))
+    {
+        trace_ns += event->delta_ns;
+        if (event->op < TRACE_MALLOC || event->op > TRACE_REALLOC || reserve_id(event->id))
+        {
+            printf("Skipping invalid event %zu\n", events);
+            continue;
+        }
+        counts[event->op]++;
+
+        void** object = &objects[event->id];
+        void* result = NULL;
+        switch (event->op)
+        {
+        case TRACE_MALLOC:
+            result = target->malloc(event->size);
+            break;
+        case TRACE_FREE:
+            target->free(*object);
+            break;
+        case TRACE_REALLOC:
+            result = target->realloc(*object, event->size);
+            break;
+        }
+
+        // A failed malloc or realloc leaves the object as it was, like realloc leaves its block
+        if (event->op != TRACE_FREE && !result && event->size)
+        {
+            failed++;
+        }
+        else
+        {
+            *object = result;
+            live -= sizes[event->id];
+            sizes[event->id] = result ? event->size : 0;
+            live += sizes[event->id];
+        }
+        if (live > peak_live)
+            peak_live = live;
+
+        if (++events % SAMPLE_PERIOD == 0)
+        {
+            size_t footprint = target->footprint();
+            if (footprint > peak_footprint)
+            {
+                peak_footprint = footprint;
+                live_at_peak = live;
+            }
+            if (footprint)
+            {
+                fragmentation_sum += 1.0 - (double)live / (double)footprint;
+                samples++;
+            }
+        }
+    }
+    double seconds = (double)(now_ns() - start) / 1e9;
+    trace_close_reader(&reader);
+
+    size_t footprint = target->footprint();
+    if (footprint > peak_footprint)
+    {
+        peak_footprint = footprint;
+        live_at_peak = live;
+    }
+
+    printf("Trace: %zu events (%zu malloc, %zu free, %zu realloc) over %.3f s\n", events, counts[TRACE_MALLOC],
+           counts[TRACE_FREE], counts[TRACE_REALLOC], (double)trace_ns / 1e9);
+    printf("Replay on %s: %.3f s, %.2f Mops/s, %zu failed allocations\n", target->name, seconds,
+           (double)events / seconds / 1e6, failed);
+    printf("Peak live: %zu KiB, peak footprint: %zu KiB\n", peak_live / 1024, peak_footprint / 1024);
+    printf("Fragmentation: average %.1f%%, at peak footprint %.1f%%, final %.1f%%\n",
+           samples ? 100.0 * fragmentation_sum / (double)samples : 0.0,
+           peak_footprint ? 100.0 * (1.0 - (double)live_at_peak / (double)peak_footprint) : 0.0,
+           footprint ? 100.0 * (1.0 - (double)live / (double)footprint) : 0.0);
+
+    return 0;
+}
@@ -0,0 +1,607 @@
+/**
+ * Multi-threaded scalability benchmark for the thread-safe allocator layers, compared against other mallocs.
+ *
+ * Usage: scaling_allocatoron [max threads] (default: the number of online CPUs)
+ *
+ * Every workload runs with 1, 2, 4, ... threads up to the maximum:
+ * - larson: Each thread replaces random blocks (8 to 1000 bytes) of a set of live blocks. Between two epochs
+ *   the sets rotate to the next thread, so most blocks are freed by another thread than the one that allocated them
+ * - threadtest: Each thread allocates a batch of 64-byte blocks and frees it, over and over
+ * - xmalloc: Each thread fills a batch with blocks of 16 to 512 bytes and trades it through a shared stack
+ *   for a batch filled by any thread, then frees that batch (producer/consumer between all threads)
+ * - cache-scratch: Each thread frees an 8-byte block allocated next to the other threads' blocks, then allocates
+ *   8-byte blocks and writes them many times. An allocator that hands the freed block back causes false sharing
+ *
+ * Allocators:
+ * - tc-fs, tc-vs: Thread caches in front of a fixed-size pool (64-byte blocks) and a growable variable-size heap
+ * - pc: Per-CPU caches in front of a slab allocator, with the growable heap for larger requests
+ * - fs-lf: The lock-free fixed-size pool, built with FS_LOCK_FREE only
+ * - libc: The C library's malloc. Run the benchmark under LD_PRELOAD=libron_malloc.so to measure the drop-in library
+ * - jemalloc, mimalloc: Loaded with dlopen when their shared libraries are installed, skipped otherwise
+ *
+ * Each run forks a child, so every allocator starts from a fresh process and the peak RSS of the run is its own
+ * (including the couple of MiB of the process itself). The pool and the slab region are sized for the thread count
+ * and linked when they are initialized, so they count in full. The report lists, per workload, allocator and thread count,
+ * the operations (mallocs and frees), the throughput in millions of operations per second, the speedup over
+ * the allocator's one-thread run and the peak RSS.
+ *
+ * Throughputs are only comparable on an idle machine. Build with -DCMAKE_BUILD_TYPE=Release.
+ */
+
+#define _GNU_SOURCE // wait4
+
+#include "fixed_size_allocatoron.h"
+#include "percpu_allocatoron.h"
+#include "slab_allocatoron.h"
+#include "thread_cache_allocatoron.h"
+#include "variable_size_allocatoron.h"
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CHUNK_SIZE ((size_t)1 << 20) // Growth step of the heap
+#define SLAB_SPAN ((size_t)512 << 10) // Slab memory per size class and thread
+#define POOL_BLOCK_SIZE 64 // Fixed-size pool block, also the threadtest object size
+#define POOL_SPARE_BLOCKS 64 // Pool blocks per thread beyond the live threadtest batch
+#define MAX_THREADS 256
+
+#define LARSON_SLOTS 1000 // Live blocks per set
+#define LARSON_EPOCHS 8
+#define LARSON_OPS 100000 // Replacements per thread and epoch
+#define LARSON_MIN_SIZE 8
+#define LARSON_MAX_SIZE 1000
+#define THREADTEST_ROUNDS 100
+#define THREADTEST_OBJECTS 10000
+#define XMALLOC_BATCH 64
+#define XMALLOC_ROUNDS 10000
+#define XMALLOC_MIN_SIZE 16
+#define XMALLOC_MAX_SIZE 512
+#define SCRATCH_SIZE 8
+#define SCRATCH_ROUNDS 20000
+#define SCRATCH_WRITES 1000
+
+static vs_heap_t heap;
+static fs_pool_t pool;
+static slab_t slab;
+static pc_heap_t percpu;
+
+// The run in progress, set before the allocator's setup
+static size_t thread_count;
+
+/**
+ * An allocator under test.
+ *
+ * Fields:
+ * - `name`: Name in the report.
+ * - `setup`: Prepares the allocator in the child process. Returns 1 if the allocator is not available.
+ * - `thread_exit`: Releases what a thread holds, before it exits. May be NULL.
+ * - `malloc`, `free`: The allocation API. Both must be callable from any thread.
+ * - `max_size`: Largest request the allocator serves. 0 for any size.
+ */
+typedef struct Allocator
+{
+    const char* name;
+    int (*setup)();
+    void (*thread_exit)();
+    void* (*malloc)(size_t);
+    void (*free)(void*);
+    size_t max_size;
+} Allocator;
+
+/**
+ * Maps memory that no allocator under test manages: the reserved regions and the workloads' own tables.
+ * The child exits without unmapping it.
+ */
+static void* map_memory(size_t size)
+{
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+}
+
+static int heap_setup()
+{
+    return vs_init_heap(&heap, NULL, 0) || vs_set_growth(&heap, CHUNK_SIZE, 1);
+}
+
+/**
+ * Sizes the pool for the run. fs_init_pool links every block, so the whole pool counts in the peak RSS.
+ */
+static int pool_setup()
+{
+    size_t block_count = thread_count * (THREADTEST_OBJECTS + POOL_SPARE_BLOCKS);
+    void* memory = map_memory(POOL_BLOCK_SIZE * block_count);
+    return !memory || fs_init_pool(&pool, memory, POOL_BLOCK_SIZE, block_count);
+}
+
+// Thread caches in front of the pool and the heap
+static int tc_setup()
+{
+    if (pool_setup() || heap_setup())
+        return 1;
+    tc_init(&pool, &heap);
+    return 0;
+}
+
+// Per-CPU caches in front of the slab allocator, sized for the run like the pool
+static int pc_setup()
+{
+    size_t size = thread_count * SLAB_CLASS_COUNT * SLAB_SPAN;
+    void* memory = map_memory(size);
+    return !memory || heap_setup() || slab_init(&slab, memory, size, &heap) || pc_init(&percpu, &slab);
+}
+
+static void* pc_bench_malloc(size_t size)
+{
+    return pc_malloc(&percpu, size);
+}
+
+static void pc_bench_free(void* ptr)
+{
+    pc_free(&percpu, ptr);
+}
+
+#ifdef FS_LOCK_FREE
+// The lock-free pool, shared by all threads without a cache (see pool_setup)
+static void* fs_bench_malloc(size_t size)
+{
+    return fs_malloc(&pool, size);
+}
+
+static void fs_bench_free(void* ptr)
+{
+    fs_free(&pool, ptr);
+}
+#endif
+
+// The C library
+static int libc_setup()
+{
+    return 0;
+}
+
+// Allocators loaded at run time. Their symbols are looked up in their own library only.
+static void* (*loaded_malloc)(size_t);
+static void (*loaded_free)(void*);
+
+static int load_allocator(const char* const* libraries, const char* malloc_name, const char* free_name)
+{
+    for (const char* const* library = libraries; *library; library++)
+    {
+        void* handle = dlopen(*library, RTLD_NOW | RTLD_LOCAL);
+        if (!handle)
+            continue;
+        loaded_malloc = (void* (*)(size_t))dlsym(handle, malloc_name);
+        loaded_free = (void (*)(void*))dlsym(handle, free_name);
+        if (loaded_malloc && loaded_free)
+            return 0;
+    }
+    return 1;
+}
+
+static int jemalloc_setup()
+{
+    static const char* const libraries[] = { "libjemalloc.so.2", "libjemalloc.so", NULL };
+    return load_allocator(libraries, "malloc", "free");
+}
+
+static int mimalloc_setup()
+{
+    static const char* const libraries[] = { "libmimalloc.so.2", "libmimalloc.so", NULL };
+    return load_allocator(libraries, "mi_malloc", "mi_free");
+}
+
+static void* loaded_bench_malloc(size_t size)
+{
+    return loaded_malloc(size);
+}
+
+static void loaded_bench_free(void* ptr)
+{
+    loaded_free(ptr);
+}
+
+static const Allocator allocators[] = {
+    { "tc-fs", tc_setup, tc_flush, tc_fs_malloc, tc_fs_free, POOL_BLOCK_SIZE },
+    { "tc-vs", tc_setup, tc_flush, tc_vs_malloc, tc_vs_free, 0 },
+    { "pc", pc_setup, NULL, pc_bench_malloc, pc_bench_free, 0 },
+#ifdef FS_LOCK_FREE
+    { "fs-lf", pool_setup, NULL, fs_bench_malloc, fs_bench_free, POOL_BLOCK_SIZE },
+#endif
+    { "libc", libc_setup, NULL, malloc, free, 0 },
+    { "jemalloc", jemalloc_setup, NULL, loaded_bench_malloc, loaded_bench_free, 0 },
+    { "mimalloc", mimalloc_setup, NULL, loaded_bench_malloc, loaded_bench_free, 0 },
+};
+
+#define ALLOCATOR_COUNT (sizeof(allocators) / sizeof(allocators[0]))
+
+static const Allocator* current;
+static pthread_barrier_t epoch_barrier; // The worker threads only
+static pthread_barrier_t start_barrier; // The worker threads and the timing thread
+
+/**
+ * Deterministic xorshift generator, one state per thread.
+ */
+static uint64_t next_random(uint64_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static size_t random_between(uint64_t* state, size_t low, size_t high)
+{
+    return low + (size_t)(next_random(state) % (high - low + 1));
+}
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Fails the run when an allocator runs out of memory instead of measuring the error path.
+ */
+static void* checked_malloc(size_t size)
+{
+    void* ptr = current->malloc(size);
+    if (!ptr)
+    {
+        fprintf(stderr, "%s: allocation of %zu bytes failed\n", current->name, size);
+        _exit(1);
+    }
+    return ptr;
+}
+
+// larson: the sets of live blocks, LARSON_SLOTS per thread
+static void** larson_sets;
+
+static int larson_prepare()
+{
+    larson_sets = map_memory(thread_count * LARSON_SLOTS * sizeof(void*));
+    return !larson_sets;
+}
+
+static uint64_t larson(size_t thread)
+{
+    uint64_t state = 0x9E3779B97F4A7C15ULL + thread;
+    void** set = &larson_sets[thread * LARSON_SLOTS];
+    for (size_t i = 0; i < LARSON_SLOTS; i++)
+        set[i] = checked_malloc(random_between(&state, LARSON_MIN_SIZE, LARSON_MAX_SIZE));
+
+    for (size_t epoch = 0; epoch < LARSON_EPOCHS; epoch++)
+    {
+        pthread_barrier_wait(&epoch_barrier); // No set changes hands while its previous owner still works on it
+        set = &larson_sets[(thread + epoch) % thread_count * LARSON_SLOTS];
+        for (size_t op = 0; op < LARSON_OPS; op++)
+        {
+            size_t slot = (size_t)(next_random(&state) % LARSON_SLOTS);
+            current->free(set[slot]);
+            set[slot] = checked_malloc(random_between(&state, LARSON_MIN_SIZE, LARSON_MAX_SIZE));
+        }
+    }
+
+    pthread_barrier_wait(&epoch_barrier);
+    for (size_t i = 0; i < LARSON_SLOTS; i++)
+        current->free(set[i]);
+    return 2 * (LARSON_SLOTS + (uint64_t)LARSON_EPOCHS * LARSON_OPS);
+}
+
+// threadtest: one batch per thread
+static void** threadtest_batches;
+
+static int threadtest_prepare()
+{
+    threadtest_batches = map_memory(thread_count * THREADTEST_OBJECTS * sizeof(void*));
+    return !threadtest_batches;
+}
+
+static uint64_t threadtest(size_t thread)
+{
+    void** batch = &threadtest_batches[thread * THREADTEST_OBJECTS];
+    for (size_t round = 0; round < THREADTEST_ROUNDS; round++)
+    {
+        for (size_t i = 0; i < THREADTEST_OBJECTS; i++)
+            batch[i] = checked_malloc(POOL_BLOCK_SIZE);
+        for (size_t i = 0; i < THREADTEST_OBJECTS; i++)
+            current->free(batch[i]);
+    }
+    return 2 * (uint64_t)THREADTEST_ROUNDS * THREADTEST_OBJECTS;
+}
+
+/**
+ * xmalloc: full batches wait on a shared stack. A thread pushes one batch first, then trades each batch it fills
+ * for the one on top and frees that, so batches, and the blocks in them, move between threads.
+ * Its last pop balances the first push, so the stack is never empty while a thread trades, and empty at the end.
+ */
+typedef struct Batch
+{
+    struct Batch* next;
+    void* blocks[XMALLOC_BATCH];
+} Batch;
+
+static Batch* xmalloc_records; // Two per thread
+static Batch* xmalloc_full;
+static pthread_mutex_t xmalloc_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int xmalloc_prepare()
+{
+    xmalloc_records = map_memory(2 * thread_count * sizeof(Batch));
+    xmalloc_full = NULL;
+    return !xmalloc_records;
+}
+
+static void fill_batch(Batch* batch, uint64_t* state)
+{
+    for (size_t i = 0; i < XMALLOC_BATCH; i++)
+        batch->blocks[i] = checked_malloc(random_between(state, XMALLOC_MIN_SIZE, XMALLOC_MAX_SIZE));
+}
+
+static void free_batch(Batch* batch)
+{
+    for (size_t i = 0; i < XMALLOC_BATCH; i++)
+        current->free(batch->blocks[i]);
+}
+
+static uint64_t xmalloc(size_t thread)
+{
+    uint64_t state = 0x9E3779B97F4A7C15ULL + thread;
+    Batch* batch = &xmalloc_records[2 * thread];
+    fill_batch(batch, &state);
+    pthread_mutex_lock(&xmalloc_lock);
+    batch->next = xmalloc_full;
+    xmalloc_full = batch;
+    pthread_mutex_unlock(&xmalloc_lock);
+
+    batch = &xmalloc_records[2 * thread + 1];
+    for (size_t round = 0; round < XMALLOC_ROUNDS; round++)
+    {
+        fill_batch(batch, &state);
+        pthread_mutex_lock(&xmalloc_lock);
+        Batch* taken = xmalloc_full;
+        batch->next = taken->next;
+        xmalloc_full = batch;
+        pthread_mutex_unlock(&xmalloc_lock);
+
+        free_batch(taken);
+        batch = taken;
+    }
+
+    pthread_mutex_lock(&xmalloc_lock);
+    batch = xmalloc_full;
+    xmalloc_full = batch->next;
+    pthread_mutex_unlock(&xmalloc_lock);
+    free_batch(batch);
+    return 2 * (uint64_t)(XMALLOC_ROUNDS + 1) * XMALLOC_BATCH;
+}
+
+// cache-scratch: one block per thread, allocated side by side before the threads start
+static char** scratch_blocks;
+
+static int scratch_prepare()
+{
+    scratch_blocks = map_memory(thread_count * sizeof(char*));
+    if (!scratch_blocks)
+        return 1;
+    for (size_t i = 0; i < thread_count; i++)
+        scratch_blocks[i] = checked_malloc(SCRATCH_SIZE);
+    return 0;
+}
+
+static uint64_t cache_scratch(size_t thread)
+{
+    current->free(scratch_blocks[thread]);
+    for (size_t round = 0; round < SCRATCH_ROUNDS; round++)
+    {
+        volatile char* block = checked_malloc(SCRATCH_SIZE);
+        for (size_t i = 0; i < SCRATCH_WRITES; i++)
+        {
+            for (size_t j = 0; j < SCRATCH_SIZE; j++)
+                block[j] = (char)(block[j] + 1);
+        }
+        current->free((void*)block);
+    }
+    return 1 + 2 * (uint64_t)SCRATCH_ROUNDS;
+}
+
+/**
+ * A benchmark workload.
+ *
+ * Fields:
+ * - `name`: Name in the report.
+ * - `prepare`: Sets up the run's tables before the threads start. Returns 1 on failure.
+ * - `run`: The work of one thread. Returns the operations it made.
+ * - `max_size`: Largest request the workload makes.
+ */
+typedef struct Workload
+{
+    const char* name;
+    int (*prepare)();
+    uint64_t (*run)(size_t thread);
+    size_t max_size;
+} Workload;
+
+static const Workload workloads[] = {
+    { "larson", larson_prepare, larson, LARSON_MAX_SIZE },
+    { "threadtest", threadtest_prepare, threadtest, POOL_BLOCK_SIZE },
+    { "xmalloc", xmalloc_prepare, xmalloc, XMALLOC_MAX_SIZE },
+    { "cache-scratch", scratch_prepare, cache_scratch, SCRATCH_SIZE },
+};
+
+#define WORKLOAD_COUNT (sizeof(workloads) / sizeof(workloads[0]))
+
+/**
+ * The outcome of a run, written by the child to the parent.
+ *
+ * Fields:
+ * - `status`: 0 if the run completed, 1 if the allocator is not available, 2 if the run failed.
+ * - `ops`: Operations of all threads.
+ * - `ns`: Wall-clock time from the start of the threads to the last join.
+ */
+typedef struct Result
+{
+    int status;
+    uint64_t ops;
+    uint64_t ns;
+} Result;
+
+static const Workload* workload;
+static _Atomic uint64_t total_ops;
+
+static void* worker(void* arg)
+{
+    size_t thread = (size_t)(uintptr_t)arg;
+    pthread_barrier_wait(&start_barrier);
+    uint64_t ops = workload->run(thread);
+    if (current->thread_exit)
+        current->thread_exit();
+    atomic_fetch_add(&total_ops, ops);
+    return NULL;
+}
+
+/**
+ * Runs one workload on one allocator with the given thread count, in the child process.
+ */
+static Result run_child(const Allocator* a, const Workload* w, size_t threads)
+{
+    Result result = { 0, 0, 0 };
+    current = a;
+    workload = w;
+    thread_count = threads;
+    if (a->setup())
+    {
+        result.status = 1;
+        return result;
+    }
+    if (w->prepare())
+    {
+        result.status = 2;
+        return result;
+    }
+
+    pthread_barrier_init(&epoch_barrier, NULL, (unsigned)threads);
+    pthread_barrier_init(&start_barrier, NULL, (unsigned)threads + 1);
+    pthread_t handles[MAX_THREADS];
+    for (size_t i = 0; i < threads; i++)
+    {
+        if (pthread_create(&handles[i], NULL, worker, (void*)(uintptr_t)i))
+        {
+            fprintf(stderr, "%s: cannot start thread %zu\n", a->name, i);
+            _exit(1);
+        }
+    }
+
+    pthread_barrier_wait(&start_barrier);
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < threads; i++)
+        pthread_join(handles[i], NULL);
+    result.ns = now_ns() - start;
+    result.ops = atomic_load(&total_ops);
+    return result;
+}
+
+/**
+ * Runs one workload on one allocator in a fresh child process.
+ * @param max_rss Set to the child's peak RSS in KiB
+ * @return The child's result. Status 2 if the child died.
+ */
+static Result run(const Allocator* a, const Workload* w, size_t threads, long* max_rss)
+{
+    Result result = { 2, 0, 0 };
+    *max_rss = 0;
+    int fds[2];
+    if (pipe(fds))
+        return result;
+
+    fflush(stdout); // Not duplicated into the child's buffer
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        Result child = run_child(a, w, threads);
+        _exit(write(fds[1], &child, sizeof(child)) == sizeof(child) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    if (pid > 0)
+    {
+        if (read(fds[0], &result, sizeof(result)) != sizeof(result))
+            result.status = 2;
+        int status;
+        struct rusage usage;
+        if (wait4(pid, &status, 0, &usage) == pid)
+            *max_rss = usage.ru_maxrss;
+    }
+    close(fds[0]);
+    return result;
+}
+
+/**
+ * Runs every workload on every allocator with 1, 2, 4, ... threads and prints one row per run.
+ */
+int main(int argc, char** argv)
+{
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t max_threads = argc > 1 ? strtoul(argv[1], NULL, 10) : online > 0 ? (size_t)online : 1;
+    if (max_threads < 1 || max_threads > MAX_THREADS)
+    {
+        fprintf(stderr, "usage: %s [max threads, 1 to %d]\n", argv[0], MAX_THREADS);
+        return 1;
+    }
+
+    int available[ALLOCATOR_COUNT];
+    for (size_t i = 0; i < ALLOCATOR_COUNT; i++)
+        available[i] = 1;
+
+    printf("%-14s %-9s %7s %11s %9s %8s %12s\n",
+           "workload", "alloc", "threads", "ops", "Mops/s", "speedup", "peak RSS KiB");
+    for (size_t w = 0; w < WORKLOAD_COUNT; w++)
+    {
+        for (size_t i = 0; i < ALLOCATOR_COUNT; i++)
+        {
+            const Allocator* a = &allocators[i];
+            if (!available[i] || (a->max_size && a->max_size < workloads[w].max_size))
+                continue;
+
+            double single = 0; // Throughput of the one-thread run
+            for (size_t threads = 1;; threads = threads * 2 < max_threads ? threads * 2 : max_threads)
+            {
+                long max_rss;
+                Result result = run(a, &workloads[w], threads, &max_rss);
+                if (result.status == 1)
+                {
+                    printf("%-14s %-9s not available\n", workloads[w].name, a->name);
+                    available[i] = 0;
+                    break;
+                }
+                if (result.status)
+                {
+                    printf("%-14s %-9s %7zu failed\n", workloads[w].name, a->name, threads);
+                    break;
+                }
+
+                double throughput = (double)result.ops / ((double)result.ns / 1e9) / 1e6;
+                if (threads == 1)
+                    single = throughput;
+                printf("%-14s %-9s %7zu %11llu %9.2f %8.2f %12ld\n", workloads[w].name, a->name, threads,
+                       (unsigned long long)result.ops, throughput, throughput / single, max_rss);
+                if (threads == max_threads)
+                    break;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,282 @@
+/**
+ * A multi-class slab allocator built from fixed-size pools.
+ *
+ * - One fixed-size pool per size class (24, 32, 48, 64, 96, ... 3072, 4096 bytes)
+ * - Requests are routed to the smallest class that fits, in O(1)
+ * - Frees are routed by address: every class owns an equal slice of the region, so the class
+ *   of a pointer is its offset divided by the slice size. Objects carry no extra header.
+ * - O(1) LIFO allocation and deallocation inside each class (see fixed_size_allocatoron.c)
+ * - Requests above SLAB_MAX_SIZE, or for an exhausted class, fall through to a variable-size heap
+ * - slab_calloc skips the blocks that were never handed out in a region declared with slab_set_zeroed
+ *
+ * Operates on a caller-provided region without calling malloc/free.
+ */
+
+#include "slab_allocatoron.h"
+#include "error_allocatoron.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Size classes grow by alternating steps of 1.5x and 1.33x above 32 bytes,
+ * which bounds the internal waste of a request to a third of its class.
+ * The smallest class is 24 bytes because a free fixed-size block must be larger than its FreeBlock.
+ */
+static const size_t class_sizes[SLAB_CLASS_COUNT] = {
+    24, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096
+};
+
+/**
+ * Returns the index of the smallest class that fits the size (size must not exceed SLAB_MAX_SIZE).
+ * Above 32 bytes, each power of two interval (2^k, 2^(k+1)] holds two classes: 1.5 * 2^k and 2^(k+1).
+ */
+static size_t class_index_of(size_t size)
+{
+    if (size <= 24)
+        return 0;
+    if (size <= 32)
+        return 1;
+
+    int k = 63 - __builtin_clzll((unsigned long long)(size - 1)); // 2^k < size <= 2^(k+1)
+    size_t index = 2 * (size_t)(k - 5) + 2;
+    if (size > ((size_t)3 << (k - 1))) // Above 1.5 * 2^k
+        index++;
+
+    return index;
+}
+
+/**
+ * Returns the index of the smallest class that fits a size.
+ * @param size The request size. Must not exceed SLAB_MAX_SIZE.
+ */
+size_t slab_class_index(size_t size)
+{
+    return class_index_of(size);
+}
+
+/**
+ * Returns the block size of a class.
+ * @param class_index The class index, below SLAB_CLASS_COUNT
+ */
+size_t slab_class_size(size_t class_index)
+{
+    return class_sizes[class_index];
+}
+
+/**
+ * Initializes a slab allocator over a memory region.
+ * The region is cut into SLAB_CLASS_COUNT equal slices, each managed by a fixed-size pool.
+ * @param slab The slab handle to initialize
+ * @param memory The region to manage. Must be 8-byte aligned.
+ * @param size The size of the region in bytes. Each slice must hold at least SLAB_MIN_SPAN bytes.
+ * @param large The heap for requests no class can serve. May be NULL.
+ * @return 0 on successful initialization. 1 Otherwise.
+ */
+int slab_init(slab_t* slab, void* memory, size_t size, vs_heap_t* large)
+{
+    size_t span = (size / SLAB_CLASS_COUNT) & ~(size_t)7; // Keep every slice 8-byte aligned
+    if (!slab || !memory || (uintptr_t)memory % 8 != 0 || span < SLAB_MIN_SPAN)
+    {
+        RON_ERROR(RON_ECONFIG, memory);
+        return 1;
+    }
+
+    slab->memory = memory;
+    slab->span = span;
+    slab->large = large;
+
+    for (size_t i = 0; i < SLAB_CLASS_COUNT; i++)
+    {
+        if (fs_init_pool(&slab->classes[i], slab->memory + i * span, class_sizes[i], span / class_sizes[i]))
+            return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Allocates memory from the smallest size class that fits.
+ * @param slab The slab allocator to allocate from
+ * @param size The size of the memory to allocate
+ * @return A pointer to the usable allocated memory
+ */
+void* slab_malloc(slab_t* slab, size_t size)
+{
+    if (size <= SLAB_MAX_SIZE)
+    {
+        void* ptr = fs_malloc(&slab->classes[class_index_of(size)], size);
+        if (ptr)
+            return ptr;
+    }
+
+    // Too large for any class, or the class is exhausted
+    if (!slab->large)
+        return NULL;
+    return vs_malloc(slab->large, size);
+}
+
+/**
+ * Allocates zeroed memory for count elements of the given size, like slab_malloc.
+ * Blocks of the size classes are cleared by fs_calloc, which skips never used blocks of a zeroed region.
+ * @param slab The slab allocator to allocate from
+ * @param count The number of elements
+ * @param size The size of each element
+ * @return A pointer to the zeroed memory, or NULL on failure.
+ */
+void* slab_calloc(slab_t* slab, size_t count, size_t size)
+{
+    if (size && count > SIZE_MAX / size)
+    {
+        RON_ERROR(RON_ENOMEM, NULL);
+        return NULL;
+    }
+
+    size_t total = count * size;
+    if (total <= SLAB_MAX_SIZE)
+    {
+        void* ptr = fs_calloc(&slab->classes[class_index_of(total)], 1, total);
+        if (ptr)
+            return ptr;
+    }
+
+    // Too large for any class, or the class is exhausted
+    if (!slab->large)
+        return NULL;
+    return vs_calloc(slab->large, 1, total);
+}
+
+/**
+ * Declares that the slab region was zero-filled when slab_init set it up (static storage, or pages fresh
+ * from the OS), so slab_calloc can skip the blocks that were never handed out (see fs_set_zeroed).
+ * The heap for larger requests is declared separately, with vs_set_zeroed. Must be called before the
+ * first allocation.
+ * @param slab The slab allocator to mark
+ */
+void slab_set_zeroed(slab_t* slab)
+{
+    for (size_t i = 0; i < SLAB_CLASS_COUNT; i++)
+    {
+        fs_set_zeroed(&slab->classes[i]);
+    }
+}
+
+/**
+ * Checks whether a pointer lies within the slab region. Does not check that it is a block start.
+ * @param slab The slab allocator to check against
+ * @param ptr The pointer to check
+ * @return 1 if the pointer is within the slab region. 0 Otherwise.
+ */
+int slab_owns(const slab_t* slab, const void* ptr)
+{
+    return (const char*)ptr >= slab->memory && (const char*)ptr < slab->memory + slab->span * SLAB_CLASS_COUNT;
+}
+
+/**
+ * Frees memory returned by slab_malloc.
+ * The owning class is found from the address alone.
+ * @param slab The slab allocator the memory was allocated from
+ * @param ptr A pointer to the used memory
+ */
+void slab_free(slab_t* slab, void* ptr)
+{
+    if (slab_owns(slab, ptr))
+    {
+        fs_free(&slab->classes[((char*)ptr - slab->memory) / slab->span], ptr);
+        return;
+    }
+
+    if (slab->large)
+    {
+        vs_free(slab->large, ptr);
+        return;
+    }
+
+    RON_ERROR(RON_EINVAL, ptr);
+}
+
+/**
+ * Returns the usable size of memory returned by slab_malloc.
+ * @param slab The slab allocator the memory was allocated from
+ * @param ptr A pointer to the used memory
+ * @return The usable size in bytes, or 0 for a pointer the slab allocator does not know.
+ */
+size_t slab_usable_size(const slab_t* slab, const void* ptr)
+{
+    if (slab_owns(slab, ptr))
+        return class_sizes[((const char*)ptr - slab->memory) / slab->span];
+
+    if (slab->large)
+        return vs_usable_size(slab->large, ptr);
+
+    return 0;
+}
+
+#ifdef RON_SELF_TEST
+#define SLAB_POOL_SIZE (SLAB_MIN_SPAN * SLAB_CLASS_COUNT) // Smallest valid slab region
+#define HEAP_POOL_SIZE 8192
+
+static char slab_memory[SLAB_POOL_SIZE] __attribute__((aligned(8)));
+static char heap_memory[HEAP_POOL_SIZE] __attribute__((aligned(8)));
+
+/**
+ * The main function initializes the allocator and acts as a test suite.
+ *
+ * The implemented tests are:
+ * - Size class routing
+ * - Freeing by address
+ * - Fall through to the variable-size heap
+ * - Invalid pointers
+ */
+int main()
+{
+    ron_set_error_handler(ron_print_error, NULL); // Failures are silent by default
+
+    vs_heap_t heap;
+    slab_t slab;
+    if (vs_init_heap(&heap, heap_memory, HEAP_POOL_SIZE) || slab_init(&slab, slab_memory, SLAB_POOL_SIZE, &heap))
+    {
+        printf("ERROR: Failed to initialize allocator\n");
+        return 1;
+    }
+
+    printf("\nTest: Size class routing\n");
+    size_t sizes[] = { 1, 16, 24, 25, 33, 48, 49, 100, 129, 1000, 4096 };
+    void* ptrs[sizeof(sizes) / sizeof(sizes[0])];
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        ptrs[i] = slab_malloc(&slab, sizes[i]);
+        printf("\tRequest %zu served by a %zu byte block\n", sizes[i], slab_usable_size(&slab, ptrs[i]));
+    }
+
+    printf("\nTest: Free by address\n");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        slab_free(&slab, ptrs[i]);
+    }
+    void* again = slab_malloc(&slab, 100);
+    printf("\tFreed block reused: %s\n", again == ptrs[7] ? "yes" : "no"); // Should print yes (LIFO)
+    slab_free(&slab, again);
+
+    printf("\nTest: Fall through to the variable-size heap\n");
+    void* big = slab_malloc(&slab, 5000);
+    printf("\tRequest 5000 served by the heap: %s\n", vs_owns(&heap, big) ? "yes" : "no"); // Should print yes
+    slab_free(&slab, big);
+    void* largest[3]; // The 4096 class holds at most two blocks
+    size_t taken = 0;
+    do
+    {
+        largest[taken] = slab_malloc(&slab, 4096); // The last one should print 'Out of memory' and spill
+    } while (!vs_owns(&heap, largest[taken++]) && taken < 3);
+    printf("\tExhausted class spills to the heap: %s\n", vs_owns(&heap, largest[taken - 1]) ? "yes" : "no"); // Should print yes
+    while (taken)
+        slab_free(&slab, largest[--taken]);
+    vs_dump_memory(&heap); // Should print 1 free block
+
+    printf("\nTest: Invalid pointers\n");
+    slab_free(&slab, slab_memory + 1); // Should print 'Invalid pointer' (not a block start)
+
+    return 0;
+}
+#endif
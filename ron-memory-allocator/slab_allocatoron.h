@@ -0,0 +1,45 @@
+/**
+ * Public interface of the multi-class slab allocator.
+ * See slab_allocatoron.c for the design notes.
+ */
+
+#ifndef SLAB_ALLOCATORON_H
+#define SLAB_ALLOCATORON_H
+
+#include "fixed_size_allocatoron.h"
+#include "variable_size_allocatoron.h"
+
+#include <stddef.h>
+
+#define SLAB_CLASS_COUNT 16 // Number of size classes
+#define SLAB_MAX_SIZE 4096 // Largest request served by a size class
+#define SLAB_MIN_SPAN (2 * SLAB_MAX_SIZE) // Smallest slice per class (the bitmap build reserves a block)
+
+/**
+ * A set of fixed-size pools, one per size class, carved out of a single caller-provided region.
+ *
+ * Fields:
+ * - `memory`: Start of the region. Must be 8-byte aligned.
+ * - `span`: Bytes of the region given to each class. Class i owns [memory + i * span, memory + (i + 1) * span).
+ * - `classes`: The per-class pools.
+ * - `large`: Heap serving requests above SLAB_MAX_SIZE and exhausted classes. May be NULL.
+ */
+typedef struct slab_t
+{
+    char* memory;
+    size_t span;
+    fs_pool_t classes[SLAB_CLASS_COUNT];
+    vs_heap_t* large;
+} slab_t;
+
+int slab_init(slab_t* slab, void* memory, size_t size, vs_heap_t* large);
+void* slab_malloc(slab_t* slab, size_t size);
+void* slab_calloc(slab_t* slab, size_t count, size_t size);
+void slab_set_zeroed(slab_t* slab);
+void slab_free(slab_t* slab, void* ptr);
+int slab_owns(const slab_t* slab, const void* ptr);
+size_t slab_usable_size(const slab_t* slab, const void* ptr);
+size_t slab_class_index(size_t size);
+size_t slab_class_size(size_t class_index);
+
+#endif
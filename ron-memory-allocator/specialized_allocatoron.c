@@ -0,0 +1,165 @@
+/**
+ * Allocators specialized at compile time (specialized_allocatoron.h).
+ *
+ * fs_pool_t and vs_heap_t take their configuration at run time, so one compiled allocator serves every
+ * block size, and its features are chosen for the whole build (FS_BITMAP, FS_LOCK_FREE, RON_STATS,
+ * RON_HARDENED). The generators instead stamp out one allocator per use, from macro arguments:
+ *
+ * - RON_DEFINE_POOL(name, object_size, capacity, alignment, flags): a fixed-size pool whose blocks live in
+ *   the instance. The block size is a constant, so the block address, the index and the alignment check of a
+ *   free compile to a shift and a mask for power-of-two sizes, and to a multiplication otherwise.
+ * - RON_DEFINE_HEAP(name, heap_size, flags): a variable-size heap over a region in the instance. The heap
+ *   algorithm stays the shared one; the generator fixes its region and compiles in only the requested features.
+ *
+ * The flags (RON_SPEC_STATS, RON_SPEC_HARDENED, RON_SPEC_THREAD_SAFE) are tested with ordinary `if`s on
+ * constants, so each instance keeps only the code of its features: a pool without flags allocates with a
+ * pop or a bump and frees with a push, and checks nothing. Several instances with different flags coexist in
+ * one build, so each subsystem gets the allocator tuned for its type.
+ *
+ * A pool carves its blocks in address order and only links the freed ones, so it needs no initialization
+ * pass: a zero-initialized instance is an empty pool. The hardened build keeps one bit per block (set while
+ * the block is free), which catches double frees and frees of blocks that were never handed out without
+ * reading client memory.
+ *
+ * Failures are reported through ron_report_error like the other allocators, under the generated function's name.
+ */
+
+#ifdef RON_SELF_TEST
+#include "specialized_allocatoron.h"
+
+#include <stdio.h>
+
+#define THREAD_COUNT 8
+#define CHURN_ITERATIONS 20000
+
+struct vec3
+{
+    float x, y, z;
+};
+
+typedef struct list_node
+{
+    struct list_node* next;
+    long long value;
+    int tag;
+} list_node;
+
+RON_DEFINE_POOL(vec3_pool, sizeof(struct vec3), 64, 16, 0)
+RON_DEFINE_POOL(node_pool, sizeof(list_node), 10, 8, RON_SPEC_HARDENED | RON_SPEC_STATS)
+RON_DEFINE_POOL(message_pool, 64, 1024, 64, RON_SPEC_THREAD_SAFE | RON_SPEC_STATS)
+RON_DEFINE_HEAP(text_heap, 64 << 10, RON_SPEC_THREAD_SAFE | RON_SPEC_STATS)
+
+static vec3_pool_t vectors; // Zero-initialized: ready without vec3_pool_init
+static node_pool_t nodes;
+static message_pool_t messages;
+static text_heap_t texts;
+
+static void* churn(void* arg)
+{
+    size_t failures = 0;
+    for (int i = 0; i < CHURN_ITERATIONS; i++)
+    {
+        unsigned char* a = message_pool_malloc(&messages);
+        unsigned char* b = message_pool_malloc(&messages);
+        if (!a || !b)
+        {
+            failures++;
+            continue;
+        }
+        a[0] = b[0] = (unsigned char)(size_t)arg;
+        if (a == b || a[0] != (unsigned char)(size_t)arg) // Two threads handed the same block
+            failures++;
+        message_pool_free(&messages, b);
+        message_pool_free(&messages, a);
+    }
+    return (void*)failures;
+}
+
+/**
+ * The main function instantiates a few specialized allocators and acts as a test suite.
+ *
+ * The implemented tests are:
+ * - Block sizes folded from the object types
+ * - Allocation until exhaustion and LIFO reuse
+ * - Hardened frees and per-instance counters
+ * - A thread-safe pool under concurrent churn
+ * - A thread-safe heap
+ */
+int main()
+{
+    ron_set_error_handler(ron_print_error, NULL); // Failures are silent by default
+
+    printf("Test: Block sizes\n");
+    printf("\tvec3_pool: %zu bytes\n", RON_SPEC_BLOCK_SIZE(sizeof(struct vec3), 16)); // Should print 16
+    printf("\tnode_pool: %zu bytes\n", RON_SPEC_BLOCK_SIZE(sizeof(list_node), 8)); // Should print 24
+    printf("\tvec3_pool instance: %zu bytes of blocks, %zu in all\n", sizeof(vectors.memory),
+           sizeof(vectors)); // Should print 1024 bytes of blocks, 1088 in all (on 64-bit targets)
+
+    printf("\nTest: Exhaustion and reuse\n");
+    struct vec3* all[64];
+    size_t count = 0;
+    while (count < 64 && (all[count] = vec3_pool_malloc(&vectors)))
+        count++;
+    printf("\tAllocated: %zu\n", count); // Should print 64
+    printf("\tAligned: %s\n", (uintptr_t)all[63] % 16 == 0 ? "yes" : "no"); // Should print yes
+    printf("\tOne more: %s\n", vec3_pool_malloc(&vectors) ? "allocated" : "NULL"); // Should print 'Out of memory', NULL
+    vec3_pool_free(&vectors, all[10]);
+    vec3_pool_free(&vectors, all[20]);
+    vec3_pool_free(&vectors, NULL); // Ignored
+    printf("\tLast freed reused first: %s\n", vec3_pool_malloc(&vectors) == all[20] ? "yes" : "no"); // Should print yes
+    vec3_pool_init(&vectors);
+    printf("\tFirst block after a reset: %s\n", vec3_pool_malloc(&vectors) == all[0] ? "yes" : "no"); // Should print yes
+
+    printf("\nTest: Hardened frees\n");
+    list_node* a = node_pool_malloc(&nodes);
+    list_node* b = node_pool_malloc(&nodes);
+    node_pool_free(&nodes, a);
+    node_pool_free(&nodes, a); // Should print 'Block already free'
+    node_pool_free(&nodes, (char*)b + 8); // Should print 'Invalid pointer' (not a block start)
+    node_pool_free(&nodes, b + 1); // Should print 'Invalid pointer' (never handed out)
+    node_pool_free(&nodes, &vectors); // Should print 'Invalid pointer' (another pool)
+    node_pool_free(&nodes, b);
+    fs_stats_t stats;
+    node_pool_get_stats(&nodes, &stats);
+    printf("\tmallocs %llu, frees %llu, invalid frees %llu, free blocks %zu of %zu\n",
+           (unsigned long long)stats.mallocs, (unsigned long long)stats.frees,
+           (unsigned long long)stats.invalid_frees, stats.free_blocks,
+           stats.block_count); // Should print mallocs 2, frees 2, invalid frees 4, free blocks 10 of 10
+
+    printf("\nTest: Thread-safe pool\n");
+    pthread_t threads[THREAD_COUNT];
+    size_t failures = 0;
+    for (size_t i = 0; i < THREAD_COUNT; i++)
+        pthread_create(&threads[i], NULL, churn, (void*)(i + 1));
+    for (size_t i = 0; i < THREAD_COUNT; i++)
+    {
+        void* result;
+        pthread_join(threads[i], &result);
+        failures += (size_t)result;
+    }
+    message_pool_get_stats(&messages, &stats);
+    printf("\tFailed or shared allocations: %zu\n", failures); // Should print 0
+    printf("\tAll blocks returned: %s\n", stats.mallocs == stats.frees && stats.free_blocks == stats.block_count
+                                              ? "yes" : "no"); // Should print yes
+
+    printf("\nTest: Thread-safe heap\n");
+    if (text_heap_init(&texts))
+    {
+        printf("ERROR: Failed to initialize allocator\n");
+        return 1;
+    }
+    char* text = text_heap_malloc(&texts, 100);
+    long* counters = text_heap_calloc(&texts, 50, sizeof(long));
+    printf("\tAllocated: %s, zeroed: %s\n", text && counters ? "yes" : "no",
+           counters && counters[49] == 0 ? "yes" : "no"); // Should print yes, yes
+    text_heap_free_sized(&texts, text, 100);
+    text_heap_free(&texts, &texts); // Should print 'Invalid pointer', and not count as a free
+    text_heap_free(&texts, counters);
+    vs_stats_t heap_stats;
+    text_heap_get_stats(&texts, &heap_stats);
+    printf("\tmallocs %llu, frees %llu, free blocks %zu\n", (unsigned long long)heap_stats.mallocs,
+           (unsigned long long)heap_stats.frees, heap_stats.free_blocks); // Should print mallocs 2, frees 2, free blocks 1
+
+    return 0;
+}
+#endif
@@ -0,0 +1,258 @@
+/**
+ * Generators of allocators specialized at compile time: RON_DEFINE_POOL and RON_DEFINE_HEAP.
+ * See specialized_allocatoron.c for the design notes.
+ */
+
+#ifndef SPECIALIZED_ALLOCATORON_H
+#define SPECIALIZED_ALLOCATORON_H
+
+#include "error_allocatoron.h"
+#include "fixed_size_allocatoron.h"
+#include "variable_size_allocatoron.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Feature flags of a generated allocator. They are constants, so the code of a disabled feature is folded away.
+#define RON_SPEC_STATS 1U // Count mallocs, frees and failures per instance
+#define RON_SPEC_HARDENED 2U // Validate every free: ownership, alignment and double frees
+#define RON_SPEC_THREAD_SAFE 4U // Take a lock (a spin lock for pools, a mutex for heaps) around every call
+
+/**
+ * Block size of a generated pool: the object size rounded up to the alignment, and large enough for a link.
+ */
+#define RON_SPEC_BLOCK_SIZE(object_size, alignment)                                                            \
+    ((((object_size) < sizeof(void*) ? sizeof(void*) : (size_t)(object_size)) + (alignment) - 1)               \
+     & ~((size_t)(alignment) - 1))
+
+static inline void ron_spec_lock(_Atomic int* lock)
+{
+    while (atomic_exchange_explicit(lock, 1, memory_order_acquire))
+    {
+        while (atomic_load_explicit(lock, memory_order_relaxed)) // Spin on a load, not on the exchange
+            ;
+    }
+}
+
+static inline void ron_spec_unlock(_Atomic int* lock)
+{
+    atomic_store_explicit(lock, 0, memory_order_release);
+}
+
+/**
+ * Defines the type name##_t, a pool of capacity blocks for objects of object_size bytes, and its functions:
+ * name##_init, name##_malloc, name##_free, name##_owns and name##_get_stats.
+ *
+ * The blocks are stored in the instance. A zero-initialized instance (a static one, for example) is an
+ * empty pool, and name##_init resets one. alignment must be a power of two, at least sizeof(void*).
+ */
+#define RON_DEFINE_POOL(name, object_size, capacity, alignment, flags)                                         \
+    typedef struct name##_t                                                                                    \
+    {                                                                                                          \
+        _Alignas(alignment) unsigned char memory[RON_SPEC_BLOCK_SIZE(object_size, alignment) * (capacity)];    \
+        void* free_list;                                                                                       \
+        size_t fresh;                                                                                          \
+        _Atomic int lock;                                                                                      \
+        uint64_t free_bits[((flags) & RON_SPEC_HARDENED) ? ((capacity) + 63) / 64 : 1];                        \
+        uint64_t mallocs;                                                                                      \
+        uint64_t frees;                                                                                        \
+        uint64_t oom;                                                                                          \
+        uint64_t invalid_frees;                                                                                \
+    } name##_t;                                                                                                \
+                                                                                                               \
+    _Static_assert(((alignment) & ((alignment) - 1)) == 0 && (alignment) >= sizeof(void*),                     \
+                   #name ": the alignment must be a power of two, at least sizeof(void*)");                    \
+                                                                                                               \
+    static inline void name##_init(name##_t* pool)                                                             \
+    {                                                                                                          \
+        pool->free_list = NULL;                                                                                \
+        pool->fresh = 0;                                                                                       \
+        atomic_init(&pool->lock, 0);                                                                           \
+        for (size_t i = 0; i < sizeof(pool->free_bits) / sizeof(pool->free_bits[0]); i++)                      \
+            pool->free_bits[i] = 0;                                                                            \
+        pool->mallocs = pool->frees = pool->oom = pool->invalid_frees = 0;                                     \
+    }                                                                                                          \
+                                                                                                               \
+    static inline int name##_owns(const name##_t* pool, const void* ptr)                                       \
+    {                                                                                                          \
+        uintptr_t offset = (uintptr_t)ptr - (uintptr_t)pool->memory; /* Wraps around below the pool */         \
+        return offset < sizeof(pool->memory) && offset % RON_SPEC_BLOCK_SIZE(object_size, alignment) == 0;     \
+    }                                                                                                          \
+                                                                                                               \
+    static inline size_t name##_index(const name##_t* pool, const void* ptr)                                   \
+    {                                                                                                          \
+        return ((uintptr_t)ptr - (uintptr_t)pool->memory) / RON_SPEC_BLOCK_SIZE(object_size, alignment);       \
+    }                                                                                                          \
+                                                                                                               \
+    static inline void* name##_malloc(name##_t* pool)                                                          \
+    {                                                                                                          \
+        if ((flags) & RON_SPEC_THREAD_SAFE)                                                                    \
+            ron_spec_lock(&pool->lock);                                                                        \
+        void* ptr = pool->free_list;                                                                           \
+        if (ptr)                                                                                               \
+            pool->free_list = *(void**)ptr;                                                                    \
+        else if (pool->fresh < (capacity)) /* Carve the next never-used block */                               \
+            ptr = pool->memory + pool->fresh++ * RON_SPEC_BLOCK_SIZE(object_size, alignment);                  \
+        if (((flags) & RON_SPEC_HARDENED) && ptr)                                                              \
+        {                                                                                                      \
+            size_t index = name##_index(pool, ptr);                                                            \
+            pool->free_bits[index / 64] &= ~((uint64_t)1 << (index % 64));                                     \
+        }                                                                                                      \
+        if ((flags) & RON_SPEC_STATS)                                                                          \
+            *(ptr ? &pool->mallocs : &pool->oom) += 1;                                                         \
+        if ((flags) & RON_SPEC_THREAD_SAFE)                                                                    \
+            ron_spec_unlock(&pool->lock);                                                                      \
+        if (!ptr)                                                                                              \
+            RON_ERROR(RON_ENOMEM, NULL);                                                                       \
+        return ptr;                                                                                            \
+    }                                                                                                          \
+                                                                                                               \
+    static inline void name##_free(name##_t* pool, void* ptr)                                                  \
+    {                                                                                                          \
+        if (!ptr) /* Nothing to free, and the unchecked push would write through it */                         \
+            return;                                                                                            \
+        if ((flags) & RON_SPEC_THREAD_SAFE)                                                                    \
+            ron_spec_lock(&pool->lock);                                                                        \
+        if ((flags) & RON_SPEC_HARDENED)                                                                       \
+        {                                                                                                      \
+            /* A block is live if it was carved and its free bit is clear */                                   \
+            size_t index = name##_index(pool, ptr);                                                            \
+            ron_error_t error = !name##_owns(pool, ptr) || index >= pool->fresh ? RON_EINVAL                   \
+                : (pool->free_bits[index / 64] >> (index % 64)) & 1 ? RON_EDOUBLEFREE : RON_OK;                \
+            if (error)                                                                                         \
+            {                                                                                                  \
+                if ((flags) & RON_SPEC_STATS)                                                                  \
+                    pool->invalid_frees++;                                                                     \
+                if ((flags) & RON_SPEC_THREAD_SAFE)                                                            \
+                    ron_spec_unlock(&pool->lock);                                                              \
+                RON_ERROR(error, ptr);                                                                         \
+                return;                                                                                        \
+            }                                                                                                  \
+            pool->free_bits[index / 64] |= (uint64_t)1 << (index % 64);                                        \
+        }                                                                                                      \
+        *(void**)ptr = pool->free_list;                                                                        \
+        pool->free_list = ptr;                                                                                 \
+        if ((flags) & RON_SPEC_STATS)                                                                          \
+            pool->frees++;                                                                                     \
+        if ((flags) & RON_SPEC_THREAD_SAFE)                                                                    \
+            ron_spec_unlock(&pool->lock);                                                                      \
+    }                                                                                                          \
+                                                                                                               \
+    static inline void name##_get_stats(name##_t* pool, fs_stats_t* stats)                                     \
+    {                                                                                                          \
+        if ((flags) & RON_SPEC_THREAD_SAFE)                                                                    \
+            ron_spec_lock(&pool->lock);                                                                        \
+        stats->mallocs = pool->mallocs;                                                                        \
+        stats->frees = pool->frees;                                                                            \
+        stats->oom = pool->oom;                                                                                \
+        stats->invalid_frees = pool->invalid_frees;                                                            \
+        stats->remote_frees = 0;                                                                               \
+        stats->block_count = (capacity);                                                                       \
+        stats->free_blocks = (capacity) - pool->fresh;                                                         \
+        for (void* block = pool->free_list; block; block = *(void**)block)                                     \
+            stats->free_blocks++;                                                                              \
+        if ((flags) & RON_SPEC_THREAD_SAFE)                                                                    \
+            ron_spec_unlock(&pool->lock);                                                                      \
+    }
+
+/**
+ * Defines the type name##_t, a variable-size heap over heap_size bytes stored in the instance, and its
+ * functions: name##_init, name##_malloc, name##_calloc, name##_free, name##_free_sized and name##_get_stats.
+ *
+ * The heap is the variable-size allocator; what the generator fixes is its region and its features.
+ * A counting instance only counts the frees the heap accepts: it clears the calling thread's error code
+ * (ron_clear_error) before each free and checks it afterwards.
+ * name##_init must be called before any other function.
+ */
+#define RON_DEFINE_HEAP(name, heap_size, flags)                                                                \
+    typedef struct name##_t                                                                                    \
+    {                                                                                                          \
+        vs_heap_t heap;                                                                                        \
+        pthread_mutex_t lock;                                                                                  \
+        uint64_t mallocs;                                                                                      \
+        uint64_t frees;                                                                                        \
+        uint64_t oom;                                                                                          \
+        _Alignas(16) unsigned char memory[heap_size];                                                          \
+    } name##_t;                                                                                                \
+                                                                                                               \
+    static inline int name##_init(name##_t* heap)                                                              \
+    {                                                                                                          \
+        if ((flags) & RON_SPEC_THREAD_SAFE)                                                                    \
+            pthread_mutex_init(&heap->lock, NULL);                                                             \
+        heap->mallocs = heap->frees = heap->oom = 0;                                                           \
+        return vs_init_heap(&heap->heap, heap->memory, sizeof(heap->memory));                                  \
+    }                                                                                                          \
+                                                                                                               \
+    static inline void* name##_malloc(name##_t* heap, size_t size)                                             \
+    {                                                                                                          \
+        if ((flags) & RON_SPEC_THREAD_SAFE)                                                                    \
+            pthread_mutex_lock(&heap->lock);                                                                   \
+        void* ptr = vs_malloc(&heap->heap, size);                                                              \
+        if ((flags) & RON_SPEC_STATS)                                                                          \
+            *(ptr ? &heap->mallocs : &heap->oom) += 1;                                                         \
+        if ((flags) & RON_SPEC_THREAD_SAFE)                                                                    \
+            pthread_mutex_unlock(&heap->lock);                                                                 \
+        return ptr;                                                                                            \
+    }                                                                                                          \
+                                                                                                               \
+    static inline void* name##_calloc(name##_t* heap, size_t count, size_t size)                               \
+    {                                                                                                          \
+        if ((flags) & RON_SPEC_THREAD_SAFE)                                                                    \
+            pthread_mutex_lock(&heap->lock);                                                                   \
+        void* ptr = vs_calloc(&heap->heap, count, size);                                                       \
+        if ((flags) & RON_SPEC_STATS)                                                                          \
+            *(ptr ? &heap->mallocs : &heap->oom) += 1;                                                         \
+        if ((flags) & RON_SPEC_THREAD_SAFE)                                                                    \
+            pthread_mutex_unlock(&heap->lock);                                                                 \
+        return ptr;                                                                                            \
+    }                                                                                                          \
+                                                                                                               \
+    static inline void name##_free(name##_t* heap, void* ptr)                                                  \
+    {                                                                                                          \
+        if ((flags) & RON_SPEC_THREAD_SAFE)                                                                    \
+            pthread_mutex_lock(&heap->lock);                                                                   \
+        if ((flags) & RON_SPEC_STATS)                                                                          \
+            ron_clear_error();                                                                                 \
+        vs_free(&heap->heap, ptr);                                                                             \
+        if (((flags) & RON_SPEC_STATS) && ron_last_error() == RON_OK)                                          \
+            heap->frees++;                                                                                     \
+        if ((flags) & RON_SPEC_THREAD_SAFE)                                                                    \
+            pthread_mutex_unlock(&heap->lock);                                                                 \
+    }                                                                                                          \
+                                                                                                               \
+    /* A hardened instance validates the pointer in full, as vs_free does, instead of trusting the size */     \
+    static inline void name##_free_sized(name##_t* heap, void* ptr, size_t size)                               \
+    {                                                                                                          \
+        if ((flags) & RON_SPEC_THREAD_SAFE)                                                                    \
+            pthread_mutex_lock(&heap->lock);                                                                   \
+        if ((flags) & RON_SPEC_STATS)                                                                          \
+            ron_clear_error();                                                                                 \
+        if ((flags) & RON_SPEC_HARDENED)                                                                       \
+            vs_free(&heap->heap, ptr);                                                                         \
+        else                                                                                                   \
+            vs_free_sized(&heap->heap, ptr, size);                                                             \
+        if (((flags) & RON_SPEC_STATS) && ron_last_error() == RON_OK)                                          \
+            heap->frees++;                                                                                     \
+        if ((flags) & RON_SPEC_THREAD_SAFE)                                                                    \
+            pthread_mutex_unlock(&heap->lock);                                                                 \
+    }                                                                                                          \
+                                                                                                               \
+    /* The counters are the instance's own when it counts, the allocator's global ones otherwise */            \
+    static inline void name##_get_stats(name##_t* heap, vs_stats_t* stats)                                     \
+    {                                                                                                          \
+        if ((flags) & RON_SPEC_THREAD_SAFE)                                                                    \
+            pthread_mutex_lock(&heap->lock);                                                                   \
+        vs_get_stats(&heap->heap, stats);                                                                      \
+        if ((flags) & RON_SPEC_STATS)                                                                          \
+        {                                                                                                      \
+            stats->mallocs = heap->mallocs;                                                                    \
+            stats->frees = heap->frees;                                                                        \
+            stats->oom = heap->oom;                                                                            \
+        }                                                                                                      \
+        if ((flags) & RON_SPEC_THREAD_SAFE)                                                                    \
+            pthread_mutex_unlock(&heap->lock);                                                                 \
+    }
+
+#endif
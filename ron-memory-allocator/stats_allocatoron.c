@@ -0,0 +1,94 @@
+/**
+ * Per-thread accumulation of the allocator counters.
+ *
+ * - Every thread increments its own thread-local counter block, so counting never bounces cache lines
+ * - A block joins a global list the first time its thread counts something
+ * - Readers sum the list under a mutex, plus the totals of threads that have exited
+ * - When a thread exits, its counts are folded into those totals and its block leaves the list
+ *
+ * Without RON_STATS nothing is counted and stats_collect reports zeros.
+ */
+
+#include "stats_allocatoron.h"
+
+#include <string.h>
+
+#ifdef RON_STATS
+#include <pthread.h>
+
+_Thread_local StatsBlock stats_block;
+
+static StatsBlock* threads = NULL; // Registered blocks of live threads
+static uint64_t retired[STAT_COUNT]; // Counts of exited threads
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_key_t stats_key;
+static pthread_once_t stats_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Folds an exiting thread's counts into the retired totals and unlinks its block.
+ */
+static void retire_block(void* arg)
+{
+    StatsBlock* block = arg;
+
+    pthread_mutex_lock(&stats_lock);
+    for (int i = 0; i < STAT_COUNT; i++)
+    {
+        retired[i] += atomic_load_explicit(&block->counters[i], memory_order_relaxed);
+        atomic_store_explicit(&block->counters[i], 0, memory_order_relaxed);
+    }
+
+    if (block->prev)
+        block->prev->next = block->next;
+    else
+        threads = block->next;
+    if (block->next)
+        block->next->prev = block->prev;
+    block->registered = 0; // Counting again (from a later destructor) registers it again
+    pthread_mutex_unlock(&stats_lock);
+}
+
+static void create_stats_key()
+{
+    pthread_key_create(&stats_key, retire_block);
+}
+
+/**
+ * Links the calling thread's counter block into the list read by stats_collect.
+ */
+void stats_register()
+{
+    pthread_once(&stats_key_once, create_stats_key);
+    pthread_setspecific(stats_key, &stats_block);
+
+    pthread_mutex_lock(&stats_lock);
+    stats_block.prev = NULL;
+    stats_block.next = threads;
+    if (threads)
+        threads->prev = &stats_block;
+    threads = &stats_block;
+    stats_block.registered = 1;
+    pthread_mutex_unlock(&stats_lock);
+}
+#endif
+
+/**
+ * Sums the counters of all threads, including those that have exited.
+ * @param totals Receives one total per stat_counter_t. All zero without RON_STATS.
+ */
+void stats_collect(uint64_t totals[STAT_COUNT])
+{
+    memset(totals, 0, STAT_COUNT * sizeof(uint64_t));
+
+#ifdef RON_STATS
+    pthread_mutex_lock(&stats_lock);
+    memcpy(totals, retired, sizeof(retired));
+    for (const StatsBlock* block = threads; block; block = block->next)
+    {
+        for (int i = 0; i < STAT_COUNT; i++)
+            totals[i] += atomic_load_explicit(&block->counters[i], memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&stats_lock);
+#endif
+}
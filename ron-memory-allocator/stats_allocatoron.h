@@ -0,0 +1,89 @@
+/**
+ * Hot-path counters shared by the allocators, compiled out unless RON_STATS is defined.
+ * See stats_allocatoron.c for the design notes. The public views are vs_get_stats and fs_get_stats.
+ */
+
+#ifndef STATS_ALLOCATORON_H
+#define STATS_ALLOCATORON_H
+
+#include <stdint.h>
+
+/**
+ * The counters. Each thread has its own set; readers sum them over all threads.
+ */
+typedef enum stat_counter_t
+{
+    STAT_FS_MALLOC, // Successful fs allocations
+    STAT_FS_FREE, // Successful fs deallocations
+    STAT_FS_OOM, // fs allocations that found no free block
+    STAT_FS_INVALID_FREE, // fs frees of invalid or already free pointers
+    STAT_FS_REMOTE_FREE, // fs blocks queued by other threads
+    STAT_VS_MALLOC, // Successful vs allocations
+    STAT_VS_FREE, // Successful vs deallocations
+    STAT_VS_SEARCH, // Searches of the free index
+    STAT_VS_BLOCKS_EXAMINED, // Free blocks inspected by those searches
+    STAT_VS_SPLIT, // Blocks split into a used part and a free remainder
+    STAT_VS_COALESCE, // Merges of two adjacent free blocks
+    STAT_VS_REALLOC_IN_PLACE, // vs_realloc calls that shrank or grew the block in place
+    STAT_VS_REALLOC_COPY, // vs_realloc calls that moved the data to a new block
+    STAT_VS_REALLOC_BACKWARD, // vs_realloc calls that expanded into the previous block
+    STAT_VS_REALLOC_REMAP, // vs_realloc calls that grew a block by remapping its chunk
+    STAT_VS_OOM, // vs allocations that found no block
+    STAT_VS_INVALID_FREE, // vs frees of invalid or already free pointers
+    STAT_VS_REMOTE_FREE, // vs frees queued by other threads
+    STAT_VS_QUICK_HIT, // vs allocations served from a quick-list
+    STAT_VS_CONSOLIDATE, // vs quick-lists emptied into the free index
+    STAT_VS_LARGE_MAP, // Large objects given a new mapping
+    STAT_VS_LARGE_CACHE_HIT, // Large objects served by a cached mapping
+    STAT_VS_COMPACT_MOVE, // Movable blocks slid down by the compactor
+    STAT_VS_CHUNK_MAP, // Chunks mapped by growable heaps
+    STAT_VS_CHUNK_UNMAP, // Chunks returned to the OS
+    STAT_VS_PURGED_BYTES, // Bytes of idle free blocks returned to the OS
+    STAT_COUNT
+} stat_counter_t;
+
+#ifdef RON_STATS
+#include <stdatomic.h>
+
+/**
+ * The counters of one thread.
+ * Only the owning thread writes them; the atomics let readers load them without a data race.
+ *
+ * Fields:
+ * - `counters`: The counter values, indexed by stat_counter_t.
+ * - `next`, `prev`: Links in the list of registered threads.
+ * - `registered`: Whether the block is in that list.
+ */
+typedef struct StatsBlock
+{
+    _Atomic uint64_t counters[STAT_COUNT];
+    struct StatsBlock* next;
+    struct StatsBlock* prev;
+    int registered;
+} StatsBlock;
+
+extern _Thread_local StatsBlock stats_block;
+
+void stats_register();
+
+/**
+ * Adds to a counter of the calling thread. A plain load and store, not a locked read-modify-write:
+ * the thread is the only writer, and its counters stay in its own cache lines.
+ */
+static inline void stats_add(stat_counter_t counter, uint64_t n)
+{
+    if (!stats_block.registered)
+        stats_register();
+
+    _Atomic uint64_t* value = &stats_block.counters[counter];
+    atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+#define STAT_ADD(counter, n) stats_add(counter, n)
+#else
+#define STAT_ADD(counter, n) ((void)0)
+#endif
+
+void stats_collect(uint64_t totals[STAT_COUNT]);
+
+#endif
@@ -0,0 +1,462 @@
+/**
+ * A per-thread cache layer in front of the fixed-size and variable-size allocators.
+ *
+ * - Each thread keeps small magazines (LIFO stacks) of recently freed blocks, one per size class
+ * - Allocation and deallocation are served from the calling thread's magazine with no locking
+ * - Magazines are refilled from and flushed to the shared allocator with its batch API, under its lock
+ * - Cross-thread frees are safe: the block joins the freeing thread's magazine and returns to the
+ *   shared allocator when that magazine overflows or the thread exits
+ * - Requests outside the cached size classes go straight to the shared allocator under its lock
+ * - The layer fronts one shared pool and one shared heap, chosen with tc_init
+ *
+ * The shared allocators themselves are not thread-safe. Every call that reaches them from
+ * this layer holds the matching lock, so all threads must use the tc_ API.
+ * The lock-free fixed-size pool (FS_LOCK_FREE) is reached without a lock.
+ *
+ * A cached block is still used for the shared allocator, so a double free that stays in the cache goes
+ * unnoticed there and hands the block out twice. Built with RON_HARDENED, a free first looks for the block
+ * in its magazine, which catches a repeated free until the block leaves the magazine.
+ */
+
+#include "thread_cache_allocatoron.h"
+#include "error_allocatoron.h"
+#include "fixed_size_allocatoron.h"
+#include "variable_size_allocatoron.h"
+
+#include <pthread.h>
+#include <stdio.h>
+
+#define TC_MAGAZINE_SIZE 8 // Blocks a thread may cache per size class
+#define TC_BATCH_SIZE (TC_MAGAZINE_SIZE / 2) // Blocks moved per refill/flush of a magazine
+#define TC_VS_CLASS_SIZE 16 // Granularity of the variable-size classes in bytes
+#define TC_VS_CLASS_COUNT 16 // Number of variable-size classes
+#define TC_VS_MAX_SIZE (TC_VS_CLASS_SIZE * TC_VS_CLASS_COUNT) // Largest cached variable-size request
+
+/**
+ * A LIFO stack of cached blocks. An allocated-but-cached block still counts as used by the shared allocator.
+ */
+typedef struct Magazine
+{
+    size_t count;
+    void* blocks[TC_MAGAZINE_SIZE];
+} Magazine;
+
+/**
+ * The caches owned by one thread.
+ *
+ * Fields:
+ * - `registered`: Whether the thread exit destructor has been set up for this thread.
+ * - `fs`: Cached fixed-size blocks (the pool has a single size class).
+ * - `vs`: Cached variable-size blocks. Class i holds blocks with at least (i + 1) * TC_VS_CLASS_SIZE usable bytes.
+ */
+typedef struct ThreadCache
+{
+    int registered;
+    Magazine fs;
+    Magazine vs[TC_VS_CLASS_COUNT];
+} ThreadCache;
+
+static _Thread_local ThreadCache cache;
+
+// The shared allocators behind the caches
+static fs_pool_t* shared_pool = NULL;
+static vs_heap_t* shared_heap = NULL;
+
+// Locks guarding the shared allocators. Only taken on refill, flush and uncached requests.
+static pthread_mutex_t vs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#ifdef FS_LOCK_FREE
+#define FS_LOCK NULL // The lock-free pool needs no serialization
+#else
+static pthread_mutex_t fs_lock = PTHREAD_MUTEX_INITIALIZER;
+#define FS_LOCK (&fs_lock)
+#endif
+
+static void lock_shared(pthread_mutex_t* lock)
+{
+    if (lock)
+        pthread_mutex_lock(lock);
+}
+
+static void unlock_shared(pthread_mutex_t* lock)
+{
+    if (lock)
+        pthread_mutex_unlock(lock);
+}
+
+// Thread-specific key whose destructor returns a thread's cached blocks when it exits
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+
+// Adapters binding the shared allocators to the magazine refill/flush callbacks
+static size_t fs_alloc_shared(size_t size, size_t count, void** out)
+{
+    return fs_malloc_batch(shared_pool, size, count, out);
+}
+
+static void fs_release_shared(void** ptrs, size_t count)
+{
+    fs_free_batch(shared_pool, ptrs, count);
+}
+
+static size_t vs_alloc_shared(size_t size, size_t count, void** out)
+{
+    return vs_malloc_batch(shared_heap, size, count, out);
+}
+
+static void vs_release_shared(void** ptrs, size_t count)
+{
+    vs_free_batch(shared_heap, ptrs, count);
+}
+
+/**
+ * Returns up to count blocks from the top of a magazine to the shared allocator in one batch.
+ */
+static void flush_magazine(Magazine* magazine, size_t count, pthread_mutex_t* lock,
+                           void (*release)(void**, size_t))
+{
+    if (count > magazine->count)
+        count = magazine->count;
+    magazine->count -= count;
+
+    lock_shared(lock);
+    release(magazine->blocks + magazine->count, count);
+    unlock_shared(lock);
+}
+
+/**
+ * Returns all blocks cached by a thread to the shared allocators.
+ */
+static void flush_cache(ThreadCache* tc)
+{
+    if (tc->fs.count)
+        flush_magazine(&tc->fs, TC_MAGAZINE_SIZE, FS_LOCK, fs_release_shared);
+
+    for (int i = 0; i < TC_VS_CLASS_COUNT; i++)
+    {
+        if (tc->vs[i].count)
+            flush_magazine(&tc->vs[i], TC_MAGAZINE_SIZE, &vs_lock, vs_release_shared);
+    }
+}
+
+static void destroy_cache(void* tc)
+{
+    flush_cache((ThreadCache*)tc);
+}
+
+static void create_cache_key()
+{
+    pthread_key_create(&cache_key, destroy_cache);
+}
+
+/**
+ * Registers the calling thread's cache for flushing on thread exit.
+ * Done lazily once the thread first caches or refills, so threads that never allocate pay nothing.
+ */
+static void register_cache()
+{
+    if (cache.registered)
+        return;
+
+    pthread_once(&cache_key_once, create_cache_key);
+    pthread_setspecific(cache_key, &cache);
+    cache.registered = 1;
+}
+
+/**
+ * Refills an empty magazine with a batch of blocks taken under a single lock acquisition.
+ * @return The number of blocks added. 0 if the shared allocator is out of memory.
+ */
+static size_t refill_magazine(Magazine* magazine, size_t size, pthread_mutex_t* lock,
+                              size_t (*alloc)(size_t, size_t, void**))
+{
+    register_cache();
+
+    lock_shared(lock);
+    magazine->count += alloc(size, TC_BATCH_SIZE - magazine->count, magazine->blocks + magazine->count);
+    unlock_shared(lock);
+
+    return magazine->count;
+}
+
+#ifdef RON_HARDENED
+/**
+ * Returns whether a block is already cached in a magazine.
+ */
+static int magazine_holds(const Magazine* magazine, const void* ptr)
+{
+    for (size_t i = 0; i < magazine->count; i++)
+        if (magazine->blocks[i] == ptr)
+            return 1;
+    return 0;
+}
+#endif
+
+/**
+ * Caches a freed block, first moving a batch back to the shared allocator if the magazine is full.
+ */
+static void cache_block(Magazine* magazine, void* ptr, pthread_mutex_t* lock,
+                        void (*release)(void**, size_t))
+{
+    register_cache();
+
+    if (magazine->count == TC_MAGAZINE_SIZE)
+        flush_magazine(magazine, TC_BATCH_SIZE, lock, release);
+    magazine->blocks[magazine->count++] = ptr;
+}
+
+/**
+ * Selects the shared pool and heap behind the caches.
+ * Must be called once before any thread uses the tc_ API.
+ * @param pool The shared fixed-size pool
+ * @param heap The shared variable-size heap
+ */
+void tc_init(fs_pool_t* pool, vs_heap_t* heap)
+{
+    shared_pool = pool;
+    shared_heap = heap;
+}
+
+/**
+ * Allocates a fixed-size block from the calling thread's cache.
+ * @param size The size of the block to allocate. Must not exceed the pool's block size.
+ * @return A pointer to the usable allocated memory
+ */
+void* tc_fs_malloc(size_t size)
+{
+    if (size > shared_pool->block_size) // Too big - Let the allocator report it
+    {
+        lock_shared(FS_LOCK);
+        void* ptr = fs_malloc(shared_pool, size);
+        unlock_shared(FS_LOCK);
+        return ptr;
+    }
+
+    Magazine* magazine = &cache.fs;
+    if (!magazine->count && !refill_magazine(magazine, shared_pool->block_size, FS_LOCK, fs_alloc_shared))
+        return NULL;
+
+    return magazine->blocks[--magazine->count];
+}
+
+/**
+ * Frees a fixed-size block into the calling thread's cache.
+ * The block may have been allocated by any thread.
+ * @param ptr A pointer to the used memory
+ */
+void tc_fs_free(void* ptr)
+{
+    if (!fs_owns(shared_pool, ptr)) // Invalid pointer - Let the allocator report it
+    {
+        lock_shared(FS_LOCK);
+        fs_free(shared_pool, ptr);
+        unlock_shared(FS_LOCK);
+        return;
+    }
+
+#ifdef RON_HARDENED
+    if (magazine_holds(&cache.fs, ptr))
+    {
+        RON_ERROR(RON_EDOUBLEFREE, ptr);
+        return;
+    }
+#endif
+    cache_block(&cache.fs, ptr, FS_LOCK, fs_release_shared);
+}
+
+/**
+ * Allocates a variable-size block.
+ * Sizes up to TC_VS_MAX_SIZE are rounded up to their class and served from the calling thread's cache.
+ * @param size The size of the memory to allocate
+ * @return A pointer to the allocated usable memory.
+ */
+void* tc_vs_malloc(size_t size)
+{
+    if (size > TC_VS_MAX_SIZE) // Not cached
+    {
+        pthread_mutex_lock(&vs_lock);
+        void* ptr = vs_malloc(shared_heap, size);
+        pthread_mutex_unlock(&vs_lock);
+        return ptr;
+    }
+
+    size_t class_index = size ? (size - 1) / TC_VS_CLASS_SIZE : 0;
+    Magazine* magazine = &cache.vs[class_index];
+    if (!magazine->count &&
+        !refill_magazine(magazine, (class_index + 1) * TC_VS_CLASS_SIZE, &vs_lock, vs_alloc_shared))
+        return NULL;
+
+    return magazine->blocks[--magazine->count];
+}
+
+/**
+ * Frees a variable-size block into the calling thread's cache.
+ * The block may have been allocated by any thread.
+ * @param ptr A pointer to the memory that should be freed
+ */
+void tc_vs_free(void* ptr)
+{
+    // Classified under the lock: frees of its neighbours write the block's header, and chunks and large
+    // objects are mapped and unmapped, under it
+    pthread_mutex_lock(&vs_lock);
+    size_t usable = vs_usable_size(shared_heap, ptr);
+    pthread_mutex_unlock(&vs_lock);
+    size_t class_index = usable / TC_VS_CLASS_SIZE; // Largest class the block can serve, plus one
+
+    // Invalid, already free, or too large to cache - Let the allocator handle it
+    if (!usable || class_index == 0 || class_index > TC_VS_CLASS_COUNT)
+    {
+        pthread_mutex_lock(&vs_lock);
+        vs_free(shared_heap, ptr);
+        pthread_mutex_unlock(&vs_lock);
+        return;
+    }
+
+#ifdef RON_HARDENED
+    if (magazine_holds(&cache.vs[class_index - 1], ptr))
+    {
+        RON_ERROR(RON_EDOUBLEFREE, ptr);
+        return;
+    }
+#endif
+    cache_block(&cache.vs[class_index - 1], ptr, &vs_lock, vs_release_shared);
+}
+
+/**
+ * Reallocates a variable-size block through the shared allocator.
+ * @param ptr A pointer to the memory that will be reallocated.
+ * @param new_size The new size of the allocated memory.
+ * @return A pointer to the usable reallocated memory.
+ */
+void* tc_vs_realloc(void* ptr, size_t new_size)
+{
+    pthread_mutex_lock(&vs_lock);
+    void* new_ptr = vs_realloc(shared_heap, ptr, new_size);
+    pthread_mutex_unlock(&vs_lock);
+    return new_ptr;
+}
+
+/**
+ * Returns all blocks cached by the calling thread to the shared allocators.
+ * Threads created with pthread do this automatically on exit.
+ */
+void tc_flush()
+{
+    flush_cache(&cache);
+}
+
+#ifdef RON_SELF_TEST
+#define HANDOFF_COUNT 4 // Blocks passed from the producer to the consumer thread
+#define CHURN_ITERATIONS 100000
+
+static void* handoff_fs[HANDOFF_COUNT];
+static void* handoff_vs[HANDOFF_COUNT];
+
+static void* producer(void* arg)
+{
+    (void)arg;
+    for (int i = 0; i < HANDOFF_COUNT; i++)
+    {
+        handoff_fs[i] = tc_fs_malloc(16);
+        handoff_vs[i] = tc_vs_malloc(16);
+    }
+    return NULL;
+}
+
+static void* consumer(void* arg)
+{
+    (void)arg;
+    for (int i = 0; i < HANDOFF_COUNT; i++)
+    {
+        tc_fs_free(handoff_fs[i]);
+        tc_vs_free(handoff_vs[i]);
+    }
+    return NULL; // Cached blocks are flushed back to the shared allocators on exit
+}
+
+static void* churn(void* arg)
+{
+    size_t failures = 0;
+    for (int i = 0; i < CHURN_ITERATIONS; i++)
+    {
+        char* a = tc_fs_malloc(16);
+        char* b = tc_vs_malloc(16);
+        if (!a || !b)
+            failures++;
+        if (a)
+        {
+            a[0] = (char)i;
+            tc_fs_free(a);
+        }
+        if (b)
+        {
+            b[0] = (char)i;
+            tc_vs_free(b);
+        }
+    }
+    *(size_t*)arg = failures;
+    return NULL;
+}
+
+/**
+ * The main function initializes both allocators and acts as a test suite.
+ *
+ * The implemented tests are:
+ * - Cross-thread frees
+ * - Concurrent churn on two threads
+ * - Flushing the main thread's cache, and repeated frees caught in a magazine (RON_HARDENED)
+ */
+int main()
+{
+    ron_set_error_handler(ron_print_error, NULL); // Failures are silent by default
+
+    // Initialize allocators
+    static char fs_memory[32 * 8] __attribute__((aligned(8)));
+    static char vs_memory[256] __attribute__((aligned(8)));
+    static fs_pool_t pool;
+    static vs_heap_t heap;
+    if (fs_init_pool(&pool, fs_memory, 32, 8) || vs_init_heap(&heap, vs_memory, sizeof(vs_memory)))
+    {
+        printf("ERROR: Failed to initialize allocator\n");
+        return 1;
+    }
+    tc_init(&pool, &heap);
+
+    printf("\nTest: Allocate on one thread, free on another\n");
+    pthread_t thread;
+    pthread_create(&thread, NULL, producer, NULL);
+    pthread_join(thread, NULL);
+    pthread_create(&thread, NULL, consumer, NULL);
+    pthread_join(thread, NULL);
+    fs_dump_memory(&pool); // Should print empty memory
+    vs_dump_memory(&heap); // Should print empty memory
+
+    printf("\nTest: Concurrent churn\n");
+    pthread_t threads[2];
+    size_t failures[2];
+    for (int i = 0; i < 2; i++)
+        pthread_create(&threads[i], NULL, churn, &failures[i]);
+    for (int i = 0; i < 2; i++)
+    {
+        pthread_join(threads[i], NULL);
+        printf("\tThread %d failed %zu allocations\n", i, failures[i]); // Should print 0
+    }
+    fs_dump_memory(&pool); // Should print empty memory
+    vs_dump_memory(&heap); // Should print empty memory
+
+    printf("\nTest: Flush the main thread's cache\n");
+    void* ptr = tc_fs_malloc(8);
+    tc_fs_free(ptr);
+#ifdef RON_HARDENED
+    tc_fs_free(ptr); // Should print 'Block already free'
+    void* text = tc_vs_malloc(40);
+    tc_vs_free(text);
+    tc_vs_free(text); // Should print 'Block already free'
+#endif
+    fs_dump_memory(&pool); // Should print the cached blocks as used
+    tc_flush();
+    fs_dump_memory(&pool); // Should print empty memory
+
+    return 0;
+}
+#endif
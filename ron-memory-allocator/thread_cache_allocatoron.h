@@ -0,0 +1,22 @@
+/**
+ * Public interface of the per-thread cache layer in front of the fixed-size and variable-size allocators.
+ * See thread_cache_allocatoron.c for the design notes.
+ */
+
+#ifndef THREAD_CACHE_ALLOCATORON_H
+#define THREAD_CACHE_ALLOCATORON_H
+
+#include "fixed_size_allocatoron.h"
+#include "variable_size_allocatoron.h"
+
+#include <stddef.h>
+
+void tc_init(fs_pool_t* pool, vs_heap_t* heap);
+void* tc_fs_malloc(size_t size);
+void tc_fs_free(void* ptr);
+void* tc_vs_malloc(size_t size);
+void tc_vs_free(void* ptr);
+void* tc_vs_realloc(void* ptr, size_t new_size);
+void tc_flush();
+
+#endif
@@ -0,0 +1,409 @@
+/**
+ * An allocation trace recorder and reader.
+ *
+ * - The trace is a 16-byte header followed by fixed-size 16-byte events (see trace_allocatoron.h)
+ * - Events carry the operation, a dense object id, the requested size and a time delta
+ * - The recorder maps live pointers to ids, so a trace replays on any allocator and any address space
+ * - Fixed-size records make traces seekable and mmap-friendly; the reader streams them in batches
+ *
+ * The recorder and reader are tooling around the allocators, not allocators themselves:
+ * the recorder's pointer table lives on the C library heap and must not come from the allocator being traced.
+ */
+
+#define _POSIX_C_SOURCE 199309L // clock_gettime
+
+#include "trace_allocatoron.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TABLE_MIN_CAPACITY 1024 // Initial size of the pointer table, a power of two
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t saturate(uint64_t value)
+{
+    return value < UINT32_MAX ? (uint32_t)value : UINT32_MAX;
+}
+
+/**
+ * Returns the home slot of a pointer. The low bits are always zero, so they are mixed out first.
+ */
+static size_t slot_of(const trace_recorder_t* recorder, uintptr_t key)
+{
+    return (size_t)(((uint64_t)key >> 3) * 0x9E3779B97F4A7C15ULL >> 16) & (recorder->capacity - 1);
+}
+
+/**
+ * Returns the slot holding the key, or the empty slot where it would be inserted.
+ */
+static size_t find_slot(const trace_recorder_t* recorder, uintptr_t key)
+{
+    size_t slot = slot_of(recorder, key);
+    while (recorder->keys[slot] && recorder->keys[slot] != key)
+        slot = (slot + 1) & (recorder->capacity - 1);
+    return slot;
+}
+
+/**
+ * Doubles the pointer table (or creates it) and re-inserts every live pointer.
+ * @return 0 on success. 1 if the C library is out of memory.
+ */
+static int grow_table(trace_recorder_t* recorder)
+{
+    size_t old_capacity = recorder->capacity;
+    uintptr_t* old_keys = recorder->keys;
+    uint32_t* old_ids = recorder->ids;
+
+    size_t capacity = old_capacity ? old_capacity * 2 : TABLE_MIN_CAPACITY;
+    uintptr_t* keys = calloc(capacity, sizeof(*keys));
+    uint32_t* ids = malloc(capacity * sizeof(*ids));
+    if (!keys || !ids)
+    {
+        free(keys);
+        free(ids);
+        return 1;
+    }
+
+    recorder->keys = keys;
+    recorder->ids = ids;
+    recorder->capacity = capacity;
+    for (size_t i = 0; i < old_capacity; i++)
+    {
+        if (!old_keys[i])
+            continue;
+        size_t slot = find_slot(recorder, old_keys[i]);
+        keys[slot] = old_keys[i];
+        ids[slot] = old_ids[i];
+    }
+
+    free(old_keys);
+    free(old_ids);
+    return 0;
+}
+
+/**
+ * Removes the key in a slot, shifting back the entries of its probe run so that lookups stay correct.
+ */
+static void remove_slot(trace_recorder_t* recorder, size_t slot)
+{
+    size_t mask = recorder->capacity - 1;
+    size_t next = (slot + 1) & mask;
+    while (recorder->keys[next])
+    {
+        // An entry may move into the hole only if its home slot is not between the hole and itself
+        size_t home = slot_of(recorder, recorder->keys[next]);
+        if (((next - home) & mask) >= ((next - slot) & mask))
+        {
+            recorder->keys[slot] = recorder->keys[next];
+            recorder->ids[slot] = recorder->ids[next];
+            slot = next;
+        }
+        next = (next + 1) & mask;
+    }
+    recorder->keys[slot] = 0;
+    recorder->count--;
+}
+
+/**
+ * Returns an id for a new object, reusing the id of a freed object first.
+ */
+static uint32_t new_id(trace_recorder_t* recorder)
+{
+    return recorder->free_count ? recorder->free_ids[--recorder->free_count] : recorder->next_id++;
+}
+
+/**
+ * Makes the id of a freed object available again. If the C library is out of memory, the id is not reused.
+ */
+static void recycle_id(trace_recorder_t* recorder, uint32_t id)
+{
+    if (recorder->free_count == recorder->free_capacity)
+    {
+        size_t capacity = recorder->free_capacity ? recorder->free_capacity * 2 : TABLE_MIN_CAPACITY;
+        uint32_t* free_ids = realloc(recorder->free_ids, capacity * sizeof(*free_ids));
+        if (!free_ids)
+            return;
+        recorder->free_ids = free_ids;
+        recorder->free_capacity = capacity;
+    }
+    recorder->free_ids[recorder->free_count++] = id;
+}
+
+/**
+ * Maps a new live pointer to an id.
+ * @return 0 on success. 1 if the C library is out of memory.
+ */
+static int add_pointer(trace_recorder_t* recorder, const void* ptr, uint32_t id)
+{
+    if ((recorder->count + 1) * 2 > recorder->capacity && grow_table(recorder)) // Keep the load below 1/2
+        return 1;
+
+    size_t slot = find_slot(recorder, (uintptr_t)ptr);
+    recorder->keys[slot] = (uintptr_t)ptr;
+    recorder->ids[slot] = id;
+    recorder->count++;
+    return 0;
+}
+
+/**
+ * Removes a live pointer from the table.
+ * @return 0 on success, with its id. 1 if the pointer is not live in the trace.
+ */
+static int remove_pointer(trace_recorder_t* recorder, const void* ptr, uint32_t* id)
+{
+    if (!ptr || !recorder->capacity)
+        return 1;
+
+    size_t slot = find_slot(recorder, (uintptr_t)ptr);
+    if (!recorder->keys[slot])
+        return 1;
+
+    *id = recorder->ids[slot];
+    remove_slot(recorder, slot);
+    return 0;
+}
+
+static void write_event(trace_recorder_t* recorder, uint8_t op, uint32_t id, size_t size)
+{
+    uint64_t now = now_ns();
+    trace_event_t event = { saturate(now - recorder->last_ns), id, saturate(size), op, { 0 } };
+    recorder->last_ns = now;
+    fwrite(&event, sizeof(event), 1, recorder->file);
+}
+
+/**
+ * Creates a trace file and writes its header.
+ * @param recorder The recorder handle to initialize
+ * @param path The file to create. An existing file is truncated.
+ * @return 0 on success. 1 Otherwise.
+ */
+int trace_open_recorder(trace_recorder_t* recorder, const char* path)
+{
+    memset(recorder, 0, sizeof(*recorder));
+    recorder->file = fopen(path, "wb");
+    if (!recorder->file)
+    {
+        printf("Can't create trace %s\n", path);
+        return 1;
+    }
+
+    trace_header_t header = { { 0 }, TRACE_VERSION, sizeof(trace_event_t) };
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    fwrite(&header, sizeof(header), 1, recorder->file);
+    recorder->last_ns = now_ns();
+
+    return 0;
+}
+
+/**
+ * Records a successful allocation.
+ * @param recorder The recorder to write to
+ * @param ptr The allocated memory. NULL results are not recorded.
+ * @param size The requested size
+ */
+void trace_record_malloc(trace_recorder_t* recorder, const void* ptr, size_t size)
+{
+    if (!ptr)
+        return;
+
+    uint32_t id = new_id(recorder);
+    if (add_pointer(recorder, ptr, id))
+    {
+        recycle_id(recorder, id);
+        return;
+    }
+    write_event(recorder, TRACE_MALLOC, id, size);
+}
+
+/**
+ * Records a deallocation. Pointers allocated before recording started are ignored.
+ * @param recorder The recorder to write to
+ * @param ptr The freed memory
+ */
+void trace_record_free(trace_recorder_t* recorder, const void* ptr)
+{
+    uint32_t id;
+    if (remove_pointer(recorder, ptr, &id))
+        return;
+
+    recycle_id(recorder, id);
+    write_event(recorder, TRACE_FREE, id, 0);
+}
+
+/**
+ * Records a reallocation with the usual realloc edge cases:
+ * a NULL old pointer is an allocation, and a NULL result for size 0 is a deallocation.
+ * A failed reallocation (NULL result for a non-zero size) is not recorded.
+ * @param recorder The recorder to write to
+ * @param old_ptr The memory before the call
+ * @param new_ptr The memory returned by the call
+ * @param size The requested size
+ */
+void trace_record_realloc(trace_recorder_t* recorder, const void* old_ptr, const void* new_ptr, size_t size)
+{
+    if (!new_ptr)
+    {
+        if (size == 0)
+            trace_record_free(recorder, old_ptr);
+        return;
+    }
+
+    uint32_t id;
+    if (remove_pointer(recorder, old_ptr, &id)) // New, or unknown to the trace
+    {
+        trace_record_malloc(recorder, new_ptr, size);
+        return;
+    }
+
+    // Keep the object's id across the move. The table just lost an entry, so it never grows here.
+    add_pointer(recorder, new_ptr, id);
+    write_event(recorder, TRACE_REALLOC, id, size);
+}
+
+/**
+ * Flushes and closes the trace and releases the recorder's tables.
+ * @param recorder The recorder to close
+ * @return 0 if every event reached the file. 1 Otherwise.
+ */
+int trace_close_recorder(trace_recorder_t* recorder)
+{
+    int failed = ferror(recorder->file) != 0;
+    failed |= fclose(recorder->file) != 0;
+    free(recorder->keys);
+    free(recorder->ids);
+    free(recorder->free_ids);
+    memset(recorder, 0, sizeof(*recorder));
+
+    if (failed)
+        printf("Failed to write the trace\n");
+    return failed;
+}
+
+/**
+ * Opens a trace file and validates its header.
+ * @param reader The reader handle to initialize
+ * @param path The trace to read
+ * @return 0 on success. 1 if the file can't be read or is not a trace of this version.
+ */
+int trace_open_reader(trace_reader_t* reader, const char* path)
+{
+    reader->count = 0;
+    reader->next = 0;
+    reader->file = fopen(path, "rb");
+    if (!reader->file)
+    {
+        printf("Can't open trace %s\n", path);
+        return 1;
+    }
+
+    trace_header_t header;
+    if (fread(&header, sizeof(header), 1, reader->file) != 1 || memcmp(header.magic, TRACE_MAGIC, 8) != 0
+        || header.version != TRACE_VERSION || header.event_size != sizeof(trace_event_t))
+    {
+        printf("Invalid trace %s\n", path);
+        fclose(reader->file);
+        reader->file = NULL;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Returns the next event of the trace, reading the next batch from the file when needed.
+ * @param reader The reader to advance
+ * @return The event, valid until the next call, or NULL at the end of the trace.
+ */
+const trace_event_t* trace_next(trace_reader_t* reader)
+{
+    if (reader->next == reader->count)
+    {
+        reader->count = fread(reader->buffer, sizeof(trace_event_t), TRACE_READ_BATCH, reader->file);
+        reader->next = 0;
+        if (!reader->count)
+            return NULL;
+    }
+    return &reader->buffer[reader->next++];
+}
+
+void trace_close_reader(trace_reader_t* reader)
+{
+    fclose(reader->file);
+    reader->file = NULL;
+}
+
+#ifdef RON_SELF_TEST
+#define TEST_OBJECTS 5000
+
+static trace_reader_t reader;
+
+/**
+ * The main function records a synthetic workload and acts as a test suite.
+ *
+ * The implemented tests are:
+ * - Round trip of malloc/realloc/free events
+ * - Id reuse after free
+ * - Pointers unknown to the trace
+ * - Growth of the pointer table
+ * - Rejection of a file that is not a trace
+ */
+int main()
+{
+    const char* path = "trace_allocatoron_test.trace";
+    trace_recorder_t recorder;
+    if (trace_open_recorder(&recorder, path))
+    {
+        printf("ERROR: Failed to create trace\n");
+        return 1;
+    }
+
+    printf("\nTest: Record events\n");
+    static char objects[TEST_OBJECTS]; // Stand-ins for allocations: only their addresses are recorded
+    trace_record_malloc(&recorder, &objects[0], 16);
+    trace_record_realloc(&recorder, &objects[0], &objects[1], 32); // Moves, keeps id 0
+    trace_record_malloc(&recorder, &objects[2], 8); // Id 1
+    trace_record_free(&recorder, &objects[1]); // Frees id 0
+    trace_record_malloc(&recorder, &objects[3], 64); // Reuses id 0
+    trace_record_free(&recorder, &objects[4]); // Unknown - Not recorded
+    trace_record_realloc(&recorder, NULL, &objects[4], 24); // Allocation, id 2
+    trace_record_realloc(&recorder, &objects[4], NULL, 0); // Deallocation of id 2
+    for (size_t i = 5; i < TEST_OBJECTS; i++)
+        trace_record_malloc(&recorder, &objects[i], i);
+    trace_close_recorder(&recorder);
+
+    printf("\nTest: Read events back\n");
+    if (trace_open_reader(&reader, path))
+        return 1;
+    const trace_event_t* event;
+    for (int i = 0; i < 7 && (event = trace_next(&reader)); i++)
+    {
+        printf("\tEvent %d: op %u, id %u, size %u\n", i, event->op, event->id, event->size);
+    }
+    size_t events = 7;
+    size_t max_id = 0;
+    while ((event = trace_next(&reader)))
+    {
+        events++;
+        if (event->id > max_id)
+            max_id = event->id;
+    }
+    printf("\t%zu events, ids up to %zu\n", events, max_id); // Should print 5002 events, ids up to 4996
+    trace_close_reader(&reader);
+
+    printf("\nTest: Invalid trace\n");
+    FILE* file = fopen(path, "wb");
+    fputs("not a trace", file);
+    fclose(file);
+    trace_open_reader(&reader, path); // Should print 'Invalid trace'
+    remove(path);
+
+    return 0;
+}
+#endif
@@ -0,0 +1,106 @@
+/**
+ * Public interface of the allocation trace recorder and reader.
+ * See trace_allocatoron.c for the design notes and the file format.
+ */
+
+#ifndef TRACE_ALLOCATORON_H
+#define TRACE_ALLOCATORON_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TRACE_MAGIC "RONTRACE" // First 8 bytes of every trace file
+#define TRACE_VERSION 1
+#define TRACE_READ_BATCH 4096 // Events read from the file at a time
+
+// Event kinds
+#define TRACE_MALLOC 1
+#define TRACE_FREE 2
+#define TRACE_REALLOC 3
+
+/**
+ * The file header, followed by any number of events. All fields are in native byte order.
+ *
+ * Fields:
+ * - `magic`: TRACE_MAGIC, without the terminating NUL.
+ * - `version`: TRACE_VERSION.
+ * - `event_size`: sizeof(trace_event_t), so readers can reject traces of another layout.
+ */
+typedef struct trace_header_t
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t event_size;
+} trace_header_t;
+
+/**
+ * One allocation event. Fixed-size records keep the file seekable and mmap-friendly.
+ *
+ * Fields:
+ * - `delta_ns`: Nanoseconds since the previous event, saturated at UINT32_MAX.
+ * - `id`: The object. Ids are dense: the id of a freed object is reused by a later allocation.
+ * - `size`: The requested size (TRACE_MALLOC, TRACE_REALLOC), saturated at UINT32_MAX. 0 for TRACE_FREE.
+ * - `op`: TRACE_MALLOC, TRACE_FREE or TRACE_REALLOC.
+ */
+typedef struct trace_event_t
+{
+    uint32_t delta_ns;
+    uint32_t id;
+    uint32_t size;
+    uint8_t op;
+    uint8_t reserved[3];
+} trace_event_t;
+
+/**
+ * Records events of one allocator into a trace file. Not thread-safe: guard it with the allocator's lock.
+ *
+ * Fields:
+ * - `file`: The trace being written.
+ * - `last_ns`: Time of the previous event.
+ * - `keys`, `ids`, `capacity`, `count`: Open-addressing table from live pointers to their ids.
+ * - `free_ids`, `free_count`, `free_capacity`: Ids of freed objects, reused first.
+ * - `next_id`: The next never-used id.
+ */
+typedef struct trace_recorder_t
+{
+    FILE* file;
+    uint64_t last_ns;
+    uintptr_t* keys;
+    uint32_t* ids;
+    size_t capacity;
+    size_t count;
+    uint32_t* free_ids;
+    size_t free_count;
+    size_t free_capacity;
+    uint32_t next_id;
+} trace_recorder_t;
+
+/**
+ * Streams the events of a trace file in batches, so traces of any length use constant memory.
+ *
+ * Fields:
+ * - `file`: The trace being read.
+ * - `buffer`: The current batch of events.
+ * - `count`: Number of events in the buffer.
+ * - `next`: Index of the next event to return.
+ */
+typedef struct trace_reader_t
+{
+    FILE* file;
+    trace_event_t buffer[TRACE_READ_BATCH];
+    size_t count;
+    size_t next;
+} trace_reader_t;
+
+int trace_open_recorder(trace_recorder_t* recorder, const char* path);
+void trace_record_malloc(trace_recorder_t* recorder, const void* ptr, size_t size);
+void trace_record_free(trace_recorder_t* recorder, const void* ptr);
+void trace_record_realloc(trace_recorder_t* recorder, const void* old_ptr, const void* new_ptr, size_t size);
+int trace_close_recorder(trace_recorder_t* recorder);
+
+int trace_open_reader(trace_reader_t* reader, const char* path);
+const trace_event_t* trace_next(trace_reader_t* reader);
+void trace_close_reader(trace_reader_t* reader);
+
+#endif
@@ -1,271 +1,2513 @@
 ﻿/**
- * A simple variable-size memory allocator using a doubly linked list.
+ * A simple variable-size memory allocator using boundary tags.
  *
- * - Statically allocated pool
- * - Best-fit allocation strategy to minimize fragmentation
+ * - Caller-provided memory region of any size
+ * - Any number of independent heaps (vs_heap_t handles)
+ * - 8-byte block header; free blocks also carry a footer
+ * - Two-level segregated-fit (TLSF) index over the free blocks
+ * - Good-fit allocation strategy to minimize fragmentation
  * - Bidirectional coalescing on deallocation
- * - In-place realloc when possible (shrink/expand)
- * - O(n) allocation (traverses list), O(1) deallocation
+ * - Aligned allocation; the leading padding is split off as a free block
+ * - In-place realloc when possible (shrink/expand), backward expansion into a free predecessor,
+ *   and growth of a chunk's last block by remapping the chunk (Linux)
+ * - Optional quick-lists: small blocks are freed onto exact-size LIFO bins and coalesced later
+ * - Optional large-object path: big requests get their own (huge-page) mappings, found by hash on free
+ *   and cached for reuse once freed
+ * - Optional movable blocks: handle-based allocations that an incremental compactor slides together
+ * - Lock-free remote frees: other threads push blocks onto a queue the owner drains on a search miss
+ * - Sized free (vs_free_sized) that picks the quick-list from the caller's size and skips the checks
+ *   of vs_free, unless built with RON_HARDENED
+ * - O(1) allocation and deallocation (bounded by the bitmap width, not the number of blocks)
+ * - Optional growth: page-mapped chunks are added on demand and released once fully free
+ * - Optional hot-path counters (RON_STATS) and a vs_get_stats snapshot of the free index
+ * - vs_calloc only clears memory that was handed out before: chunks, and regions declared with vs_set_zeroed,
+ *   are known to be zero past a mark per region
+ * - Optional purging: the pages of large free blocks that stayed idle for a decay time go back to the OS
  *
- * Operates on a fixed memory pool without calling malloc/free.
+ * Operates on a caller-provided memory pool, and on chunks mapped from the OS when growth is enabled,
+ * without calling malloc/free.
  */
 
+#define _GNU_SOURCE // MAP_ANONYMOUS and mremap are extensions to POSIX mmap
+
+#include "variable_size_allocatoron.h"
+#include "error_allocatoron.h"
+#include "stats_allocatoron.h"
+#include "profile_allocatoron.h"
+#include "zero_allocatoron.h"
+
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
-#include <stdio.h>
+#include <stdio.h> // Used by vs_dump_memory
 #include <string.h>
 
-#define POOL_SIZE 256 // Size of the memory pool in bytes
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#define ALIGN_SIZE_LOG2 VS_ALIGN_SIZE_LOG2 // Payload sizes are rounded up to multiples of 8 bytes
+#define ALIGN_SIZE (1 << ALIGN_SIZE_LOG2)
+
+/**
+ * Segregated free index parameters (see variable_size_allocatoron.h).
+ *
+ * Free blocks are bucketed by a first-level index (the power of two class of their size)
+ * and a second-level index (one of SL_INDEX_COUNT linear subdivisions of that class).
+ * Sizes below SMALL_BLOCK_SIZE all share first-level class 0 and are subdivided in ALIGN_SIZE steps.
+ */
+#define SL_INDEX_COUNT_LOG2 VS_SL_INDEX_COUNT_LOG2
+#define SL_INDEX_COUNT VS_SL_INDEX_COUNT
+#define FL_INDEX_MAX VS_FL_INDEX_MAX
+#define FL_INDEX_SHIFT (SL_INDEX_COUNT_LOG2 + ALIGN_SIZE_LOG2)
+#define FL_INDEX_COUNT VS_FL_INDEX_COUNT
+#define SMALL_BLOCK_SIZE ((size_t)1 << FL_INDEX_SHIFT)
+
+/**
+ * Represents a memory block within the allocator.
+ *
+ * Only the `header` word precedes the payload of a used block (8 bytes of overhead).
+ * Payload sizes are multiples of ALIGN_SIZE, so the low bits of the header are free to hold flags.
+ *
+ * The physical neighbours are found without stored links:
+ * - Next block: Starts right after this block's payload.
+ * - Previous block: Only needed when it is free, in which case its size is read from the
+ *   footer it keeps in its last payload word (the 'boundary tag').
+ *
+ * Fields:
+ * - `header`: The payload size in bytes, combined with BLOCK_USED and BLOCK_PREV_USED.
+ * - `next_free`: A pointer to the next free block in the same bucket (free blocks only, in the payload).
+ * - `prev_free`: A pointer to the previous free block in the same bucket (free blocks only, in the payload).
+ */
+typedef struct MemBlock
+{
+    size_t header;
+    struct MemBlock* next_free;
+    struct MemBlock* prev_free;
+} MemBlock;
+
+#define BLOCK_USED ((size_t)1) // The block is in use
+#define BLOCK_PREV_USED ((size_t)2) // The physically previous block is in use (no footer to read)
+#define BLOCK_FIRST ((size_t)4) // The block starts its region (the heap's own region or a chunk)
+#define BLOCK_FLAGS (BLOCK_USED | BLOCK_PREV_USED | BLOCK_FIRST)
+
+#define BLOCK_HEADER_SIZE offsetof(MemBlock, next_free) // Overhead of a used block
+
+// A free block must hold its free-list links and its footer
+#define MIN_BLOCK_SIZE (sizeof(MemBlock) - BLOCK_HEADER_SIZE + sizeof(size_t))
+
+// Largest payload the free index can describe
+#define MAX_BLOCK_SIZE (((size_t)1 << FL_INDEX_MAX) - BLOCK_HEADER_SIZE)
+
+// Smallest region that holds one minimal block and the sentinel
+#define MIN_HEAP_SIZE (2 * BLOCK_HEADER_SIZE + MIN_BLOCK_SIZE)
+
+// What a free block may write at its start: its header, its links and its idle time (see purging)
+#define FREE_PREFIX_SIZE (sizeof(MemBlock) + sizeof(size_t))
+
+/**
+ * Header of a chunk mapped from the OS when the heap grows.
+ *
+ * A chunk is laid out like a heap region of its own: its blocks start right after this header,
+ * the first one has BLOCK_PREV_USED and BLOCK_FIRST set, and the last one is followed by a used sentinel.
+ * Coalescing therefore never crosses a chunk boundary, while all chunks share the heap's free index.
+ *
+ * Fields:
+ * - `next`: The next chunk of the heap.
+ * - `prev`: The previous chunk of the heap.
+ * - `size`: Size of the mapping in bytes, this header included.
+ * - `fresh`: Offset from the chunk's start past which its memory is known to be zero (see touch_tail).
+ */
+typedef struct VsChunk
+{
+    struct VsChunk* next;
+    struct VsChunk* prev;
+    size_t size;
+    size_t fresh;
+} VsChunk;
+
+#define CHUNK_HEADER_SIZE sizeof(VsChunk)
+
+/**
+ * Header of a large object's mapping. The payload follows it.
+ *
+ * Fields:
+ * - `map_size`: Size of the mapping in bytes, this header included.
+ * - `hugetlb`: Whether the mapping uses explicit huge pages (it can't be remapped).
+ */
+typedef struct VsLarge
+{
+    size_t map_size;
+    size_t hugetlb;
+} VsLarge;
+
+#define LARGE_HEADER_SIZE sizeof(VsLarge) // Keeps the payload 16-byte aligned
+#define HUGE_PAGE_SIZE ((size_t)2 << 20) // Granularity of huge-page mappings
+#define LARGE_TABLE_MIN_CAPACITY 512 // Slots of a new large-object table (one page)
+
+/**
+ * An entry of the handle table of movable blocks (see vs_halloc).
+ */
+typedef struct VsHandle
+{
+    MemBlock* block; // NULL when the entry is free
+    size_t pins; // Pin count, or the next free entry (index + 1) when the entry is free
+} VsHandle;
+
+#define HANDLE_TAG(heap) ((uintptr_t)(heap) ^ (uintptr_t)0xC2B2AE3D27D4EB4FULL)
+#define HANDLE_PREFIX_SIZE sizeof(uintptr_t) // The tag word in front of the client's data
+#define HANDLE_TABLE_MIN_CAPACITY 256 // Entries of a new handle table (one page)
+
+static size_t block_size(const MemBlock* block)
+{
+    return block->header & ~BLOCK_FLAGS;
+}
+
+static void block_set_size(MemBlock* block, size_t size)
+{
+    block->header = size | (block->header & BLOCK_FLAGS);
+}
+
+static int block_is_used(const MemBlock* block)
+{
+    return (block->header & BLOCK_USED) != 0;
+}
+
+static int block_is_prev_used(const MemBlock* block)
+{
+    return (block->header & BLOCK_PREV_USED) != 0;
+}
+
+static void* block_to_ptr(const MemBlock* block)
+{
+    return (char*)block + BLOCK_HEADER_SIZE;
+}
+
+static MemBlock* block_from_ptr(const void* ptr)
+{
+    return (MemBlock*)((char*)ptr - BLOCK_HEADER_SIZE);
+}
+
+/**
+ * Returns the physically next block. The pool ends with a used sentinel, so the result is always valid.
+ */
+static MemBlock* block_next(const MemBlock* block)
+{
+    return (MemBlock*)((char*)block_to_ptr(block) + block_size(block));
+}
+
+/**
+ * Returns the physically previous block. Only valid when that block is free (BLOCK_PREV_USED clear).
+ */
+static MemBlock* block_prev(const MemBlock* block)
+{
+    size_t prev_size = *((size_t*)block - 1); // Footer of the previous block
+    return (MemBlock*)((char*)block - prev_size - BLOCK_HEADER_SIZE);
+}
+
+/**
+ * Marks a block as free: clears its used flag, writes its footer and informs the next block.
+ */
+static void block_mark_free(MemBlock* block)
+{
+    MemBlock* next = block_next(block);
+    block->header &= ~BLOCK_USED;
+    *((size_t*)next - 1) = block_size(block);
+    next->header &= ~BLOCK_PREV_USED;
+}
+
+/**
+ * Marks a block as used and informs the next block that it no longer has a footer to read.
+ */
+static void block_mark_used(MemBlock* block)
+{
+    block->header |= BLOCK_USED;
+    block_next(block)->header |= BLOCK_PREV_USED;
+}
+
+/**
+ * Rounds a requested size up to the allocator's alignment.
+ */
+static size_t align_size(size_t size)
+{
+    if (size < MIN_BLOCK_SIZE)
+        return MIN_BLOCK_SIZE;
+    return (size + (ALIGN_SIZE - 1)) & ~(size_t)(ALIGN_SIZE - 1);
+}
+
+/**
+ * Checks whether a pointer is a plausible payload of a region of blocks.
+ */
+static int region_owns(const char* memory, size_t size, const void* ptr)
+{
+    return (const char*)ptr >= memory + BLOCK_HEADER_SIZE && (const char*)ptr < memory + size
+        && ((const char*)ptr - memory) % ALIGN_SIZE == 0;
+}
+
+/**
+ * Returns the index of the most significant set bit (size must be non-zero).
+ */
+static int fls_size(size_t size)
+{
+    return (int)(sizeof(unsigned long long) * 8) - 1 - __builtin_clzll((unsigned long long)size);
+}
+
+/**
+ * Computes the bucket a block of the given size belongs to.
+ */
+static void mapping_insert(size_t size, int* fl, int* sl)
+{
+    if (size < SMALL_BLOCK_SIZE)
+    {
+        // Small sizes share the first class and are split linearly
+        *fl = 0;
+        *sl = (int)(size / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT));
+    }
+    else
+    {
+        int bit = fls_size(size);
+        *sl = (int)(size >> (bit - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+        *fl = bit - (FL_INDEX_SHIFT - 1);
+    }
+}
+
+/**
+ * Computes the first bucket whose every block is guaranteed to fit the given size.
+ * The size is rounded up to the next subdivision so that any block found there is large enough.
+ */
+static void mapping_search(size_t size, int* fl, int* sl)
+{
+    if (size >= SMALL_BLOCK_SIZE)
+    {
+        size_t round = ((size_t)1 << (fls_size(size) - SL_INDEX_COUNT_LOG2)) - 1;
+        size += round;
+    }
+    mapping_insert(size, fl, sl);
+}
+
+/**
+ * Finds a non-empty bucket at or above [fl][sl] using find-first-set on the bitmaps.
+ * @return The head of that bucket, or NULL if no free block is large enough.
+ */
+static MemBlock* search_suitable_block(const vs_heap_t* heap, int* fl, int* sl)
+{
+    STAT_ADD(STAT_VS_SEARCH, 1);
+    if (*fl >= FL_INDEX_COUNT)
+        return NULL;
+
+    // Look for a non-empty bucket in the same first-level class
+    unsigned int sl_map = heap->sl_bitmap[*fl] & (~0U << *sl);
+    if (!sl_map)
+    {
+        // Fall back to the next non-empty first-level class
+        unsigned int fl_map = (*fl + 1 < FL_INDEX_COUNT) ? heap->fl_bitmap & (~0U << (*fl + 1)) : 0;
+        if (!fl_map)
+            return NULL;
+
+        *fl = __builtin_ctz(fl_map);
+        sl_map = heap->sl_bitmap[*fl];
+    }
+    *sl = __builtin_ctz(sl_map);
+
+    // Every block of the bucket fits, so only its head is examined
+    STAT_ADD(STAT_VS_BLOCKS_EXAMINED, 1);
+    return heap->free_blocks[*fl][*sl];
+}
+
+/**
+ * Purging.
+ *
+ * With vs_set_purging, every free block of at least heap->purge_min_size bytes records when it entered
+ * the free index, in the word after its links: the time in milliseconds shifted left by one, and
+ * IDLE_PURGED in the low bit. vs_purge advises the OS to drop the whole pages inside blocks that stayed
+ * idle for heap->purge_decay milliseconds (everything but the header, links, idle word and footer), and
+ * marks them as purged so later passes skip them. Reusing a purged block just faults in zeroed pages.
+ *
+ * A block that merges or splits re-enters the index and starts a new idle period. Since these stamps
+ * read the clock anyway, the frees that make large free blocks also drive the purge: once the last
+ * stamp passes heap->purge_next, the free runs vs_purge, and the next pass is due a decay time later.
+ * A background thread can call vs_purge as well, under the heap's lock.
+ *
+ * Only chunks the heap mapped itself are purged, unless the caller's region is allowed with VS_PURGE_REGION.
+ */
+#define IDLE_PURGED ((size_t)1)
+
+static size_t* block_idle(const MemBlock* block)
+{
+    return (size_t*)(block + 1);
+}
+
+/**
+ * Returns the time of a monotonic clock in milliseconds.
+ */
+static uint64_t clock_ms()
+{
+#ifdef _WIN32
+    return GetTickCount64();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+#endif
+}
+
+/**
+ * Starts the idle period of a free block that purging tracks.
+ */
+static void stamp_block(vs_heap_t* heap, MemBlock* block)
+{
+    if (!heap->purge_decay || block_size(block) < heap->purge_min_size)
+        return;
+
+    heap->purge_clock = clock_ms();
+    *block_idle(block) = (size_t)(heap->purge_clock << 1);
+}
+
+/**
+ * Links a free block into the head of its bucket and updates the bitmaps.
+ */
+static void insert_free_block(vs_heap_t* heap, MemBlock* block)
+{
+    int fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+
+    block->prev_free = NULL;
+    block->next_free = heap->free_blocks[fl][sl];
+    if (block->next_free)
+        block->next_free->prev_free = block;
+    heap->free_blocks[fl][sl] = block;
+
+    heap->fl_bitmap |= 1U << fl;
+    heap->sl_bitmap[fl] |= 1U << sl;
+    stamp_block(heap, block);
+}
+
+/**
+ * Unlinks a free block from its bucket and clears the bitmaps if the bucket becomes empty.
+ */
+static void remove_free_block(vs_heap_t* heap, MemBlock* block)
+{
+    int fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+
+    if (block->prev_free)
+        block->prev_free->next_free = block->next_free;
+    else
+        heap->free_blocks[fl][sl] = block->next_free;
+    if (block->next_free)
+        block->next_free->prev_free = block->prev_free;
+
+    if (!heap->free_blocks[fl][sl])
+    {
+        heap->sl_bitmap[fl] &= ~(1U << sl);
+        if (!heap->sl_bitmap[fl])
+            heap->fl_bitmap &= ~(1U << fl);
+    }
+}
+
+/**
+ * Called whenever a block is merged into the block before it: the compactor's cursor must not be
+ * left in the middle of the merged block.
+ */
+static void forget_block(vs_heap_t* heap, const MemBlock* absorbed, MemBlock* into)
+{
+    if (heap->compact_cursor == absorbed)
+        heap->compact_cursor = into;
+}
+
+/**
+ * Absorbs the physically next block, which must be free, into this block.
+ * The merged neighbour leaves the free index. The caller is responsible for the flags of what follows.
+ */
+static void merge_next(vs_heap_t* heap, MemBlock* block)
+{
+    MemBlock* next = block_next(block);
+    remove_free_block(heap, next);
+    forget_block(heap, next, block);
+    block_set_size(block, block_size(block) + BLOCK_HEADER_SIZE + block_size(next));
+    STAT_ADD(STAT_VS_COALESCE, 1);
+}
+
+/**
+ * Known-zero memory.
+ *
+ * Regions often start out zeroed: chunks come zeroed from the OS, and the caller's region can be declared
+ * zeroed with vs_set_zeroed. Each region keeps a mark, an offset from its start (heap->fresh, chunk->fresh),
+ * past which every byte is still zero except the word before the sentinel, where the footer of a free last
+ * block lives. Memory past the mark was never handed out, so it all belongs to the region's last block,
+ * and the mark only moves when split_block hands out the end of a region: past the block, or past the
+ * header, links and idle time of the free remainder. vs_calloc then clears what its block has below the old mark,
+ * and the footer word. The caller's region starts with its mark at its end, which tells nothing.
+ */
+
+/**
+ * Moves the mark of a region when a block at its end was handed out (see above).
+ * Remembers the old mark in heap->fresh_start for vs_calloc.
+ * @param last The block split_block handed out or split off last
+ * @param end The end of the memory the split wrote to or handed out
+ */
+static void touch_tail(vs_heap_t* heap, const MemBlock* last, const char* end)
+{
+    if (block_size(block_next(last))) // Not followed by the sentinel: behind the mark
+        return;
+
+    char* base;
+    size_t* fresh;
+    if (heap->size && region_owns(heap->memory, heap->size, block_to_ptr(last)))
+    {
+        base = heap->memory;
+        fresh = &heap->fresh;
+    }
+    else
+    {
+        // Chunks are few and the newest one comes first, like in release_chunk
+        VsChunk* chunk = heap->chunks;
+        while (chunk && ((char*)last < (char*)chunk || (char*)last >= (char*)chunk + chunk->size))
+            chunk = chunk->next;
+        if (!chunk)
+            return;
+        base = (char*)chunk;
+        fresh = &chunk->fresh;
+    }
+
+    if ((size_t)(end - base) > *fresh)
+    {
+        heap->fresh_start = base + *fresh;
+        *fresh = (size_t)(end - base);
+    }
+}
+
+/**
+ * Splits the tail of a used block into a new free block if the surplus fits a header and a minimal payload.
+ * The remainder is merged with a free successor and inserted into the free index.
+ * @param block The block to trim. Must be marked used.
+ * @param size The payload size the block keeps.
+ */
+static void split_block(vs_heap_t* heap, MemBlock* block, size_t size)
+{
+    if (block_size(block) < size + BLOCK_HEADER_SIZE + MIN_BLOCK_SIZE)
+    {
+        touch_tail(heap, block, (char*)block_to_ptr(block) + block_size(block));
+        return;
+    }
+
+    MemBlock* rem = (MemBlock*)((char*)block_to_ptr(block) + size);
+    rem->header = (block_size(block) - size - BLOCK_HEADER_SIZE) | BLOCK_PREV_USED;
+    block_set_size(block, size);
+    STAT_ADD(STAT_VS_SPLIT, 1);
+
+    // Keep the invariant that no two free blocks are adjacent
+    if (!block_is_used(block_next(rem)))
+        merge_next(heap, rem);
+
+    block_mark_free(rem);
+    insert_free_block(heap, rem);
+    touch_tail(heap, rem, (char*)rem + FREE_PREFIX_SIZE); // Past its links and idle time
+}
+
+/**
+ * Returns the granularity of OS mappings.
+ */
+static size_t page_size()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+#else
+    long size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? (size_t)size : 4096;
+#endif
+}
+
+/**
+ * Maps zeroed, read-write pages from the OS.
+ * @return The start of the mapping, or NULL on failure.
+ */
+static void* map_pages(size_t size)
+{
+#ifdef _WIN32
+    return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+#endif
+}
+
+static void unmap_pages(void* memory, size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    munmap(memory, size);
+#endif
+}
+
+/**
+ * Lets the OS reclaim whole pages while keeping them mapped. They read as zero or as their old contents.
+ * @param lazy Whether to use MADV_FREE, which only reclaims the pages under memory pressure
+ */
+static void purge_pages(void* memory, size_t size, int lazy)
+{
+#ifdef _WIN32
+    (void)lazy;
+    VirtualAlloc(memory, size, MEM_RESET, PAGE_READWRITE);
+#else
+#ifdef MADV_FREE
+    if (lazy && !madvise(memory, size, MADV_FREE))
+        return;
+#else
+    (void)lazy;
+#endif
+    madvise(memory, size, MADV_DONTNEED); // Only a hint: failure leaves the pages resident
+#endif
+}
+
+/**
+ * Returns the first block of a chunk.
+ */
+static MemBlock* chunk_first_block(const VsChunk* chunk)
+{
+    return (MemBlock*)((char*)chunk + CHUNK_HEADER_SIZE);
+}
+
+/**
+ * Maps a new chunk that fits a payload of the given size and links it into the heap.
+ * The chunk is at least heap->chunk_size bytes, rounded up to whole pages.
+ * @param size The aligned payload size the chunk must fit
+ * @return The chunk's only block, free and in the free index, or NULL if the mapping failed.
+ */
+static MemBlock* grow_heap(vs_heap_t* heap, size_t size)
+{
+    size_t page = page_size();
+    size_t map_size = CHUNK_HEADER_SIZE + 2 * BLOCK_HEADER_SIZE + size;
+    if (map_size < heap->chunk_size)
+        map_size = heap->chunk_size;
+    map_size = (map_size + page - 1) / page * page;
+
+    VsChunk* chunk = map_pages(map_size);
+    if (!chunk)
+        return NULL;
+    STAT_ADD(STAT_VS_CHUNK_MAP, 1);
+
+    chunk->size = map_size;
+    chunk->fresh = CHUNK_HEADER_SIZE + FREE_PREFIX_SIZE; // Past the first block's header, links and idle time
+    chunk->prev = NULL;
+    chunk->next = heap->chunks;
+    if (chunk->next)
+        chunk->next->prev = chunk;
+    heap->chunks = chunk;
+
+    // The page rounding may exceed what the index can describe. The excess is left unused.
+    size_t payload = map_size - CHUNK_HEADER_SIZE - 2 * BLOCK_HEADER_SIZE;
+    if (payload > MAX_BLOCK_SIZE)
+        payload = MAX_BLOCK_SIZE & ~(size_t)(ALIGN_SIZE - 1);
+
+    // Same layout as vs_init_heap: one free block ended by a used sentinel
+    MemBlock* first = chunk_first_block(chunk);
+    first->header = payload | BLOCK_PREV_USED | BLOCK_FIRST;
+    block_next(first)->header = BLOCK_USED;
+    block_mark_free(first);
+    insert_free_block(heap, first);
+
+    return first;
+}
+
+/**
+ * Unmaps the chunk of a free block that spans its whole chunk,
+ * unless fewer than heap->retained_chunks other chunks are fully free.
+ * Blocks of the heap's own region are never released.
+ * @param block A free block with BLOCK_FIRST set, followed by the sentinel. Not in the free index.
+ * @return 1 if the chunk was unmapped. 0 if the block stays in the heap.
+ */
+static int release_chunk(vs_heap_t* heap, MemBlock* block)
+{
+    if ((char*)block == heap->memory)
+        return 0;
+
+    VsChunk* chunk = (VsChunk*)((char*)block - CHUNK_HEADER_SIZE);
+
+    // Fully free chunks are rare, so they are counted on demand rather than tracked
+    size_t free_chunks = 0;
+    for (const VsChunk* curr = heap->chunks; curr; curr = curr->next)
+    {
+        MemBlock* first = chunk_first_block(curr);
+        if (curr != chunk && !block_is_used(first) && !block_size(block_next(first)))
+            free_chunks++;
+    }
+    if (free_chunks < heap->retained_chunks)
+        return 0;
+
+    if (chunk->prev)
+        chunk->prev->next = chunk->next;
+    else
+        heap->chunks = chunk->next;
+    if (chunk->next)
+        chunk->next->prev = chunk->prev;
+
+    unmap_pages(chunk, chunk->size);
+    STAT_ADD(STAT_VS_CHUNK_UNMAP, 1);
+    return 1;
+}
+
+/**
+ * Large objects.
+ *
+ * When heap->large_threshold is set, requests of at least that size bypass the free index: each one gets
+ * a page-aligned mapping of its own, made of a VsLarge header and the payload. Large objects therefore
+ * neither fragment the regions nor lengthen their free lists, and can exceed MAX_BLOCK_SIZE.
+ *
+ * - Lookup: The payload addresses of live large objects are kept in an open-addressing hash table
+ *   (itself a mapping, doubled when half full), so vs_free recognizes them in O(1) without reading
+ *   memory behind an invalid pointer.
+ * - Huge pages: VS_LARGE_TRANSPARENT_HUGE_PAGES rounds mappings to 2 MiB and advises the kernel to back
+ *   them with transparent huge pages. VS_LARGE_HUGETLB asks for explicit huge pages and falls back to
+ *   regular pages when none are reserved.
+ * - Cache: Up to heap->large_cache_limit freed mappings are kept and reused by later requests they fit
+ *   without wasting more than half, so repeated large buffers avoid the mmap/munmap round trip.
+ */
+
+/**
+ * Returns the table slot where a large object's payload address is, or should be, stored.
+ */
+static size_t large_slot(const vs_heap_t* heap, uintptr_t key)
+{
+    size_t mask = heap->large_capacity - 1;
+    size_t slot = (size_t)(((uint64_t)(key >> 4) * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    while (heap->large_table[slot] && heap->large_table[slot] != key)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * Checks whether a pointer is the payload of one of the heap's large objects.
+ */
+static int large_contains(const vs_heap_t* heap, const void* ptr)
+{
+    return heap->large_count && ptr && heap->large_table[large_slot(heap, (uintptr_t)ptr)];
+}
+
+/**
+ * Records a large object's payload address, growing the table when it becomes half full.
+ * @return 0 on success. 1 if a larger table could not be mapped.
+ */
+static int large_insert(vs_heap_t* heap, const void* ptr)
+{
+    if (2 * (heap->large_count + 1) > heap->large_capacity)
+    {
+        size_t old_capacity = heap->large_capacity;
+        uintptr_t* old_table = heap->large_table;
+        size_t capacity = old_capacity ? 2 * old_capacity : LARGE_TABLE_MIN_CAPACITY;
+        uintptr_t* table = map_pages(capacity * sizeof(uintptr_t)); // Zeroed: every slot is empty
+        if (!table)
+            return 1;
+
+        heap->large_table = table;
+        heap->large_capacity = capacity;
+        for (size_t i = 0; i < old_capacity; i++)
+        {
+            if (old_table[i])
+                table[large_slot(heap, old_table[i])] = old_table[i];
+        }
+        if (old_table)
+            unmap_pages(old_table, old_capacity * sizeof(uintptr_t));
+    }
+
+    heap->large_table[large_slot(heap, (uintptr_t)ptr)] = (uintptr_t)ptr;
+    heap->large_count++;
+    return 0;
+}
+
+/**
+ * Forgets a large object's payload address (backward-shift deletion keeps every probe sequence intact).
+ */
+static void large_remove(vs_heap_t* heap, const void* ptr)
+{
+    size_t mask = heap->large_capacity - 1;
+    size_t hole = large_slot(heap, (uintptr_t)ptr);
+    heap->large_table[hole] = 0;
+    heap->large_count--;
+
+    for (size_t slot = (hole + 1) & mask; heap->large_table[slot]; slot = (slot + 1) & mask)
+    {
+        uintptr_t key = heap->large_table[slot];
+        heap->large_table[slot] = 0;
+        heap->large_table[large_slot(heap, key)] = key;
+    }
+}
+
+/**
+ * Maps a new large object of at least the given payload size, honouring the heap's huge-page flags.
+ * @return The mapping's header, or NULL if the mapping failed.
+ */
+static VsLarge* map_large(const vs_heap_t* heap, size_t size)
+{
+    if (size > SIZE_MAX - LARGE_HEADER_SIZE - HUGE_PAGE_SIZE)
+        return NULL;
+    size_t huge_size = (LARGE_HEADER_SIZE + size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+    VsLarge* large = NULL;
+    size_t map_size = huge_size;
+    size_t hugetlb = 0;
+#ifdef __linux__
+    if (heap->large_flags & VS_LARGE_HUGETLB)
+    {
+        large = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (large == MAP_FAILED) // No huge pages reserved - Use regular ones
+            large = NULL;
+        else
+            hugetlb = 1;
+    }
+#endif
+    if (!large)
+    {
+        if (!(heap->large_flags & VS_LARGE_TRANSPARENT_HUGE_PAGES))
+            map_size = (LARGE_HEADER_SIZE + size + page_size() - 1) / page_size() * page_size();
+        large = map_pages(map_size);
+        if (!large)
+            return NULL;
+#ifdef __linux__
+        if (heap->large_flags & VS_LARGE_TRANSPARENT_HUGE_PAGES)
+            madvise(large, map_size, MADV_HUGEPAGE); // Only a hint: failure leaves regular pages
+#endif
+    }
+
+    large->map_size = map_size;
+    large->hugetlb = hugetlb;
+    STAT_ADD(STAT_VS_LARGE_MAP, 1);
+
+    return large;
+}
+
+/**
+ * Allocates a large object, from the cache of freed mappings when one fits.
+ * @return The payload, or NULL if no memory could be mapped.
+ */
+static void* large_malloc(vs_heap_t* heap, size_t size)
+{
+    // Best fit among the cached mappings, as long as at most half of it is wasted
+    VsLarge* large = NULL;
+    size_t best = 0;
+    for (size_t i = 0; i < heap->large_cached; i++)
+    {
+        VsLarge* cached = heap->large_cache[i];
+        size_t usable = cached->map_size - LARGE_HEADER_SIZE;
+        if (usable >= size && usable / 2 <= size && (!large || cached->map_size < large->map_size))
+        {
+            large = cached;
+            best = i;
+        }
+    }
+
+    if (large)
+    {
+        heap->large_cache[best] = heap->large_cache[--heap->large_cached];
+        STAT_ADD(STAT_VS_LARGE_CACHE_HIT, 1);
+    }
+    else if (!(large = map_large(heap, size)))
+        return NULL;
+
+    void* ptr = (char*)large + LARGE_HEADER_SIZE;
+    if (large_insert(heap, ptr))
+    {
+        unmap_pages(large, large->map_size);
+        return NULL;
+    }
+
+    return ptr;
+}
+
+/**
+ * Frees a large object: its mapping goes to the cache, or back to the OS when the cache is full.
+ */
+static void large_free(vs_heap_t* heap, void* ptr)
+{
+    VsLarge* large = (VsLarge*)((char*)ptr - LARGE_HEADER_SIZE);
+    large_remove(heap, ptr);
+
+    if (heap->large_cached < heap->large_cache_limit)
+        heap->large_cache[heap->large_cached++] = large;
+    else
+        unmap_pages(large, large->map_size);
+}
+
+/**
+ * Resizes a large object that stays large. Its mapping is remapped, so the data is never copied,
+ * unless it uses explicit huge pages.
+ * @return The new payload, or NULL if the object could not grow (it is left untouched).
+ */
+static void* large_realloc(vs_heap_t* heap, void* ptr, size_t size)
+{
+    VsLarge* large = (VsLarge*)((char*)ptr - LARGE_HEADER_SIZE);
+    if (size <= large->map_size - LARGE_HEADER_SIZE)
+        return ptr;
+
+#ifdef __linux__
+    if (!large->hugetlb && size <= SIZE_MAX - LARGE_HEADER_SIZE - HUGE_PAGE_SIZE)
+    {
+        size_t granularity = heap->large_flags & VS_LARGE_TRANSPARENT_HUGE_PAGES ? HUGE_PAGE_SIZE : page_size();
+        size_t map_size = (LARGE_HEADER_SIZE + size + granularity - 1) / granularity * granularity;
+        VsLarge* moved = mremap(large, large->map_size, map_size, MREMAP_MAYMOVE);
+        if (moved != MAP_FAILED)
+        {
+            moved->map_size = map_size;
+            large_remove(heap, ptr);
+            void* new_ptr = (char*)moved + LARGE_HEADER_SIZE;
+            large_insert(heap, new_ptr); // Can't fail: the table has just lost an entry
+            STAT_ADD(STAT_VS_REALLOC_REMAP, 1);
+            return new_ptr;
+        }
+    }
+#endif
+
+    void* new_ptr = large_malloc(heap, size);
+    if (new_ptr)
+    {
+        memcpy(new_ptr, ptr, large->map_size - LARGE_HEADER_SIZE);
+        large_free(heap, ptr);
+        STAT_ADD(STAT_VS_REALLOC_COPY, 1);
+    }
+    return new_ptr;
+}
+
+/**
+ * Grows the used block at the end of a chunk by remapping the chunk, so its data is never copied.
+ *
+ * The block is either followed by the chunk's sentinel, or by a free block and then the sentinel.
+ * A chunk holding only this block may move to a new address (the kernel moves its pages without a copy).
+ * Any other chunk can only grow in place, since the addresses of its other blocks must not change.
+ * The chunk grows by at least heap->chunk_size, so a growing buffer rarely needs another remap.
+ *
+ * @param heap The heap the block belongs to. Must be growable.
+ * @param block The used block to grow
+ * @param size The aligned payload size the block needs
+ * @return The grown block, possibly moved, with its surplus still attached. NULL if the chunk can't grow.
+ */
+static MemBlock* remap_chunk(vs_heap_t* heap, MemBlock* block, size_t size)
+{
+#ifdef __linux__
+    MemBlock* next = block_next(block);
+    MemBlock* tail = block_is_used(next) ? next : block_next(next);
+    if (block_size(tail)) // Not the last block of its region
+        return NULL;
+
+    VsChunk* chunk = NULL;
+    for (VsChunk* curr = heap->chunks; curr && !chunk; curr = curr->next)
+    {
+        if ((char*)block > (char*)curr && (char*)block < (char*)curr + curr->size)
+            chunk = curr;
+    }
+    if (!chunk) // The heap's own region can't grow
+        return NULL;
+
+    size_t page = page_size();
+    size_t offset = (size_t)((char*)block_to_ptr(block) - (char*)chunk);
+    size_t map_size = offset + size + BLOCK_HEADER_SIZE;
+    if (map_size < chunk->size + heap->chunk_size)
+        map_size = chunk->size + heap->chunk_size;
+    map_size = (map_size + page - 1) / page * page;
+    if (map_size - offset - BLOCK_HEADER_SIZE > MAX_BLOCK_SIZE)
+        return NULL;
+
+    // A block that moves with the chunk can't stay linked into the free index
+    int moves = (block->header & BLOCK_FIRST) != 0;
+    if (next != tail)
+        remove_free_block(heap, next);
+
+    VsChunk* grown = mremap(chunk, chunk->size, map_size, moves ? MREMAP_MAYMOVE : 0);
+    if (grown == MAP_FAILED)
+    {
+        if (next != tail)
+            insert_free_block(heap, next);
+        return NULL;
+    }
+
+    grown->size = map_size;
+    if (grown != chunk)
+    {
+        if (grown->prev)
+            grown->prev->next = grown;
+        else
+            heap->chunks = grown;
+        if (grown->next)
+            grown->next->prev = grown;
+        block = (MemBlock*)((char*)grown + ((char*)block - (char*)chunk));
+    }
+
+    // The block absorbs the free tail and the new pages, and a new sentinel ends the chunk
+    block_set_size(block, map_size - offset - BLOCK_HEADER_SIZE);
+    block_next(block)->header = BLOCK_USED | BLOCK_PREV_USED;
+
+    return block;
+#else
+    (void)heap;
+    (void)block;
+    (void)size;
+    return NULL;
+#endif
+}
+
+/**
+ * Returns a used block to the free index.
+ *
+ * Coalescing - Merge with adjacent free blocks to reduce fragmentation.
+ * The next block is merged first, then the previous one absorbs the result.
+ * Merged neighbours leave the free index and the combined block is re-inserted once.
+ * A chunk that becomes fully free may be unmapped.
+ *
+ * @param block A used block, not on a quick-list
+ */
+static void free_block(vs_heap_t* heap, MemBlock* block)
+{
+    // Merge with the NEXT block
+    if (!block_is_used(block_next(block)))
+        merge_next(heap, block);
+
+    // Merge with the PREVIOUS block (Current block is absorbed)
+    if (!block_is_prev_used(block))
+    {
+        MemBlock* prev = block_prev(block);
+        remove_free_block(heap, prev);
+        block_set_size(prev, block_size(prev) + BLOCK_HEADER_SIZE + block_size(block));
+        forget_block(heap, block, prev);
+        block->header &= ~BLOCK_USED; // The absorbed header must not pass for a used block on a repeated free
+        block = prev;
+        STAT_ADD(STAT_VS_COALESCE, 1);
+    }
+
+    block_mark_free(block); // Mark the block as free
+
+    // A chunk that became fully free may go back to the OS
+    if ((block->header & BLOCK_FIRST) && !block_size(block_next(block)) && release_chunk(heap, block))
+        return;
+
+    insert_free_block(heap, block);
+    if (heap->purge_decay && heap->purge_clock >= heap->purge_next) // Due, and just stamped a large block
+        vs_purge(heap, 0);
+}
+
+/**
+ * Quick-lists (deferred coalescing).
+ *
+ * When enabled, a freed block of at most VS_QUICK_MAX_SIZE bytes is pushed onto the LIFO bin of its
+ * exact size instead of being coalesced. It stays marked used, so its neighbours never merge with it
+ * and the next vs_malloc of that size pops it back without any search, split or merge.
+ * A bin is consolidated (its blocks are freed for real) once it holds more than heap->quick_limit blocks,
+ * and every bin is consolidated when a search of the free index misses.
+ *
+ * A queued block links to the next one through its next_free word and holds a per-heap tag in its
+ * prev_free word. Only tagged blocks are searched for on vs_free, which keeps double frees detectable.
+ */
+#define QUICK_TAG(heap) ((MemBlock*)((uintptr_t)(heap) ^ (uintptr_t)0x9E3779B97F4A7C15ULL))
+
+/**
+ * Returns the quick-list of a block size, or -1 if blocks of that size are always coalesced.
+ */
+static int quick_bin(size_t size)
+{
+    return size <= VS_QUICK_MAX_SIZE ? (int)(size >> ALIGN_SIZE_LOG2) - 1 : -1;
+}
+
+/**
+ * Checks whether a block is queued on a quick-list.
+ */
+static int quick_contains(const vs_heap_t* heap, int bin, const MemBlock* block)
+{
+    for (const MemBlock* curr = heap->quick_bins[bin]; curr; curr = curr->next_free)
+    {
+        if (curr == block)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * Checks whether a block that is marked used is in fact freed onto a quick-list.
+ */
+static int quick_queued(const vs_heap_t* heap, const MemBlock* block)
+{
+    int bin = heap->quick_limit ? quick_bin(block_size(block)) : -1;
+    return bin >= 0 && block->prev_free == QUICK_TAG(heap) && quick_contains(heap, bin, block);
+}
+
+/**
+ * Frees every block of a quick-list into the free index, coalescing them.
+ */
+static void consolidate_bin(vs_heap_t* heap, int bin)
+{
+    MemBlock* block = heap->quick_bins[bin];
+    heap->quick_bins[bin] = NULL;
+    heap->quick_counts[bin] = 0;
+    heap->quick_bitmap &= ~(1U << bin);
+
+    while (block)
+    {
+        MemBlock* next = block->next_free; // Overwritten once the block is free
+        free_block(heap, block);
+        block = next;
+    }
+    STAT_ADD(STAT_VS_CONSOLIDATE, 1);
+}
+
+/**
+ * Frees the blocks of every quick-list into the free index.
+ */
+static void consolidate(vs_heap_t* heap)
+{
+    while (heap->quick_bitmap)
+    {
+        consolidate_bin(heap, __builtin_ctz(heap->quick_bitmap));
+    }
+}
+
+/**
+ * Remote frees.
+ *
+ * A heap is owned by one thread (or guarded by one lock), but any thread may return a block to it with
+ * vs_free_remote: the payload is pushed onto the heap's remote_frees stack with one compare-and-swap,
+ * linked through its first word, and the block stays marked used. When a search of the free index
+ * misses, the owner takes the whole stack with one atomic exchange and frees the blocks as usual
+ * (so they coalesce, and validation and double-free detection still happen), before consolidating
+ * the quick-lists. The owner never pops single entries, so there is no ABA problem.
+ */
+
+/**
+ * Frees every block queued by other threads (see above).
+ * @return The number of blocks taken from the queue.
+ */
+static size_t drain_remote(vs_heap_t* heap)
+{
+    void* ptr = atomic_exchange_explicit(&heap->remote_frees, NULL, memory_order_acquire);
+    size_t drained = 0;
+    while (ptr)
+    {
+        void* next = *(void**)ptr; // Overwritten once the block is free
+        vs_free(heap, ptr);
+        ptr = next;
+        drained++;
+    }
+    return drained;
+}
+
+/**
+ * Frees memory on behalf of a thread that does not own the heap.
+ * Safe to call concurrently with any other call on the heap. The memory becomes available to the owner
+ * when one of its searches misses, or on vs_drain_remote. Not for movable blocks (see vs_hfree).
+ * Queuing the same memory twice links it to itself and is not detected.
+ * @param heap The heap the memory was allocated from
+ * @param ptr A pointer to the memory that should be freed. Only checked for NULL and alignment here:
+ *            the ownership checks read state the owner changes, so they wait for the drain.
+ */
+void vs_free_remote(vs_heap_t* heap, void* ptr)
+{
+    if (!ptr || (uintptr_t)ptr % ALIGN_SIZE != 0)
+    {
+        RON_ERROR(RON_EINVAL, ptr);
+        STAT_ADD(STAT_VS_INVALID_FREE, 1);
+        return;
+    }
+
+    void* head = atomic_load_explicit(&heap->remote_frees, memory_order_relaxed);
+    do
+    {
+        *(void**)ptr = head;
+    } while (!atomic_compare_exchange_weak_explicit(&heap->remote_frees, &head, ptr, memory_order_release,
+                                                    memory_order_relaxed));
+    STAT_ADD(STAT_VS_REMOTE_FREE, 1);
+}
+
+/**
+ * Frees the memory other threads returned with vs_free_remote. Must be called by the heap's owner.
+ * Allocations do this on their own when a search misses.
+ * @param heap The heap to drain
+ */
+void vs_drain_remote(vs_heap_t* heap)
+{
+    drain_remote(heap);
+}
+
+/**
+ * Finds a free block of at least the given size and leaves it in the free index.
+ * A miss frees the blocks queued by other threads, consolidates the quick-lists and searches again,
+ * then maps a new chunk if the heap may grow.
+ * @param size The aligned payload size
+ * @return The block, or NULL if there is none.
+ */
+static MemBlock* find_free_block(vs_heap_t* heap, size_t size)
+{
+    // Good-fit search: Finds a bucket whose blocks are all large enough to satisfy the size.
+    // The bucket granularity bounds the wasted space while keeping the lookup constant-time.
+    int fl, sl;
+    mapping_search(size, &fl, &sl);
+    MemBlock* block = search_suitable_block(heap, &fl, &sl);
+
+    // Blocks queued by other threads or held by the quick-lists may coalesce into a fit
+    if (!block && (heap->quick_bitmap || atomic_load_explicit(&heap->remote_frees, memory_order_relaxed)))
+    {
+        drain_remote(heap);
+        consolidate(heap);
+        mapping_search(size, &fl, &sl);
+        block = search_suitable_block(heap, &fl, &sl);
+    }
+
+    // No suitable block found - Map a new chunk if the heap may grow
+    if (!block && heap->chunk_size)
+        block = grow_heap(heap, size);
+
+    return block;
+}
+
+/**
+ * Pops a block of exactly the given size from its quick-list.
+ * @param size The aligned payload size
+ * @return The block, still marked used, or NULL if the quick-list is empty or does not exist.
+ */
+static MemBlock* quick_pop(vs_heap_t* heap, size_t size)
+{
+    int bin = quick_bin(size);
+    if (bin < 0 || !(heap->quick_bitmap & (1U << bin)))
+        return NULL;
+
+    MemBlock* block = heap->quick_bins[bin];
+    heap->quick_bins[bin] = block->next_free;
+    if (!--heap->quick_counts[bin])
+        heap->quick_bitmap &= ~(1U << bin);
+    block->prev_free = NULL; // Drop the tag
+    STAT_ADD(STAT_VS_QUICK_HIT, 1);
+
+    return block;
+}
+
+/**
+ * Initializes a variable-size heap over a memory region.
+ *
+ * One free memory block is created that spans across the region,
+ * followed by a zero-sized used sentinel that terminates the block sequence.
+ * A NULL region of size 0 creates an empty heap, which only serves memory once growth is enabled.
+ * Growth is disabled until vs_set_growth is called.
+ * @param heap The heap handle to initialize
+ * @param memory The region to manage. Must be 8-byte aligned.
+ * @param size The size of the region in bytes. Any unaligned tail is left unused.
+ * @return 0 on successful initialization. 1 Otherwise.
+ */
+int vs_init_heap(vs_heap_t* heap, void* memory, size_t size)
+{
+    size &= ~(size_t)(ALIGN_SIZE - 1);
+    if (heap && !memory && !size)
+    {
+        memset(heap, 0, sizeof(*heap));
+        atomic_init(&heap->remote_frees, NULL);
+        return 0;
+    }
+    if (!heap || !memory || (uintptr_t)memory % ALIGN_SIZE != 0 || size < MIN_HEAP_SIZE
+        || size - 2 * BLOCK_HEADER_SIZE > MAX_BLOCK_SIZE)
+    {
+        RON_ERROR(RON_ECONFIG, memory);
+        return 1;
+    }
+
+    heap->memory = memory;
+    heap->size = size;
+    heap->chunks = NULL;
+    heap->chunk_size = 0;
+    heap->retained_chunks = 0;
+    heap->quick_limit = 0;
+    heap->quick_bitmap = 0;
+    memset(heap->quick_bins, 0, sizeof(heap->quick_bins));
+    memset(heap->quick_counts, 0, sizeof(heap->quick_counts));
+    heap->large_threshold = 0;
+    heap->large_flags = 0;
+    heap->large_cache_limit = 0;
+    heap->large_table = NULL;
+    heap->large_capacity = 0;
+    heap->large_count = 0;
+    heap->large_cached = 0;
+    heap->handles = NULL;
+    heap->handle_capacity = 0;
+    heap->free_handle = 0;
+    heap->compact_cursor = NULL;
+    atomic_init(&heap->remote_frees, NULL);
+    heap->fresh = size; // Unknown contents (see vs_set_zeroed)
+    heap->fresh_start = NULL;
+    heap->purge_decay = 0;
+    heap->purge_min_size = 0;
+    heap->purge_flags = 0;
+    heap->purge_clock = 0;
+    heap->purge_next = 0;
+
+    // Reset the free index
+    heap->fl_bitmap = 0;
+    memset(heap->sl_bitmap, 0, sizeof(heap->sl_bitmap));
+    memset(heap->free_blocks, 0, sizeof(heap->free_blocks));
+
+    // Terminate the region with a used sentinel so that block_next never leaves the heap
+    MemBlock* sentinel = (MemBlock*)(heap->memory + size - BLOCK_HEADER_SIZE);
+    sentinel->header = BLOCK_USED;
+
+    // Initialize the region as one big free block. Nothing precedes it, so it never looks backwards.
+    MemBlock* first = (MemBlock*)heap->memory;
+    first->header = (size - 2 * BLOCK_HEADER_SIZE) | BLOCK_PREV_USED | BLOCK_FIRST;
+    block_mark_free(first);
+    insert_free_block(heap, first);
+
+    return 0;
+}
+
+/**
+ * Lets a heap grow by mapping chunks from the OS when no free block fits a request.
+ * Each chunk only coalesces internally and is unmapped again once it is fully free,
+ * unless it is among the first `retained_chunks` fully free chunks, which stay mapped for reuse.
+ * @param heap The heap to configure
+ * @param chunk_size The minimal size of a mapped chunk in bytes. 0 disables growth.
+ * @param retained_chunks How many fully free chunks to keep mapped
+ * @return 0 on success. 1 if the chunk size is larger than a block can describe.
+ */
+int vs_set_growth(vs_heap_t* heap, size_t chunk_size, size_t retained_chunks)
+{
+    if (chunk_size > MAX_BLOCK_SIZE)
+    {
+        RON_ERROR(RON_ECONFIG, NULL);
+        return 1;
+    }
+
+    heap->chunk_size = chunk_size;
+    heap->retained_chunks = retained_chunks;
+
+    return 0;
+}
+
+/**
+ * Enables or disables the quick-lists of a heap (see below).
+ * They pay off for churn of same-sized small objects, at the cost of fragmentation held back
+ * until the next consolidation.
+ * @param heap The heap to configure
+ * @param bin_limit Blocks a quick-list may hold before it is consolidated. 0 disables the quick-lists
+ *                  and consolidates the blocks they hold.
+ */
+void vs_set_quick_lists(vs_heap_t* heap, size_t bin_limit)
+{
+    heap->quick_limit = bin_limit;
+    if (!bin_limit)
+        consolidate(heap);
+}
+
+/**
+ * Routes requests of at least a threshold size to dedicated mappings (see above).
+ * Large objects allocated before the path is disabled can still be freed and reallocated.
+ * @param heap The heap to configure
+ * @param threshold The smallest request served by its own mapping. 0 disables the path.
+ * @param flags VS_LARGE_TRANSPARENT_HUGE_PAGES or VS_LARGE_HUGETLB, or 0 for regular pages
+ * @param cache_count How many freed mappings to keep for reuse, at most VS_LARGE_CACHE_MAX
+ * @return 0 on success. 1 if the cache count is too large.
+ */
+int vs_set_large_objects(vs_heap_t* heap, size_t threshold, unsigned int flags, size_t cache_count)
+{
+    if (cache_count > VS_LARGE_CACHE_MAX)
+    {
+        RON_ERROR(RON_ECONFIG, NULL);
+        return 1;
+    }
+
+    heap->large_threshold = threshold;
+    heap->large_flags = flags;
+    heap->large_cache_limit = cache_count;
+    while (heap->large_cached > cache_count)
+    {
+        VsLarge* large = heap->large_cache[--heap->large_cached];
+        unmap_pages(large, large->map_size);
+    }
+
+    return 0;
+}
+
+/**
+ * Enables or disables purging (see above). Free blocks already in the index start their idle period now.
+ * @param heap The heap to configure
+ * @param decay_ms Milliseconds a free block stays idle before it is purged. 0 disables purging.
+ * @param min_size The smallest free block to purge, raised to two pages (smaller blocks hold no whole page)
+ * @param flags VS_PURGE_LAZY and VS_PURGE_REGION, or 0
+ */
+void vs_set_purging(vs_heap_t* heap, uint64_t decay_ms, size_t min_size, unsigned int flags)
+{
+    heap->purge_decay = decay_ms;
+    heap->purge_min_size = min_size > 2 * page_size() ? min_size : 2 * page_size();
+    heap->purge_flags = flags;
+    if (!decay_ms)
+        return;
+
+    // Blocks freed while purging was off carry no stamp yet
+    heap->purge_next = clock_ms() + decay_ms;
+    for (int fl = 0; fl < FL_INDEX_COUNT; fl++)
+    {
+        if (!(heap->fl_bitmap & (1U << fl)))
+            continue;
+        for (int sl = 0; sl < SL_INDEX_COUNT; sl++)
+        {
+            for (MemBlock* block = heap->free_blocks[fl][sl]; block; block = block->next_free)
+                stamp_block(heap, block);
+        }
+    }
+}
+
+/**
+ * Returns the pages of idle free blocks to the OS (see above). Frees call this on their own once a purge
+ * is due; a background thread or a memory-pressure handler may call it too, holding the heap's lock.
+ * @param heap The heap to purge. Purging must be enabled with vs_set_purging.
+ * @param all 1 to purge every tracked free block, whatever its idle time. 0 to purge the idle ones.
+ * @return The number of bytes advised.
+ */
+size_t vs_purge(vs_heap_t* heap, int all)
+{
+    if (!heap->purge_decay)
+        return 0;
+
+    uint64_t now = clock_ms();
+    size_t page = page_size();
+    size_t purged = 0;
+    int min_fl, min_sl;
+    mapping_insert(heap->purge_min_size, &min_fl, &min_sl);
+    for (int fl = min_fl; fl < FL_INDEX_COUNT; fl++)
+    {
+        if (!(heap->fl_bitmap & (1U << fl)))
+            continue;
+        for (int sl = 0; sl < SL_INDEX_COUNT; sl++)
+        {
+            for (MemBlock* block = heap->free_blocks[fl][sl]; block; block = block->next_free)
+            {
+                size_t* idle = block_idle(block);
+                if (block_size(block) < heap->purge_min_size || (*idle & IDLE_PURGED)
+                    || (!all && now - (*idle >> 1) < heap->purge_decay))
+                    continue;
+                if (!(heap->purge_flags & VS_PURGE_REGION) && heap->size
+                    && region_owns(heap->memory, heap->size, block_to_ptr(block)))
+                    continue;
+
+                // Whole pages between the idle word and the footer
+                uintptr_t start = ((uintptr_t)(idle + 1) + page - 1) / page * page;
+                uintptr_t end = ((uintptr_t)block_to_ptr(block) + block_size(block) - sizeof(size_t)) / page * page;
+                if (end > start)
+                {
+                    purge_pages((void*)start, end - start, heap->purge_flags & VS_PURGE_LAZY);
+                    purged += end - start;
+                }
+                *idle |= IDLE_PURGED;
+            }
+        }
+    }
+
+    heap->purge_next = now + heap->purge_decay;
+    STAT_ADD(STAT_VS_PURGED_BYTES, purged);
+    return purged;
+}
+
+/**
+ * Unmaps every chunk and large object the heap has mapped, and its handle table. The caller's region is left untouched.
+ * The heap must be re-initialized before it is used again.
+ * @param heap The heap to tear down
+ */
+void vs_destroy_heap(vs_heap_t* heap)
+{
+    while (heap->chunks)
+    {
+        VsChunk* chunk = heap->chunks;
+        heap->chunks = chunk->next;
+        unmap_pages(chunk, chunk->size);
+    }
+
+    for (size_t i = 0; i < heap->large_capacity; i++)
+    {
+        if (heap->large_table[i])
+        {
+            VsLarge* large = (VsLarge*)((char*)heap->large_table[i] - LARGE_HEADER_SIZE);
+            unmap_pages(large, large->map_size);
+        }
+    }
+    if (heap->large_table)
+        unmap_pages(heap->large_table, heap->large_capacity * sizeof(uintptr_t));
+    while (heap->large_cached)
+    {
+        VsLarge* large = heap->large_cache[--heap->large_cached];
+        unmap_pages(large, large->map_size);
+    }
+    heap->large_table = NULL;
+    heap->large_capacity = 0;
+    heap->large_count = 0;
+
+    if (heap->handles)
+        unmap_pages(heap->handles, heap->handle_capacity * sizeof(VsHandle));
+    heap->handles = NULL;
+    heap->handle_capacity = 0;
+    heap->free_handle = 0;
+}
+
+/**
+ * Allocates a block of memory.
+ *
+ * @param heap The heap to allocate from
+ * @param size The size of the memory to allocate. A 'good-fit' allocation strategy is used.
+ * @return A pointer to the allocated usable memory.
+ */
+void* vs_malloc(vs_heap_t* heap, size_t size)
+{
+    if (heap->large_threshold && size >= heap->large_threshold)
+    {
+        void* large = large_malloc(heap, size);
+        if (!large)
+        {
+            RON_ERROR(RON_ENOMEM, NULL);
+            STAT_ADD(STAT_VS_OOM, 1);
+            return NULL;
+        }
+        STAT_ADD(STAT_VS_MALLOC, 1);
+        PROF_MALLOC(large, size);
+        return large;
+    }
+
+    // Requests larger than the index can describe can never be satisfied
+    if (size > MAX_BLOCK_SIZE)
+    {
+        RON_ERROR(RON_ENOMEM, NULL);
+        STAT_ADD(STAT_VS_OOM, 1);
+        return NULL;
+    }
+    size = align_size(size);
+
+    // A queued block of the same size is reused as is
+    MemBlock* best = heap->quick_bitmap ? quick_pop(heap, size) : NULL;
+    if (best)
+    {
+        STAT_ADD(STAT_VS_MALLOC, 1);
+        PROF_MALLOC(block_to_ptr(best), size);
+        return block_to_ptr(best);
+    }
+
+    best = find_free_block(heap, size);
+    if (!best)
+    {
+        RON_ERROR(RON_ENOMEM, NULL);
+        STAT_ADD(STAT_VS_OOM, 1);
+        return NULL;
+    }
+
+    remove_free_block(heap, best);
+    block_mark_used(best); // Mark the block as used
+
+    // Split - Allocate the requested size and create a free block from the remainder
+    split_block(heap, best, size);
+
+    STAT_ADD(STAT_VS_MALLOC, 1);
+    PROF_MALLOC(block_to_ptr(best), size);
+    return block_to_ptr(best);
+}
+
+/**
+ * Allocates a block whose payload is aligned to a power of two.
+ * The search asks for enough room to align the payload inside the block found. Any leading padding
+ * large enough for a block is split off as a free block, so it is not wasted. The result is a
+ * regular block: vs_free, vs_realloc and vs_usable_size accept it like any other.
+ *
+ * @param heap The heap to allocate from
+ * @param alignment The payload alignment. Must be a power of two.
+ * @param size The size of the memory to allocate
+ * @return A pointer to the aligned usable memory.
+ */
+void* vs_memalign(vs_heap_t* heap, size_t alignment, size_t size)
+{
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+    {
+        RON_ERROR(RON_EALIGN, NULL);
+        return NULL;
+    }
+
+    // Every payload is already aligned this much
+    if (alignment <= ALIGN_SIZE)
+        return vs_malloc(heap, size);
+    if (alignment <= LARGE_HEADER_SIZE && heap->large_threshold && size >= heap->large_threshold)
+        return vs_malloc(heap, size); // So are large objects, up to their header size
+
+    // A leading gap is either empty or large enough to become a free block
+    const size_t gap_minimum = BLOCK_HEADER_SIZE + MIN_BLOCK_SIZE;
+    if (size > MAX_BLOCK_SIZE || alignment > MAX_BLOCK_SIZE - gap_minimum
+        || align_size(size) > MAX_BLOCK_SIZE - alignment - gap_minimum)
+    {
+        RON_ERROR(RON_ENOMEM, NULL);
+        STAT_ADD(STAT_VS_OOM, 1);
+        return NULL;
+    }
+    size = align_size(size);
+
+    // Enough for the payload after the worst-case gap
+    size_t adjusted = size + alignment + gap_minimum;
+    MemBlock* block = find_free_block(heap, adjusted);
+    if (!block)
+    {
+        RON_ERROR(RON_ENOMEM, NULL);
+        STAT_ADD(STAT_VS_OOM, 1);
+        return NULL;
+    }
+    remove_free_block(heap, block);
+
+    uintptr_t ptr = (uintptr_t)block_to_ptr(block);
+    uintptr_t aligned = (ptr + (alignment - 1)) & ~(uintptr_t)(alignment - 1);
+    if (aligned != ptr && aligned - ptr < gap_minimum) // Too small for a block - Move to the next boundary
+        aligned = (ptr + gap_minimum + (alignment - 1)) & ~(uintptr_t)(alignment - 1);
+
+    if (aligned != ptr)
+    {
+        // The leading part keeps the original header and flags and returns to the free index.
+        // Its physical predecessor is used, since the block was free and free blocks are never adjacent.
+        size_t gap = aligned - ptr;
+        MemBlock* lead = block;
+        block = block_from_ptr((void*)aligned);
+        block->header = block_size(lead) - gap; // Its predecessor (lead) is free
+        block_set_size(lead, gap - BLOCK_HEADER_SIZE);
+        block_mark_free(lead);
+        insert_free_block(heap, lead);
+    }
+
+    block_mark_used(block);
+    split_block(heap, block, size);
+
+    STAT_ADD(STAT_VS_MALLOC, 1);
+    PROF_MALLOC(block_to_ptr(block), size);
+    return block_to_ptr(block);
+}
+
+/**
+ * Allocates a block whose payload is aligned to a power of two (C11 aligned_alloc argument order).
+ * Unlike C11, the size does not need to be a multiple of the alignment.
+ * @param heap The heap to allocate from
+ * @param alignment The payload alignment. Must be a power of two.
+ * @param size The size of the memory to allocate
+ * @return A pointer to the aligned usable memory.
+ */
+void* vs_aligned_alloc(vs_heap_t* heap, size_t alignment, size_t size)
+{
+    return vs_memalign(heap, alignment, size);
+}
+
+/**
+ * Declares that the caller's region was zero-filled when vs_init_heap formatted it (static storage,
+ * or pages fresh from the OS), so vs_calloc can skip the part that was never handed out.
+ * Chunks need no declaration. Must be called before the first allocation.
+ * @param heap The heap to mark
+ */
+void vs_set_zeroed(vs_heap_t* heap)
+{
+    if (heap->size)
+        heap->fresh = FREE_PREFIX_SIZE; // Past the first block's header, links and idle time
+}
+
+/**
+ * Allocates zeroed memory for count elements of the given size.
+ * Only the part of the block that may hold old data is cleared (see touch_tail): a block carved from
+ * the untouched end of a region mostly is zero already, and so is a large object in a new mapping.
+ * @param heap The heap to allocate from
+ * @param count The number of elements
+ * @param size The size of each element
+ * @return A pointer to the zeroed memory, or NULL on failure.
+ */
+void* vs_calloc(vs_heap_t* heap, size_t count, size_t size)
+{
+    if (size && count > SIZE_MAX / size)
+    {
+        RON_ERROR(RON_ENOMEM, NULL);
+        STAT_ADD(STAT_VS_OOM, 1);
+        return NULL;
+    }
+    size_t total = count * size;
+
+    size_t cached = heap->large_cached;
+    heap->fresh_start = NULL;
+    char* ptr = vs_malloc(heap, total);
+    if (!ptr)
+        return NULL;
+
+    if (heap->large_threshold && total >= heap->large_threshold)
+    {
+        if (heap->large_cached < cached) // A reused mapping - New ones are zeroed by the OS
+            ron_zero(ptr, total);
+        return ptr;
+    }
+
+    // Only the old data below the mark, and a free last block's footer, need clearing
+    size_t dirty = total;
+    if (heap->fresh_start)
+    {
+        dirty = heap->fresh_start > ptr ? (size_t)(heap->fresh_start - ptr) : 0;
+        if (dirty > total)
+            dirty = total;
+
+        MemBlock* block = block_from_ptr(ptr);
+        size_t footer = block_size(block) - sizeof(size_t);
+        if (!block_size(block_next(block)) && footer < total && footer >= dirty)
+            ron_zero(ptr + footer, total - footer);
+    }
+    ron_zero(ptr, dirty);
+    return ptr;
+}
+
+/**
+ * Frees an allocated block of memory.
+ *
+ * @param heap The heap the block was allocated from
+ * @param ptr A pointer to the memory that should be freed
+ */
+void vs_free(vs_heap_t* heap, void* ptr)
+{
+    if (large_contains(heap, ptr))
+    {
+        large_free(heap, ptr);
+        STAT_ADD(STAT_VS_FREE, 1);
+        PROF_FREE(ptr);
+        return;
+    }
+
+    // The payload must be within pool bounds and aligned like every payload the allocator returns
+    if (!vs_owns(heap, ptr))
+    {
+        RON_ERROR(RON_EINVAL, ptr);
+        STAT_ADD(STAT_VS_INVALID_FREE, 1);
+        return;
+    }
+
+    // Rewind pointer to access header that precedes the payload
+    MemBlock* block = block_from_ptr(ptr);
+
+    // The block must be marked used - Most likely a double free
+    if (!block_is_used(block))
+    {
+        RON_ERROR(RON_EDOUBLEFREE, ptr);
+        STAT_ADD(STAT_VS_INVALID_FREE, 1);
+        return;
+    }
+
+    // Deferred coalescing - Small blocks wait on their quick-list, still marked used
+    int bin = heap->quick_limit ? quick_bin(block_size(block)) : -1;
+    if (bin >= 0)
+    {
+        // Only blocks carrying the tag can be on a quick-list, so the walk is rare
+        if (block->prev_free == QUICK_TAG(heap) && quick_contains(heap, bin, block))
+        {
+            RON_ERROR(RON_EDOUBLEFREE, ptr);
+            STAT_ADD(STAT_VS_INVALID_FREE, 1);
+            return;
+        }
+
+        block->next_free = heap->quick_bins[bin];
+        block->prev_free = QUICK_TAG(heap);
+        heap->quick_bins[bin] = block;
+        heap->quick_bitmap |= 1U << bin;
+        STAT_ADD(STAT_VS_FREE, 1);
+        PROF_FREE(ptr);
+        if (++heap->quick_counts[bin] > heap->quick_limit)
+            consolidate_bin(heap, bin);
+        return;
+    }
+
+    free_block(heap, block);
+    STAT_ADD(STAT_VS_FREE, 1);
+    PROF_FREE(ptr);
+}
+
+/**
+ * Frees a block whose size the caller knows.
+ *
+ * A block of the caller's region skips the large-object lookup, the chunk search and the double-free
+ * checks of vs_free, and with quick-lists enabled, the size picks the quick-list without reading the
+ * header at all. A block may be slightly larger than its request, so it can land on the list of a
+ * smaller size, which only hands it out for that size. Chunk blocks and large objects take the vs_free path.
+ * Built with RON_HARDENED, the size is verified against the block and the call reports misuse like vs_free:
+ * a heap block must be the one a request of that size splits off, and a large object must hold the size
+ * (an in-place shrinking realloc keeps the whole mapping, so smaller sizes are legitimate there).
+ * @param heap The heap the block was allocated from
+ * @param ptr A pointer to the memory that should be freed
+ * @param size The size the memory was allocated (or last reallocated) with
+ */
+void vs_free_sized(vs_heap_t* heap, void* ptr, size_t size)
+{
+#ifdef RON_HARDENED
+    // A block keeps at most a remainder too small to split off, so a smaller size names another block
+    size_t usable = vs_usable_size(heap, ptr);
+    if (usable && (size > usable
+                   || (!large_contains(heap, ptr) && usable - align_size(size) >= BLOCK_HEADER_SIZE + MIN_BLOCK_SIZE)))
+    {
+        RON_ERROR(RON_ESIZE, ptr);
+        STAT_ADD(STAT_VS_INVALID_FREE, 1);
+        return;
+    }
+    vs_free(heap, ptr);
+#else
+    if (!heap->size || !region_owns(heap->memory, heap->size, ptr))
+    {
+        vs_free(heap, ptr);
+        return;
+    }
+
+    MemBlock* block = block_from_ptr(ptr);
+    int bin = heap->quick_limit && size <= VS_QUICK_MAX_SIZE ? quick_bin(align_size(size)) : -1;
+    if (bin >= 0)
+    {
+        block->next_free = heap->quick_bins[bin];
+        block->prev_free = QUICK_TAG(heap);
+        heap->quick_bins[bin] = block;
+        heap->quick_bitmap |= 1U << bin;
+        STAT_ADD(STAT_VS_FREE, 1);
+        PROF_FREE(ptr);
+        if (++heap->quick_counts[bin] > heap->quick_limit)
+            consolidate_bin(heap, bin);
+        return;
+    }
+
+    free_block(heap, block);
+    STAT_ADD(STAT_VS_FREE, 1);
+    PROF_FREE(ptr);
+#endif
+}
+
+/**
+ * Allocates several blocks of the same size in one call.
+ * Consecutive blocks are carved from the front of each free block found, so a batch usually
+ * costs one index search and one remainder insertion instead of one of each per block.
+ * @param heap The heap to allocate from
+ * @param size The size of each block to allocate
+ * @param count The number of blocks to allocate
+ * @param out Receives the allocated blocks. Must hold count pointers.
+ * @return The number of blocks allocated, fewer than count if the heap runs out.
+ */
+size_t vs_malloc_batch(vs_heap_t* heap, size_t size, size_t count, void** out)
+{
+    // Large objects have a mapping each, so there is nothing to share
+    if (heap->large_threshold && size >= heap->large_threshold)
+    {
+        size_t taken = 0;
+        while (taken < count && (out[taken] = vs_malloc(heap, size)))
+            taken++;
+        return taken;
+    }
+
+    if (size > MAX_BLOCK_SIZE)
+    {
+        RON_ERROR(RON_ENOMEM, NULL);
+        STAT_ADD(STAT_VS_OOM, 1);
+        return 0;
+    }
+    size = align_size(size);
+
+    size_t taken = 0;
+    MemBlock* queued;
+    while (taken < count && heap->quick_bitmap && (queued = quick_pop(heap, size)))
+    {
+        out[taken++] = block_to_ptr(queued);
+    }
+
+    while (taken < count)
+    {
+        MemBlock* block = find_free_block(heap, size);
+        if (!block)
+        {
+            RON_ERROR(RON_ENOMEM, NULL);
+            STAT_ADD(STAT_VS_OOM, 1);
+            break;
+        }
+        remove_free_block(heap, block);
+
+        // Carve blocks off the front while the rest still fits one more; only the last remainder is split off
+        while (1)
+        {
+            block_mark_used(block);
+            out[taken++] = block_to_ptr(block);
+            if (taken == count || block_size(block) < 2 * size + BLOCK_HEADER_SIZE)
+                break;
+
+            MemBlock* rest = (MemBlock*)((char*)block_to_ptr(block) + size);
+            rest->header = (block_size(block) - size - BLOCK_HEADER_SIZE) | BLOCK_PREV_USED;
+            block_set_size(block, size);
+            block = rest;
+            STAT_ADD(STAT_VS_SPLIT, 1);
+        }
+        split_block(heap, block, size);
+    }
+
+    STAT_ADD(STAT_VS_MALLOC, taken);
+#ifdef RON_PROFILE
+    for (size_t i = 0; i < taken; i++)
+        prof_malloc(out[i], size);
+#endif
+    return taken;
+}
+
+/**
+ * Frees several allocated blocks in one call.
+ * Each block is validated and coalesced like in vs_free. Invalid pointers are reported and skipped.
+ * @param heap The heap the blocks were allocated from
+ * @param ptrs The blocks to free
+ * @param count The number of pointers in ptrs
+ */
+void vs_free_batch(vs_heap_t* heap, void** ptrs, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        vs_free(heap, ptrs[i]);
+    }
+}
+
+/**
+ * Reallocates a block whose payload is aligned to a power of two, keeping that alignment.
+ * The allocator tries, in order:
+ * - Shrinking or expanding in place into a free next block
+ * - Growing the last block of a mapped chunk by remapping the chunk (no copy, see remap_chunk)
+ * - Expanding backwards into a free previous block (and a free next block), sliding the data with memmove
+ * - Allocating a new block, copying the data with memcpy and freeing the old block
+ * A step that would leave the payload misaligned is skipped, so the block grows in place whenever vs_realloc
+ * would, and only moves through vs_memalign.
+ *
+ * @param heap The heap the block was allocated from
+ * @param ptr A pointer to the memory that will be reallocated. Must be aligned to the alignment.
+ * @param alignment The payload alignment. Must be a power of two.
+ * @param new_size The new size of the allocated memory.
+ * @return A pointer to the usable reallocated memory. NULL, with the block left as it was, if it can't be
+ * resized or if ptr is not a used block of the heap.
+ */
+void* vs_realloc_aligned(vs_heap_t* heap, void* ptr, size_t alignment, size_t new_size)
+{
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+    {
+        RON_ERROR(RON_EALIGN, NULL);
+        return NULL;
+    }
+
+    // Pointer validation
+    if (!ptr)
+    {
+        return vs_memalign(heap, alignment, new_size);
+    }
+    if (new_size == 0)
+    {
+        vs_free(heap, ptr); // POSIX behavior
+        return NULL;
+    }
+
+    // Large objects stay in their mapping while they are large enough
+    int to_large = heap->large_threshold && new_size >= heap->large_threshold;
+    if (large_contains(heap, ptr))
+    {
+        size_t usable = ((VsLarge*)((char*)ptr - LARGE_HEADER_SIZE))->map_size - LARGE_HEADER_SIZE;
+        // Mappings keep the payload aligned up to the large-object header size
+        void* new_ptr = alignment <= LARGE_HEADER_SIZE && (to_large || new_size > MAX_BLOCK_SIZE)
+                            ? large_realloc(heap, ptr, new_size) : vs_memalign(heap, alignment, new_size);
+        if (!new_ptr)
+        {
+            RON_ERROR(RON_ENOMEM, NULL);
+            STAT_ADD(STAT_VS_OOM, 1);
+        }
+        else if (new_ptr != ptr && large_contains(heap, ptr)) // Left the large-object path
+        {
+            memcpy(new_ptr, ptr, usable < new_size ? usable : new_size);
+            large_free(heap, ptr);
+            STAT_ADD(STAT_VS_REALLOC_COPY, 1);
+        }
+        PROF_REALLOC(ptr, new_ptr, new_size); // A sample keeps its stack when the object moves or grows
+        return new_ptr;
+    }
+
+    // The block must be a used block of the heap, as vs_free checks: resizing a free one corrupts the free index
+    if (!vs_owns(heap, ptr) || !block_is_used(block_from_ptr(ptr)) || quick_queued(heap, block_from_ptr(ptr)))
+    {
+        RON_ERROR(RON_EINVAL, ptr);
+        return NULL;
+    }
+
+    if (new_size > MAX_BLOCK_SIZE && !to_large)
+    {
+        RON_ERROR(RON_ENOMEM, NULL);
+        STAT_ADD(STAT_VS_OOM, 1);
+        return NULL;
+    }
+    new_size = align_size(new_size);
+
+    // Rewind pointer to access header that precedes the payload
+    MemBlock* block = block_from_ptr(ptr);
+    size_t size = block_size(block);
+
+    // Shrink in place
+    if (new_size <= size)
+    {
+        // A remainder block is created only if its large enough to be useful
+        split_block(heap, block, new_size);
+        STAT_ADD(STAT_VS_REALLOC_IN_PLACE, 1);
+        PROF_REALLOC(ptr, ptr, new_size);
+        return ptr;
+    }
+
+    // Grown past the threshold - Move to a mapping of its own
+    if (to_large)
+    {
+        void* new_ptr = vs_memalign(heap, alignment, new_size);
+        if (new_ptr)
+        {
+            memcpy(new_ptr, ptr, size);
+            vs_free(heap, ptr);
+            STAT_ADD(STAT_VS_REALLOC_COPY, 1);
+        }
+        return new_ptr;
+    }
+
+    // Expand - Try in-place if the next block is free and large enough
+    MemBlock* next = block_next(block);
+    if (!block_is_used(next) && size + BLOCK_HEADER_SIZE + block_size(next) >= new_size)
+    {
+        // Expand to create 1 big block
+        merge_next(heap, block);
+        block_next(block)->header |= BLOCK_PREV_USED;
+
+        // Split off remaining excess space as a new free block
+        split_block(heap, block, new_size);
+
+        STAT_ADD(STAT_VS_REALLOC_IN_PLACE, 1);
+        PROF_REALLOC(ptr, ptr, new_size);
+        return ptr;
+    }
+
+    // Expand - The last block of a chunk grows with its chunk, without a copy. A moved chunk keeps its
+    // blocks at the same offsets from a page boundary.
+    MemBlock* grown = heap->chunk_size && alignment <= page_size() ? remap_chunk(heap, block, new_size) : NULL;
+    if (grown)
+    {
+        split_block(heap, grown, new_size);
+        STAT_ADD(STAT_VS_REALLOC_REMAP, 1);
+        PROF_REALLOC(ptr, block_to_ptr(grown), new_size);
+        return block_to_ptr(grown);
+    }
+
+    // Expand backwards - Absorb a free previous block (and a free next block), then slide the data down.
+    // This moves the data once, like the fallback, but needs no search and works in a full heap.
+    if (!block_is_prev_used(block))
+    {
+        MemBlock* prev = block_prev(block);
+        size_t available = block_size(prev) + BLOCK_HEADER_SIZE + size;
+        if (!block_is_used(next))
+            available += BLOCK_HEADER_SIZE + block_size(next);
+
+        if (available >= new_size && ((uintptr_t)block_to_ptr(prev) & (alignment - 1)) == 0)
+        {
+            if (!block_is_used(next))
+                merge_next(heap, block);
+            remove_free_block(heap, prev);
+            block_set_size(prev, available);
+            forget_block(heap, block, prev);
+            memmove(block_to_ptr(prev), ptr, size);
+            block_mark_used(prev);
+            split_block(heap, prev, new_size);
+
+            STAT_ADD(STAT_VS_REALLOC_BACKWARD, 1);
+            PROF_REALLOC(ptr, block_to_ptr(prev), new_size);
+            return block_to_ptr(prev);
+        }
+    }
+
+    // Fallback - Copy data and free old block
+    void* new_ptr = vs_memalign(heap, alignment, new_size);
+    if (new_ptr)
+    {
+        memcpy(new_ptr, ptr, size); // Copy the data
+        vs_free(heap, ptr); // Free the old block
+        STAT_ADD(STAT_VS_REALLOC_COPY, 1);
+    }
+
+    return new_ptr;
+}
 
 /**
- * Memory pool - Aligned to 8 bytes.
- * The pool is initialized by vs_init_allocator.
- *
- * 8-byte alignment ensures compatibility with all data types:
- * - Satisfies alignment requirements for 64-bit pointers and doubles
- * - Prevents crashes on strict-alignment architectures (ARM, SPARC)
- * - Avoids performance penalties on x86/x64 from misaligned access
+ * Reallocates an allocated block of memory to a new size (see vs_realloc_aligned for the steps tried).
  *
- * Uses 'char' type (exactly 1 byte) to enable byte-level pointer arithmetic.
+ * @param heap The heap the block was allocated from
+ * @param ptr A pointer to the memory that will be reallocated.
+ * @param new_size The new size of the allocated memory.
+ * @return A pointer to the usable reallocated memory. NULL, with the block left as it was, if it can't be
+ * resized or if ptr is not a used block of the heap.
  */
-static char memory_pool[POOL_SIZE] __attribute__((aligned(8)));
+void* vs_realloc(vs_heap_t* heap, void* ptr, size_t new_size)
+{
+    return vs_realloc_aligned(heap, ptr, ALIGN_SIZE, new_size);
+}
 
 /**
- * Represents a memory block within the allocator.
+ * Movable blocks and compaction.
  *
- * Each block is doubly linked to other blocks.
- * This structure allows efficient allocation, deallocation, and block coalescing.
+ * Neighbour coalescing cannot merge free blocks separated by a live one, so a long-running heap can end
+ * up as a checkerboard of small free blocks. Blocks allocated with vs_halloc are reached through a
+ * handle instead of a pointer, which lets vs_compact move them:
  *
- * Fields:
- * - `size`: The size of the memory block in bytes.
- * - `used`: Indicates whether the block is in use (1 for used, 0 for free).
- * - `prev`: A pointer to the previous memory block in the linked list.
- * - `next`: A pointer to the next memory block in the linked list.
+ * - The handle indexes a table entry holding the block and a pin count. vs_hlock pins the block and
+ *   returns its current address, vs_hunlock unpins it. Only unpinned blocks move.
+ * - The first payload word of a handle block holds HANDLE_TAG(heap) plus its index, so the compactor
+ *   recognizes movable blocks while walking the region: a tag is trusted only if the entry it names
+ *   points back at the block. The client gets the payload after that word.
+ * - vs_compact walks the caller's region from a cursor kept across calls. When a free block is
+ *   followed by an unpinned handle block, the block slides down into the gap and the gap moves
+ *   behind it, merging with the next free block. Other used blocks are stepped over.
+ *   Each call stops after about `budget` bytes of moving and walking, so compaction runs in bounded
+ *   time slices. Merges update the cursor (see forget_block), so it always sits on a block start.
+ *
+ * Chunks and large objects are not compacted: their handle blocks simply never move.
  */
-typedef struct MemBlock
-{
-    size_t size;
-    int used;
-    struct MemBlock* prev;
-    struct MemBlock* next;
-} MemBlock;
 
 /**
- * Head to a doubly linked list of memory blocks
+ * Returns the entry of a handle, or NULL if the handle is not live.
  */
-MemBlock* head = NULL; // Head of memory block list
+static VsHandle* handle_entry(const vs_heap_t* heap, vs_handle_t handle)
+{
+    if (handle == 0 || handle > heap->handle_capacity || !heap->handles[handle - 1].block)
+        return NULL;
+    return &heap->handles[handle - 1];
+}
 
 /**
- * Initializes the variable size allocator.
- *
- * One free memory block is created that spans across the memory pool.
+ * Returns the handle of a movable block, or 0 if the block is not one.
  */
-void vs_init_allocator()
+static vs_handle_t block_handle(const vs_heap_t* heap, const MemBlock* block)
 {
-    printf("Initializing Allocator\n");
-    // Initialize the pool as one big free block
-    head = (MemBlock*)memory_pool;
-    head->size = POOL_SIZE;
-    head->used = 0;
-    head->prev = NULL;
-    head->next = NULL;
+    if (block_size(block) < HANDLE_PREFIX_SIZE)
+        return 0;
+    uintptr_t index = *(const uintptr_t*)block_to_ptr(block) - HANDLE_TAG(heap);
+    if (index >= heap->handle_capacity || heap->handles[index].block != block)
+        return 0;
+    return (vs_handle_t)index + 1;
 }
 
 /**
- * Allocates a block of memory.
- *
- * @param size The size of the memory to allocate. A 'best-fit' allocation strategy is used.
- * @return A pointer to the allocated usable memory.
+ * Takes a free entry of the handle table, doubling the table when it is full.
+ * @return The entry's index, or -1 if a larger table could not be mapped.
  */
-void* vs_malloc(size_t size)
+static long take_handle(vs_heap_t* heap)
 {
-    // Best-fit search: Finds the smallest free block that can satisfy the size.
-    // Minimizes wasted space and reduces external fragmentation.
-    MemBlock* curr = head;
-    MemBlock* best = NULL;
-    while (curr)
+    if (!heap->free_handle)
     {
-        // The block must be free, large enough and smaller than the current best
-        if ((!curr->used) && (!best || (curr->size < best->size) && (curr->size >= size)))
+        size_t capacity = heap->handle_capacity ? 2 * heap->handle_capacity : HANDLE_TABLE_MIN_CAPACITY;
+        VsHandle* handles = map_pages(capacity * sizeof(VsHandle));
+        if (!handles)
+            return -1;
+        if (heap->handles)
+        {
+            memcpy(handles, heap->handles, heap->handle_capacity * sizeof(VsHandle));
+            unmap_pages(heap->handles, heap->handle_capacity * sizeof(VsHandle));
+        }
+
+        // Chain the new entries, lowest first
+        for (size_t i = heap->handle_capacity; i < capacity; i++)
         {
-            best = curr;
+            handles[i].pins = i + 1 < capacity ? i + 2 : 0;
         }
-        curr = curr->next;
+        heap->free_handle = heap->handle_capacity + 1;
+        heap->handles = handles;
+        heap->handle_capacity = capacity;
     }
 
-    // No suitable block found, or allocation would exceed pool bounds
-    if (!best || (char*)best + sizeof(MemBlock) + size > memory_pool + POOL_SIZE)
+    long index = (long)heap->free_handle - 1;
+    heap->free_handle = heap->handles[index].pins;
+    return index;
+}
+
+/**
+ * Allocates a movable block.
+ * @param heap The heap to allocate from
+ * @param size The size of the memory to allocate
+ * @return The block's handle, or 0 if the heap is out of memory.
+ */
+vs_handle_t vs_halloc(vs_heap_t* heap, size_t size)
+{
+    if (size > SIZE_MAX - HANDLE_PREFIX_SIZE)
     {
-        printf("Out of memory\n");
-        return NULL;
+        RON_ERROR(RON_ENOMEM, NULL);
+        STAT_ADD(STAT_VS_OOM, 1);
+        return 0;
     }
 
-    // Split block if the block can fit the payload and block header
-    if (best->size >= size + sizeof(MemBlock))
+    long index = take_handle(heap);
+    if (index < 0)
     {
-        // Split - Allocate the requested size and create a free block from the remainder
-        MemBlock* next = best->next; // Preserve the next block before splitting
-        best->next = (MemBlock*)((char*)best + sizeof(MemBlock) + size);
-
-        // Update the next block
-        best->next->used = 0;
-        best->next->size = best->size - size - sizeof(MemBlock);
-        best->next->prev = best;
-        best->next->next = next;
+        RON_ERROR(RON_ENOMEM, NULL);
+        return 0;
+    }
+    uintptr_t* payload = vs_malloc(heap, size + HANDLE_PREFIX_SIZE);
+    if (!payload)
+    {
+        heap->handles[index].pins = heap->free_handle; // Give the entry back
+        heap->free_handle = (size_t)index + 1;
+        return 0;
     }
 
-    best->used = 1; // Mark the block as used
-    best->size = size; // Update the size
+    *payload = HANDLE_TAG(heap) + (uintptr_t)index;
+    heap->handles[index].block = block_from_ptr(payload);
+    heap->handles[index].pins = 0;
 
-    return (char*)best + sizeof(MemBlock);
+    return (vs_handle_t)index + 1;
 }
 
 /**
- * Frees an allocated block of memory.
- *
- * @param ptr A pointer to the memory that should be freed
+ * Pins a movable block and returns its address, which stays valid until the matching vs_hunlock.
+ * Pins nest: the block may move again once every vs_hlock has been matched.
+ * @param heap The heap the block was allocated from
+ * @param handle The block's handle
+ * @return A pointer to the usable memory, or NULL for an invalid handle.
  */
-void vs_free(void* ptr)
+void* vs_hlock(vs_heap_t* heap, vs_handle_t handle)
 {
-    if (!ptr)
+    VsHandle* entry = handle_entry(heap, handle);
+    if (!entry)
+    {
+        RON_ERROR(RON_EINVAL, NULL);
+        return NULL;
+    }
+
+    entry->pins++;
+    return (char*)block_to_ptr(entry->block) + HANDLE_PREFIX_SIZE;
+}
+
+/**
+ * Releases a pin taken by vs_hlock. Pointers returned while the block was pinned must not be used anymore.
+ * @param heap The heap the block was allocated from
+ * @param handle The block's handle
+ */
+void vs_hunlock(vs_heap_t* heap, vs_handle_t handle)
+{
+    VsHandle* entry = handle_entry(heap, handle);
+    if (!entry || !entry->pins)
     {
-        printf("Invalid pointer\n");
+        RON_ERROR(RON_EINVAL, NULL);
         return;
     }
 
-    // Rewind pointer to access header that precedes the payload
-    MemBlock* block = (MemBlock*)((char*)ptr - sizeof(MemBlock));
+    entry->pins--;
+}
 
-    // The block must exist, be marked used, and be within pool bounds
-    if (!block || !block->used || block < head || (char*)block > memory_pool + POOL_SIZE)
+/**
+ * Frees a movable block, pinned or not. The handle becomes invalid.
+ * @param heap The heap the block was allocated from
+ * @param handle The block's handle
+ */
+void vs_hfree(vs_heap_t* heap, vs_handle_t handle)
+{
+    VsHandle* entry = handle_entry(heap, handle);
+    if (!entry)
     {
-        printf("Invalid pointer\n");
+        RON_ERROR(RON_EINVAL, NULL);
         return;
     }
 
-    block->used = 0; // Mark the block as free
+    *(uintptr_t*)block_to_ptr(entry->block) = 0; // A stale tag must not outlive the handle
+    vs_free(heap, block_to_ptr(entry->block));
+    entry->block = NULL;
+    entry->pins = heap->free_handle;
+    heap->free_handle = handle;
+}
+
+/**
+ * Slides an unpinned handle block down into the free block before it. The gap moves behind the
+ * block and merges with a free successor.
+ * @param free The free block
+ * @param handle The handle of the block right after it
+ * @return The free block left behind the moved block.
+ */
+static MemBlock* slide_down(vs_heap_t* heap, MemBlock* free, vs_handle_t handle)
+{
+    MemBlock* block = block_next(free);
+    MemBlock* after = block_next(block);
+    size_t size = block_size(block);
+    size_t gap = block_size(free);
+
+    remove_free_block(heap, free);
+    if (!block_is_used(after))
+    {
+        remove_free_block(heap, after);
+        gap += BLOCK_HEADER_SIZE + block_size(after);
+    }
+
+    // The free block's predecessor is used (free blocks are never adjacent), so its flags stay valid
+    memmove(block_to_ptr(free), block_to_ptr(block), size);
+    free->header = size | BLOCK_USED | (free->header & (BLOCK_PREV_USED | BLOCK_FIRST));
+    heap->handles[handle - 1].block = free;
+    PROF_REALLOC(block_to_ptr(block), block_to_ptr(free), size);
 
-    // Coalescing - Merge with adjacent free blocks to reduce fragmentation.
-    // The next block is merged first, then the previous to maintain pointers.
+    MemBlock* rest = block_next(free);
+    rest->header = gap | BLOCK_PREV_USED;
+    block_mark_free(rest);
+    insert_free_block(heap, rest);
+    STAT_ADD(STAT_VS_COMPACT_MOVE, 1);
 
-    // Merge with the NEXT block
-    if (block->next && !block->next->used)
+    return rest;
+}
+
+/**
+ * Runs one slice of incremental compaction over the caller's region (see above).
+ * Only unpinned blocks allocated with vs_halloc move. Quick-lists are consolidated first.
+ * @param heap The heap to compact
+ * @param budget Roughly how many bytes to move and walk over before returning. At least one block
+ *               is moved or stepped over per call.
+ * @return 1 if the pass reached the end of the region (the next call starts a new pass). 0 Otherwise.
+ */
+int vs_compact(vs_heap_t* heap, size_t budget)
+{
+    if (!heap->size)
+        return 1;
+    consolidate(heap);
+
+    MemBlock* curr = heap->compact_cursor ? heap->compact_cursor : (MemBlock*)heap->memory;
+    size_t spent = 0;
+    while (block_size(curr)) // Until the sentinel
     {
+        if (spent && spent >= budget)
+        {
+            heap->compact_cursor = curr;
+            return 0;
+        }
+
+        spent += BLOCK_HEADER_SIZE;
+        if (block_is_used(curr))
+        {
+            curr = block_next(curr);
+            continue;
+        }
 
-        block->size += block->next->size + sizeof(MemBlock);
-        block->next = block->next->next;
-        if (block->next)
-            block->next->prev = block;
+        MemBlock* next = block_next(curr);
+        vs_handle_t handle = block_size(next) ? block_handle(heap, next) : 0;
+        if (handle && !heap->handles[handle - 1].pins)
+        {
+            spent += block_size(next);
+            curr = slide_down(heap, curr, handle);
+        }
+        else
+            curr = next; // Immovable - Step over it
     }
 
-    // Merge with the PREVIOUS block (Current block is absorbed)
-    if (block->prev && !block->prev->used)
+    heap->compact_cursor = NULL;
+    return 1;
+}
+
+/**
+ * Checks whether a pointer is a plausible payload of the heap, without reading its header.
+ * Mapped chunks are searched linearly. They are few, since each one is at least the chunk size.
+ * @param heap The heap to check against
+ * @param ptr The pointer to check
+ * @return 1 if the pointer is non-NULL, within the heap's region or one of its chunks, and payload-aligned.
+ *         0 Otherwise.
+ */
+int vs_owns(const vs_heap_t* heap, const void* ptr)
+{
+    if (!ptr)
+        return 0;
+    if (heap->size && region_owns(heap->memory, heap->size, ptr))
+        return 1;
+    if (large_contains(heap, ptr))
+        return 1;
+
+    for (const VsChunk* chunk = heap->chunks; chunk; chunk = chunk->next)
     {
-        block->prev->size += block->size + sizeof(MemBlock);
-        block->prev->next = block->next;
-        if (block->next)
-            block->next->prev = block->prev;
+        if (region_owns((const char*)chunk_first_block(chunk), chunk->size - CHUNK_HEADER_SIZE, ptr))
+            return 1;
     }
+
+    return 0;
 }
 
 /**
- * Reallocates an allocated block of memory to a new size.
- * The allocator tries to shrink/expand the memory in-place to save time.
- * If it can't, it copies the data using memcpy and frees the old block.
+ * Returns the usable payload size of an allocated block, which may exceed the requested size.
+ * @param heap The heap the block was allocated from
+ * @param ptr A pointer returned by vs_malloc or vs_realloc
+ * @return The payload size in bytes, or 0 for an invalid pointer or a block that is not in use.
  *
- * @param ptr A pointer to the memory that will be reallocated.
- * @param new_size The new size of the allocated memory.
- * @return A pointer to the usable reallocated memory.
+ * A pointer into the caller's region is classified from its header alone, without reading the chunk list or
+ * the large-object table. Like every other call, it needs the heap's synchronization: frees of the neighbouring
+ * blocks write the header it reads.
  */
-void* vs_realloc(void* ptr, size_t new_size)
+size_t vs_usable_size(const vs_heap_t* heap, const void* ptr)
 {
-    // Pointer validation
-    if (!ptr)
+    if (heap->size && region_owns(heap->memory, heap->size, ptr))
+        return block_is_used(block_from_ptr(ptr)) ? block_size(block_from_ptr(ptr)) : 0;
+    if (large_contains(heap, ptr))
+        return ((const VsLarge*)((const char*)ptr - LARGE_HEADER_SIZE))->map_size - LARGE_HEADER_SIZE;
+    if (!vs_owns(heap, ptr) || !block_is_used(block_from_ptr(ptr)))
+        return 0;
+    return block_size(block_from_ptr(ptr));
+}
+
+/**
+ * Returns the memory the heap manages: the caller's region plus every chunk and large object it has mapped
+ * (cached mappings included).
+ * @param heap The heap to measure
+ * @return The footprint in bytes
+ */
+size_t vs_footprint(const vs_heap_t* heap)
+{
+    size_t footprint = heap->size;
+    for (const VsChunk* chunk = heap->chunks; chunk; chunk = chunk->next)
     {
-        return vs_malloc(new_size);
+        footprint += chunk->size;
     }
-    if (new_size <= 0)
+    for (size_t i = 0; i < heap->large_capacity; i++)
     {
-        vs_free(ptr); // POSIX behavior
-        return NULL;
+        if (heap->large_table[i])
+            footprint += ((const VsLarge*)(heap->large_table[i] - LARGE_HEADER_SIZE))->map_size;
     }
+    for (size_t i = 0; i < heap->large_cached; i++)
+    {
+        footprint += ((const VsLarge*)heap->large_cache[i])->map_size;
+    }
+    return footprint;
+}
 
-    // Rewind pointer to access header that precedes the payload
-    MemBlock* block = (MemBlock*)(ptr - (void*)sizeof(MemBlock));
+/**
+ * Takes a snapshot of the allocator counters and of the heap's free index.
+ *
+ * The counters are summed over all threads and cover every heap of the process, since each thread
+ * accumulates its own (see stats_allocatoron.c). They stay 0 unless the library is built with RON_STATS.
+ * The free-list figures describe this heap only and are computed by walking its free index.
+ *
+ * @param heap The heap to inspect
+ * @param stats Receives the snapshot
+ */
+void vs_get_stats(const vs_heap_t* heap, vs_stats_t* stats)
+{
+    uint64_t totals[STAT_COUNT];
+    stats_collect(totals);
 
-    // Shrink in place
-    if (new_size < block->size)
+    stats->mallocs = totals[STAT_VS_MALLOC];
+    stats->frees = totals[STAT_VS_FREE];
+    stats->searches = totals[STAT_VS_SEARCH];
+    stats->blocks_examined = totals[STAT_VS_BLOCKS_EXAMINED];
+    stats->splits = totals[STAT_VS_SPLIT];
+    stats->coalesces = totals[STAT_VS_COALESCE];
+    stats->realloc_in_place = totals[STAT_VS_REALLOC_IN_PLACE];
+    stats->realloc_copies = totals[STAT_VS_REALLOC_COPY];
+    stats->realloc_backward = totals[STAT_VS_REALLOC_BACKWARD];
+    stats->realloc_remapped = totals[STAT_VS_REALLOC_REMAP];
+    stats->large_mapped = totals[STAT_VS_LARGE_MAP];
+    stats->large_cache_hits = totals[STAT_VS_LARGE_CACHE_HIT];
+    stats->compact_moves = totals[STAT_VS_COMPACT_MOVE];
+    stats->oom = totals[STAT_VS_OOM];
+    stats->invalid_frees = totals[STAT_VS_INVALID_FREE];
+    stats->remote_frees = totals[STAT_VS_REMOTE_FREE];
+    stats->quick_hits = totals[STAT_VS_QUICK_HIT];
+    stats->consolidations = totals[STAT_VS_CONSOLIDATE];
+    stats->chunks_mapped = totals[STAT_VS_CHUNK_MAP];
+    stats->chunks_unmapped = totals[STAT_VS_CHUNK_UNMAP];
+    stats->purged_bytes = totals[STAT_VS_PURGED_BYTES];
+
+    stats->free_blocks = 0;
+    stats->free_bytes = 0;
+    stats->largest_free_block = 0;
+    stats->purged_free_bytes = 0;
+    stats->quick_blocks = 0;
+    stats->large_objects = heap->large_count;
+    stats->large_cached = heap->large_cached;
+    for (int bin = 0; bin < VS_QUICK_BIN_COUNT; bin++)
     {
-        // A remainder block is created only if its large enough to be useful
-        if (block->size - new_size >= sizeof(MemBlock))
+        stats->quick_blocks += heap->quick_counts[bin];
+    }
+    for (int fl = 0; fl < FL_INDEX_COUNT; fl++)
+    {
+        if (!(heap->fl_bitmap & (1U << fl)))
+            continue;
+        for (int sl = 0; sl < SL_INDEX_COUNT; sl++)
         {
-            // Split off remaining excess space as a new free block
-            MemBlock* rem = (MemBlock*)((char*)block + sizeof(MemBlock) + new_size);
-            rem->size = block->size - new_size - sizeof(MemBlock);
-            rem->used = 0;
-            rem->prev = block;
-            rem->next = block->next;
-            if (rem->next)
-                rem->next->prev = rem;
-            block->next = rem;
+            for (const MemBlock* block = heap->free_blocks[fl][sl]; block; block = block->next_free)
+            {
+                stats->free_blocks++;
+                stats->free_bytes += block_size(block);
+                if (block_size(block) > stats->largest_free_block)
+                    stats->largest_free_block = block_size(block);
+                if (heap->purge_decay && block_size(block) >= heap->purge_min_size
+                    && (*block_idle(block) & IDLE_PURGED))
+                    stats->purged_free_bytes += block_size(block);
+            }
         }
-        block->size = new_size;
-        return ptr;
     }
 
-    // Expand - Try in-place if the next block is free and large enough
-    if (block->next && !block->next->used &&
-        block->size + block->next->size + sizeof(MemBlock) >= new_size)
-    {
-        // Expand to create 1 big block
-        size_t excess = block->next->size + sizeof(MemBlock);
-        block->size += excess;
-        block->next = block->next->next;
-        if (block->next)
-            block->next->prev = block;
-
-        // Split off remaining excess space as a new free block
-        MemBlock* rem = (MemBlock*)((char*)block + sizeof(MemBlock) + new_size);
-        rem->size = block->size - new_size - sizeof(MemBlock);
-        rem->used = 0;
-        rem->prev = block;
-        rem->next = block->next;
-        if (rem->next)
-            rem->next->prev = rem;
-        block->next = rem;
-
-        // Update the block to the requested size
-        block->size = new_size;
-        block->used = 1;
-
-        return ptr;
-    }
+    // The share of free memory unusable by a request as large as all of it
+    stats->fragmentation = stats->free_bytes
+        ? 1.0 - (double)stats->largest_free_block / (double)stats->free_bytes : 0.0;
+}
 
-    // Fallback - Copy data and free old block
-    void* new_ptr = vs_malloc(new_size);
-    if (new_ptr)
+/**
+ * Prints the blocks of a region, from its first block up to its sentinel.
+ */
+static void dump_blocks(const MemBlock* curr)
+{
+    while (block_size(curr)) // The zero-sized sentinel ends the region
     {
-        memcpy(new_ptr, ptr, block->size); // Copy the data
-        vs_free(ptr); // Free the old block
+        printf("\tBlock at %p, size %zu, used %d\n", (void*)curr, block_size(curr), block_is_used(curr));
+        curr = block_next(curr);
     }
-
-    return new_ptr;
 }
 
 /**
- * Prints a list of blocks, their sizes and free/used status
+ * Prints a list of blocks, their sizes and free/used status, including those of mapped chunks.
+ * Blocks on quick-lists are listed as used, followed by the length of each quick-list.
+ * @param heap The heap to print
  */
-void dump_memory()
+void vs_dump_memory(const vs_heap_t* heap)
 {
     printf("Memory Dump:\n");
-    MemBlock* curr = head;
-    while (curr)
+    if (heap->size)
+        dump_blocks((const MemBlock*)heap->memory);
+    for (const VsChunk* chunk = heap->chunks; chunk; chunk = chunk->next)
+    {
+        printf("\tChunk at %p, size %zu\n", (void*)chunk, chunk->size);
+        dump_blocks(chunk_first_block(chunk));
+    }
+    for (size_t i = 0; i < heap->large_capacity; i++)
+    {
+        if (heap->large_table[i])
+            printf("\tLarge object at %p, size %zu\n", (void*)heap->large_table[i],
+                   ((const VsLarge*)(heap->large_table[i] - LARGE_HEADER_SIZE))->map_size - LARGE_HEADER_SIZE);
+    }
+    for (int bin = 0; bin < VS_QUICK_BIN_COUNT; bin++)
     {
-        printf("\tBlock at %p, size %zu, used %d\n", curr, curr->size, curr->used);
-        curr = curr->next;
+        if (heap->quick_counts[bin])
+            printf("\tQuick-list of size %d: %zu blocks\n", (bin + 1) * ALIGN_SIZE, heap->quick_counts[bin]);
     }
     printf("End Memory Dump\n");
 }
 
+#ifdef RON_SELF_TEST
+#define POOL_SIZE 256 // Size of the memory pool in bytes
+
+/**
+ * Memory pool - Aligned to 8 bytes.
+ * The pool is initialized by vs_init_heap.
+ *
+ * 8-byte alignment ensures compatibility with all data types:
+ * - Satisfies alignment requirements for 64-bit pointers and doubles
+ * - Prevents crashes on strict-alignment architectures (ARM, SPARC)
+ * - Avoids performance penalties on x86/x64 from misaligned access
+ *
+ * Uses 'char' type (exactly 1 byte) to enable byte-level pointer arithmetic.
+ */
+static char memory_pool[POOL_SIZE] __attribute__((aligned(8)));
+
+static vs_heap_t heap;
+
+#include <pthread.h>
+
+/**
+ * Frees the NULL-terminated blocks it is given into the main thread's heap.
+ */
+static void* remote_free(void* arg)
+{
+    void** blocks = arg;
+    for (size_t i = 0; blocks[i]; i++)
+        vs_free_remote(&heap, blocks[i]);
+    return NULL;
+}
+
 /**
  * The main function initializes the allocator and acts as a test suite.
  *
@@ -276,20 +2518,39 @@ void dump_memory()
  * - Invalid pointers
  * - Coalescing
  * - Realloc
+ * - Independent heaps
+ * - Batch allocation and deallocation
+ * - Aligned allocation
+ * - Growth through mapped chunks
+ * - Backward and remapped realloc
+ * - Statistics
+ * - Quick-lists
+ * - Large objects
+ * - Movable blocks and compaction
+ * - Remote frees from another thread
+ * - Sized free
+ * - Calloc
+ * - Purging idle free blocks
  */
 int main()
 {
+    ron_set_error_handler(ron_print_error, NULL); // Failures are silent by default
+
     // Initialize allocator
-    vs_init_allocator();
+    if (vs_init_heap(&heap, memory_pool, POOL_SIZE))
+    {
+        printf("ERROR: Failed to initialize allocator\n");
+        return 1;
+    }
     printf("Initial State:\n");
-    dump_memory();
+    vs_dump_memory(&heap);
 
     printf("\nTest: Allocate until out of memory\n");
     void* blocks[10000]; // store pointers so we can free them later
     size_t count = 0;
     while (1)
     {
-        void* ptr = vs_malloc(16);
+        void* ptr = vs_malloc(&heap, 16);
         if (!ptr)
         {
             printf("Out of memory after %zu successful allocations\n", count);
@@ -297,48 +2558,294 @@ int main()
         }
         blocks[count++] = ptr;
     }
-    dump_memory(); // Should print full memory
+    vs_dump_memory(&heap); // Should print full memory
 
     printf("\nTest: Free all blocks\n");
     for (size_t i = 0; i < count; i++)
     {
-        vs_free(blocks[i]);
+        vs_free(&heap, blocks[i]);
     }
-    dump_memory(); // Should print empty memory
+    vs_dump_memory(&heap); // Should print empty memory
 
     printf("\nTest: Double-free\n");
-    void* ptr = vs_malloc(8);
-    vs_free(ptr);
-    vs_free(ptr); // Should print "Block already free"
-    dump_memory();
+    void* ptr = vs_malloc(&heap, 8);
+    vs_free(&heap, ptr);
+    vs_free(&heap, ptr); // Should print "Block already free"
+    vs_dump_memory(&heap);
 
     printf("\nTest: Invalid pointers\n");
-    vs_free(NULL);
-    vs_free((void*)(memory_pool + 7)); // Unaligned
-    vs_free((void*)(memory_pool + POOL_SIZE + 1)); // Out of bounds
+    vs_free(&heap, NULL);
+    vs_free(&heap, (void*)(memory_pool + 7)); // Unaligned
+    vs_free(&heap, (void*)(memory_pool + POOL_SIZE + 1)); // Out of bounds
 
     printf("\nTest: Coalescing\n");
-    void* a = vs_malloc(8);
-    void* b = vs_malloc(16);
-    void* c = vs_malloc(48);
-    vs_free(a);
-    vs_free(c);
-    dump_memory(); // Should print 3 blocks
-    vs_free(b);
-    dump_memory(); // Should print 1 free block
+    void* a = vs_malloc(&heap, 8);
+    void* b = vs_malloc(&heap, 16);
+    void* c = vs_malloc(&heap, 48);
+    vs_free(&heap, a);
+    vs_free(&heap, c);
+    vs_dump_memory(&heap); // Should print 3 blocks
+    vs_free(&heap, b);
+    vs_dump_memory(&heap); // Should print 1 free block
 
     printf("\nTest: Reallocate memory\n");
-    void* d = vs_realloc(NULL, 16); // Should allocate
-    void* e = vs_realloc(d, 48); // Should expand
+    void* d = vs_realloc(&heap, NULL, 16); // Should allocate
+    void* e = vs_realloc(&heap, d, 48); // Should expand
     if (!e)
     {
         printf("Realloc failed\n");
     }
-    dump_memory();
-    void* f = vs_realloc(e, 8); // Should shrink
-    dump_memory();
-    vs_realloc(f, 0); // Should free
-    dump_memory();
+    vs_dump_memory(&heap);
+    void* f = vs_realloc(&heap, e, 8); // Should shrink
+    vs_dump_memory(&heap);
+    vs_realloc(&heap, f, 0); // Should free
+    vs_dump_memory(&heap);
+    printf("\tFreed block: %s\n", vs_realloc(&heap, f, 8) ? "resized" : "NULL"); // Should print 'Invalid pointer', NULL
+    vs_realloc(&heap, (void*)(memory_pool + 7), 8); // Should print 'Invalid pointer'
+
+    printf("\nTest: Independent heaps\n");
+    static char other_memory[128] __attribute__((aligned(8)));
+    vs_heap_t other;
+    vs_init_heap(&other, other_memory, sizeof(other_memory));
+    void* g = vs_malloc(&heap, 16);
+    void* h = vs_malloc(&other, 16);
+    vs_free(&heap, h); // Should print 'Invalid pointer'
+    vs_free(&other, h);
+    vs_free(&heap, g);
+    vs_dump_memory(&other); // Should print 1 free block
+
+    printf("\nTest: Batch allocate/free\n");
+    void* batch[4];
+    size_t taken = vs_malloc_batch(&heap, 16, 4, batch);
+    printf("\tAllocated %zu adjacent blocks in one batch\n", taken); // Should print 4
+    vs_dump_memory(&heap); // Should print 4 used blocks and 1 free block
+    vs_free_batch(&heap, batch, taken);
+    vs_dump_memory(&heap); // Should print 1 free block
+
+    printf("\nTest: Aligned allocation\n");
+    void* small = vs_malloc(&heap, 8); // Moves the next free payload off a 64-byte boundary
+    char* aligned = vs_aligned_alloc(&heap, 64, 40);
+    printf("\t64-byte alignment: %s\n", (uintptr_t)aligned % 64 == 0 ? "yes" : "no"); // Should print yes
+    vs_dump_memory(&heap); // The padding before the aligned block should be a free block
+    aligned = vs_realloc(&heap, aligned, 64); // Grows in place
+    vs_aligned_alloc(&heap, 48, 8); // Should print 'Alignment must be a power of two'
+    vs_free(&heap, aligned);
+    vs_free(&heap, small);
+    vs_dump_memory(&heap); // Should print 1 free block
+
+    printf("\nTest: Growth through mapped chunks\n");
+    vs_heap_t growable;
+    vs_init_heap(&growable, NULL, 0);
+    vs_set_growth(&growable, 4096, 1);
+    void* chunked[3];
+    for (size_t i = 0; i < 3; i++)
+    {
+        chunked[i] = vs_malloc(&growable, 3000); // Each request maps its own chunk
+    }
+    void* huge = vs_malloc(&growable, 100000); // Larger than a chunk
+    vs_dump_memory(&growable); // Should print 4 chunks
+    vs_free(&growable, huge);
+    for (size_t i = 0; i < 3; i++)
+    {
+        vs_free(&growable, chunked[i]);
+    }
+    vs_dump_memory(&growable); // Should print 1 retained chunk with 1 free block
+    vs_free(&growable, chunked[0]); // Should print 'Invalid pointer' (unmapped)
+    vs_destroy_heap(&growable);
+
+    printf("\nTest: Backward and remapped realloc\n");
+    char* low = vs_malloc(&heap, 32);
+    char* buffer = vs_malloc(&heap, 32);
+    void* high = vs_malloc(&heap, 32); // Blocks forward expansion
+    strcpy(buffer, "moved down");
+    vs_free(&heap, low);
+    char* expanded = vs_realloc(&heap, buffer, 56);
+    printf("\tExpanded into the previous block: %s, data kept: %s\n", expanded == low ? "yes" : "no",
+           strcmp(expanded, "moved down") == 0 ? "yes" : "no"); // Should print yes twice
+    vs_free(&heap, expanded);
+    vs_free(&heap, high);
+    vs_heap_t remapped;
+    vs_init_heap(&remapped, NULL, 0);
+    vs_set_growth(&remapped, 4096, 0);
+    char* vector = vs_malloc(&remapped, 3000);
+    strcpy(vector, "remapped");
+    for (size_t size = 6000; size <= 96000; size *= 2)
+    {
+        vector = vs_realloc(&remapped, vector, size); // Grows its chunk
+    }
+    printf("\tData kept across remaps: %s\n", strcmp(vector, "remapped") == 0 ? "yes" : "no"); // Should print yes
+    vs_dump_memory(&remapped); // Should print 1 chunk
+    vs_free(&remapped, vector);
+    vs_destroy_heap(&remapped);
+
+    printf("\nTest: Statistics\n");
+    void* fragments[3];
+    for (size_t i = 0; i < 3; i++)
+    {
+        fragments[i] = vs_malloc(&heap, 16);
+    }
+    vs_free(&heap, fragments[1]); // Leaves a hole before the large free tail
+    vs_stats_t stats;
+    vs_get_stats(&heap, &stats);
+    printf("\tFree blocks: %zu, free bytes: %zu, largest: %zu, fragmentation: %.1f%%\n", stats.free_blocks,
+           stats.free_bytes, stats.largest_free_block, 100.0 * stats.fragmentation); // Should print 2 free blocks
+    printf("\tCounted: %llu mallocs, %llu frees, %llu splits, %llu coalesces, %llu in-place and %llu copying reallocs,"
+           " %llu OOM\n", (unsigned long long)stats.mallocs, (unsigned long long)stats.frees,
+           (unsigned long long)stats.splits, (unsigned long long)stats.coalesces,
+           (unsigned long long)stats.realloc_in_place, (unsigned long long)stats.realloc_copies,
+           (unsigned long long)stats.oom); // All 0 without RON_STATS
+    vs_free(&heap, fragments[0]);
+    vs_free(&heap, fragments[2]);
+
+    printf("\nTest: Quick-lists\n");
+    vs_set_quick_lists(&heap, 2);
+    void* quick = vs_malloc(&heap, 24);
+    void* neighbour = vs_malloc(&heap, 24);
+    vs_free(&heap, quick); // Queued, not coalesced
+    printf("\tSame-size reuse: %s\n", vs_malloc(&heap, 24) == quick ? "yes" : "no"); // Should print yes
+    vs_free(&heap, quick);
+    vs_free(&heap, quick); // Should print "Block already free"
+    vs_realloc(&heap, quick, 16); // Should print 'Invalid pointer' (queued on its quick-list)
+    vs_free(&heap, neighbour);
+    vs_dump_memory(&heap); // Should print a quick-list of 2 blocks
+    void* large = vs_malloc(&heap, 200); // Misses, so the quick-lists are consolidated first
+    vs_free(&heap, large);
+    vs_set_quick_lists(&heap, 0);
+    vs_dump_memory(&heap); // Should print 1 free block
+
+    printf("\nTest: Large objects\n");
+    vs_set_large_objects(&heap, 4096, VS_LARGE_TRANSPARENT_HUGE_PAGES, 1);
+    char* object = vs_malloc(&heap, 100000); // Larger than the whole region
+    strcpy(object, "large");
+    object = vs_realloc(&heap, object, 3000000); // Remapped
+    printf("\tServed by its own mapping: %s, data kept: %s\n", vs_usable_size(&heap, object) >= 3000000 ? "yes" : "no",
+           strcmp(object, "large") == 0 ? "yes" : "no"); // Should print yes twice
+    vs_dump_memory(&heap); // Should print 1 free block and 1 large object
+    vs_free(&heap, object);
+    void* reused = vs_malloc(&heap, 2500000);
+    vs_get_stats(&heap, &stats);
+    printf("\tFreed mapping cached: %s\n", stats.large_objects == 1 && stats.large_cached == 0 ? "yes" : "no"); // Should print yes
+    vs_free(&heap, reused);
+    vs_free(&heap, reused); // Should print 'Invalid pointer' (no longer a large object)
+    vs_destroy_heap(&heap); // Unmaps the cached mapping
+    vs_init_heap(&heap, memory_pool, POOL_SIZE);
+
+    printf("\nTest: Movable blocks and compaction\n");
+    static char compact_pool[4096] __attribute__((aligned(8)));
+    vs_heap_t compacted;
+    vs_init_heap(&compacted, compact_pool, sizeof(compact_pool));
+    vs_handle_t handles[24];
+    for (int i = 0; i < 24; i++)
+    {
+        handles[i] = vs_halloc(&compacted, 100);
+        char* text = vs_hlock(&compacted, handles[i]);
+        if (text)
+            sprintf(text, "block %d", i);
+        vs_hunlock(&compacted, handles[i]);
+    }
+    for (int i = 0; i < 24; i += 2)
+    {
+        vs_hfree(&compacted, handles[i]); // Checkerboard of 120 byte gaps
+    }
+    char* pinned = vs_hlock(&compacted, handles[1]);
+    void* wide = vs_malloc(&compacted, 2000); // Should print 'Out of memory'
+    size_t slices = 1;
+    while (!vs_compact(&compacted, 256))
+    {
+        slices++;
+    }
+    wide = vs_malloc(&compacted, 2000);
+    char* moved = vs_hlock(&compacted, handles[11]);
+    printf("\tCompacted in %s slice(s): %s, data kept: %s, pinned block kept: %s\n", slices > 1 ? "several" : "one",
+           wide ? "yes" : "no", strcmp(moved, "block 11") == 0 ? "yes" : "no",
+           pinned == vs_hlock(&compacted, handles[1]) ? "yes" : "no"); // Should print several and yes three times
+    vs_hunlock(&compacted, handles[1]);
+    vs_hunlock(&compacted, handles[1]);
+    vs_hunlock(&compacted, handles[11]);
+    vs_hunlock(&compacted, handles[11]); // Should print 'Invalid pointer' (not pinned)
+    vs_free(&compacted, wide);
+    for (int i = 1; i < 24; i += 2)
+    {
+        vs_hfree(&compacted, handles[i]);
+    }
+    vs_hfree(&compacted, handles[1]); // Should print 'Invalid pointer' (stale handle)
+    vs_dump_memory(&compacted); // Should print 1 free block
+    vs_destroy_heap(&compacted); // Unmaps the handle table
+
+    printf("\nTest: Remote frees\n");
+    void* owned[3] = { vs_malloc(&heap, 100), vs_malloc(&heap, 100), NULL };
+    pthread_t remote;
+    pthread_create(&remote, NULL, remote_free, owned);
+    pthread_join(remote, NULL);
+    vs_get_stats(&heap, &stats);
+    printf("\tQueued blocks still used: %s\n", stats.free_blocks == 0 ? "yes" : "no"); // Should print yes
+    void* merged = vs_malloc(&heap, 200); // Misses, so the queue is drained and the blocks coalesce
+    printf("\tAllocated across both: %s\n", merged ? "yes" : "no"); // Should print yes
+    vs_free_remote(&heap, merged);
+    vs_drain_remote(&heap);
+    vs_dump_memory(&heap); // Should print 1 free block
+
+    printf("\nTest: Sized free\n");
+    vs_set_quick_lists(&heap, 4);
+    void* sized = vs_malloc(&heap, 40);
+    vs_free_sized(&heap, sized, 40); // Onto the 40 byte quick-list, header untouched
+    printf("\tReused from its quick-list: %s\n", vs_malloc(&heap, 40) == sized ? "yes" : "no"); // Should print yes
+#ifdef RON_HARDENED
+    vs_free_sized(&heap, sized, 100); // Should print 'Size does not match the allocation'
+    void* bigger = vs_malloc(&heap, 160);
+    vs_free_sized(&heap, bigger, 8); // Should print 'Size does not match the allocation' (too small)
+    vs_free_sized(&heap, bigger, 156); // Same block size
+#endif
+    vs_free_sized(&heap, sized, 40);
+    vs_set_quick_lists(&heap, 0); // Consolidates the block
+    vs_dump_memory(&heap); // Should print 1 free block
+
+    printf("\nTest: Calloc\n");
+    static char zeroed_memory[POOL_SIZE] __attribute__((aligned(8))); // Static storage starts out zero
+    vs_heap_t zeroed;
+    vs_init_heap(&zeroed, zeroed_memory, POOL_SIZE);
+    vs_set_zeroed(&zeroed);
+    unsigned char* cleared = vs_calloc(&zeroed, 10, 8);
+    memset(cleared, 0xAB, 80); // Dirty the block, then hand it out again
+    vs_free(&zeroed, cleared);
+    cleared = vs_calloc(&zeroed, 12, 8); // Reuses the dirty bytes and some never touched ones
+    int all_zero = 1;
+    for (size_t i = 0; i < 96; i++)
+        all_zero &= cleared[i] == 0;
+    printf("\tReused block cleared: %s\n", all_zero ? "yes" : "no"); // Should print yes
+    vs_calloc(&zeroed, SIZE_MAX / 2, 4); // Should print 'Out of memory'
+    vs_free(&zeroed, cleared);
+    vs_dump_memory(&zeroed); // Should print 1 free block
+
+    printf("\nTest: Purging\n");
+    vs_heap_t purgeable;
+    vs_init_heap(&purgeable, NULL, 0);
+    vs_set_growth(&purgeable, 1 << 20, 1);
+    vs_set_purging(&purgeable, 1000, 0, 0);
+    char* spike = vs_malloc(&purgeable, 256 << 10);
+    void* pinned_after_spike = vs_malloc(&purgeable, 64); // Keeps the spike from merging with the rest of the chunk
+    char* burst = vs_malloc(&purgeable, 256 << 10);
+    void* pinned_after_burst = vs_malloc(&purgeable, 64);
+    memset(spike, 0xAB, 256 << 10);
+    vs_free(&purgeable, spike);
+    printf("\tPurged before the decay: %zu bytes\n", vs_purge(&purgeable, 0)); // Should print 0 bytes
+    size_t purged = vs_purge(&purgeable, 1);
+    printf("\tPurged on demand: %s, pages dropped: %s\n", purged >= (240 << 10) ? "yes" : "no",
+           spike[128 << 10] == 0 ? "yes" : "no"); // Should print yes twice
+    spike = vs_malloc(&purgeable, 256 << 10);
+    memset(spike, 0xCD, 256 << 10); // Faults the purged pages back in
+    vs_set_purging(&purgeable, 1, 0, 0);
+    vs_free(&purgeable, spike);
+    nanosleep(&(struct timespec){ 0, 5000000 }, NULL); // Longer than the decay
+    vs_free(&purgeable, burst); // Starts the purge that is due
+    vs_get_stats(&purgeable, &stats);
+    printf("\tIdle blocks purged by a later free: %s\n", stats.purged_free_bytes == stats.free_bytes - (256 << 10)
+           ? "yes" : "no"); // Should print yes (all but the block it freed)
+    vs_free(&purgeable, pinned_after_spike);
+    vs_free(&purgeable, pinned_after_burst);
+    vs_dump_memory(&purgeable); // Should print 1 retained chunk with 1 free block
+    vs_destroy_heap(&purgeable);
 
     return 0;
 }
+#endif
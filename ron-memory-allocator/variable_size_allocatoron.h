@@ -0,0 +1,215 @@
+/**
+ * Public interface of the variable-size allocator.
+ * See variable_size_allocatoron.c for the design notes.
+ */
+
+#ifndef VARIABLE_SIZE_ALLOCATORON_H
+#define VARIABLE_SIZE_ALLOCATORON_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Segregated free index parameters. Public because every vs_heap_t embeds its index.
+ *
+ * - VS_ALIGN_SIZE_LOG2: Payload sizes are rounded up to multiples of 2^VS_ALIGN_SIZE_LOG2 bytes
+ * - VS_SL_INDEX_COUNT_LOG2: 16 subdivisions bound the internal waste of a good-fit to ~6%
+ * - VS_FL_INDEX_MAX: Largest supported block is 2^VS_FL_INDEX_MAX bytes
+ */
+#define VS_ALIGN_SIZE_LOG2 3
+#define VS_SL_INDEX_COUNT_LOG2 4
+#define VS_FL_INDEX_MAX 32
+#define VS_SL_INDEX_COUNT (1 << VS_SL_INDEX_COUNT_LOG2)
+#define VS_FL_INDEX_COUNT (VS_FL_INDEX_MAX - (VS_SL_INDEX_COUNT_LOG2 + VS_ALIGN_SIZE_LOG2) + 1)
+
+/**
+ * Quick-list parameters: one exact-size bin per payload size up to VS_QUICK_MAX_SIZE bytes.
+ */
+#define VS_QUICK_MAX_SIZE 128
+#define VS_QUICK_BIN_COUNT (VS_QUICK_MAX_SIZE >> VS_ALIGN_SIZE_LOG2)
+
+/**
+ * Large-object parameters and flags of vs_set_large_objects.
+ */
+#define VS_LARGE_CACHE_MAX 16 // Most freed mappings a heap can cache
+#define VS_LARGE_TRANSPARENT_HUGE_PAGES 1U // Round to 2 MiB and ask for transparent huge pages (Linux)
+#define VS_LARGE_HUGETLB 2U // Use explicit huge pages when reserved (Linux), regular pages otherwise
+
+/**
+ * Flags of vs_set_purging.
+ */
+#define VS_PURGE_LAZY 1U // Purge with MADV_FREE where available: pages are only reclaimed under memory pressure
+#define VS_PURGE_REGION 2U // Also purge the caller's region, which must then be private memory
+
+/**
+ * A variable-size heap over a caller-provided memory region, optionally grown with mapped chunks.
+ * Heaps are independent, so each core, connection or subsystem can own one.
+ *
+ * Fields:
+ * - `memory`: Start of the region. Must be 8-byte aligned. NULL for a heap made only of chunks.
+ * - `size`: Size of the region in bytes, rounded down to the alignment.
+ * - `chunks`: List of the chunks mapped from the OS (see variable_size_allocatoron.c).
+ * - `chunk_size`: Minimal size of a new chunk. 0 when the heap may not grow.
+ * - `retained_chunks`: Number of fully free chunks kept mapped instead of being released.
+ * - `fl_bitmap`: Bit i is set when any bucket in first-level class i is non-empty.
+ * - `sl_bitmap`: Bit j of sl_bitmap[i] is set when bucket [i][j] is non-empty.
+ * - `free_blocks`: Heads of the per-bucket free lists.
+ * - `quick_limit`: Blocks a quick-list may hold before it is consolidated. 0 when quick-lists are disabled.
+ * - `quick_bitmap`: Bit i is set when quick-list i is non-empty.
+ * - `quick_bins`: Heads of the exact-size quick-lists of freed small blocks (see variable_size_allocatoron.c).
+ * - `quick_counts`: Number of blocks on each quick-list.
+ * - `large_threshold`: Smallest request served by a dedicated mapping. 0 when the large-object path is disabled.
+ * - `large_flags`: Huge-page flags of new large objects.
+ * - `large_cache_limit`: Number of freed large-object mappings kept for reuse.
+ * - `large_table`, `large_capacity`, `large_count`: Hash set of the live large objects' payloads.
+ * - `large_cache`, `large_cached`: The cached mappings.
+ * - `handles`, `handle_capacity`: Table of the movable blocks allocated with vs_halloc.
+ * - `free_handle`: First free table entry (index + 1), 0 when the table is full.
+ * - `compact_cursor`: Block where the next slice of vs_compact resumes. NULL at the start of a pass.
+ * - `remote_frees`: Payloads freed by other threads, waiting for the owner (see vs_free_remote).
+ * - `fresh`: Offset into the region past which its memory is known to be zero (see vs_calloc).
+ * - `fresh_start`: Where the last allocation at the end of a region started using known-zero memory.
+ * - `purge_decay`: Milliseconds a large free block stays idle before its pages are purged. 0 disables purging.
+ * - `purge_min_size`: Smallest free block whose idle time is tracked.
+ * - `purge_flags`: Flags of vs_set_purging.
+ * - `purge_clock`: Time of the last idle stamp, in milliseconds of a monotonic clock.
+ * - `purge_next`: Time at which the next free may start a purge.
+ */
+typedef struct vs_heap_t
+{
+    char* memory;
+    size_t size;
+    struct VsChunk* chunks;
+    size_t chunk_size;
+    size_t retained_chunks;
+    unsigned int fl_bitmap;
+    unsigned int sl_bitmap[VS_FL_INDEX_COUNT];
+    struct MemBlock* free_blocks[VS_FL_INDEX_COUNT][VS_SL_INDEX_COUNT];
+    size_t quick_limit;
+    unsigned int quick_bitmap;
+    struct MemBlock* quick_bins[VS_QUICK_BIN_COUNT];
+    size_t quick_counts[VS_QUICK_BIN_COUNT];
+    size_t large_threshold;
+    unsigned int large_flags;
+    size_t large_cache_limit;
+    uintptr_t* large_table;
+    size_t large_capacity;
+    size_t large_count;
+    void* large_cache[VS_LARGE_CACHE_MAX];
+    size_t large_cached;
+    struct VsHandle* handles;
+    size_t handle_capacity;
+    size_t free_handle;
+    struct MemBlock* compact_cursor;
+    _Atomic(void*) remote_frees;
+    size_t fresh;
+    char* fresh_start;
+    uint64_t purge_decay;
+    size_t purge_min_size;
+    unsigned int purge_flags;
+    uint64_t purge_clock;
+    uint64_t purge_next;
+} vs_heap_t;
+
+/**
+ * Refers to a movable block allocated with vs_halloc. 0 is never a valid handle.
+ */
+typedef size_t vs_handle_t;
+
+/**
+ * A snapshot taken by vs_get_stats.
+ *
+ * Counters, summed over all threads and heaps (0 unless built with RON_STATS):
+ * - `mallocs`, `frees`: Successful allocations (of any kind) and deallocations.
+ * - `searches`: Searches of the free index.
+ * - `blocks_examined`: Free blocks inspected by those searches. At most one per search with the TLSF index.
+ * - `splits`: Blocks split into a used part and a free remainder.
+ * - `coalesces`: Merges of two adjacent free blocks.
+ * - `realloc_in_place`, `realloc_copies`: vs_realloc calls that resized the block in place or moved the data.
+ * - `realloc_backward`: vs_realloc calls that expanded into the previous block, sliding the data down.
+ * - `realloc_remapped`: vs_realloc calls that grew a chunk's last block or a large object by remapping it.
+ * - `large_mapped`, `large_cache_hits`: Large objects that were newly mapped or taken from the cache.
+ * - `compact_moves`: Movable blocks slid down by vs_compact.
+ * - `oom`: Allocations that found no memory.
+ * - `invalid_frees`: Frees of invalid or already free pointers.
+ * - `remote_frees`: Frees queued by vs_free_remote.
+ * - `quick_hits`: Allocations served from a quick-list.
+ * - `consolidations`: Quick-lists emptied into the free index.
+ * - `chunks_mapped`, `chunks_unmapped`: Chunks mapped and released by growable heaps.
+ * - `purged_bytes`: Bytes of idle free blocks whose pages were returned to the OS.
+ *
+ * Free index of the inspected heap (always available):
+ * - `free_blocks`: Total length of the free lists.
+ * - `free_bytes`: Payload bytes of the free blocks.
+ * - `largest_free_block`: Payload size of the largest free block.
+ * - `purged_free_bytes`: Payload bytes of the free blocks that were purged since they became free.
+ * - `quick_blocks`: Freed blocks waiting on quick-lists, not counted as free blocks above.
+ * - `large_objects`, `large_cached`: Live large objects and cached mappings.
+ * - `fragmentation`: External fragmentation, 1 - largest_free_block / free_bytes (0 without free memory).
+ */
+typedef struct vs_stats_t
+{
+    uint64_t mallocs;
+    uint64_t frees;
+    uint64_t searches;
+    uint64_t blocks_examined;
+    uint64_t splits;
+    uint64_t coalesces;
+    uint64_t realloc_in_place;
+    uint64_t realloc_copies;
+    uint64_t realloc_backward;
+    uint64_t realloc_remapped;
+    uint64_t large_mapped;
+    uint64_t large_cache_hits;
+    uint64_t compact_moves;
+    uint64_t oom;
+    uint64_t invalid_frees;
+    uint64_t remote_frees;
+    uint64_t quick_hits;
+    uint64_t consolidations;
+    uint64_t chunks_mapped;
+    uint64_t chunks_unmapped;
+    uint64_t purged_bytes;
+    size_t free_blocks;
+    size_t free_bytes;
+    size_t largest_free_block;
+    size_t purged_free_bytes;
+    size_t quick_blocks;
+    size_t large_objects;
+    size_t large_cached;
+    double fragmentation;
+} vs_stats_t;
+
+int vs_init_heap(vs_heap_t* heap, void* memory, size_t size);
+int vs_set_growth(vs_heap_t* heap, size_t chunk_size, size_t retained_chunks);
+void vs_set_quick_lists(vs_heap_t* heap, size_t bin_limit);
+int vs_set_large_objects(vs_heap_t* heap, size_t threshold, unsigned int flags, size_t cache_count);
+void vs_set_purging(vs_heap_t* heap, uint64_t decay_ms, size_t min_size, unsigned int flags);
+size_t vs_purge(vs_heap_t* heap, int all);
+void vs_destroy_heap(vs_heap_t* heap);
+void* vs_malloc(vs_heap_t* heap, size_t size);
+void* vs_memalign(vs_heap_t* heap, size_t alignment, size_t size);
+void* vs_aligned_alloc(vs_heap_t* heap, size_t alignment, size_t size);
+void* vs_calloc(vs_heap_t* heap, size_t count, size_t size);
+void vs_set_zeroed(vs_heap_t* heap);
+void vs_free(vs_heap_t* heap, void* ptr);
+void vs_free_sized(vs_heap_t* heap, void* ptr, size_t size);
+void vs_free_remote(vs_heap_t* heap, void* ptr);
+void vs_drain_remote(vs_heap_t* heap);
+size_t vs_malloc_batch(vs_heap_t* heap, size_t size, size_t count, void** out);
+void vs_free_batch(vs_heap_t* heap, void** ptrs, size_t count);
+void* vs_realloc(vs_heap_t* heap, void* ptr, size_t new_size);
+void* vs_realloc_aligned(vs_heap_t* heap, void* ptr, size_t alignment, size_t new_size);
+vs_handle_t vs_halloc(vs_heap_t* heap, size_t size);
+void* vs_hlock(vs_heap_t* heap, vs_handle_t handle);
+void vs_hunlock(vs_heap_t* heap, vs_handle_t handle);
+void vs_hfree(vs_heap_t* heap, vs_handle_t handle);
+int vs_compact(vs_heap_t* heap, size_t budget);
+int vs_owns(const vs_heap_t* heap, const void* ptr);
+size_t vs_usable_size(const vs_heap_t* heap, const void* ptr);
+size_t vs_footprint(const vs_heap_t* heap);
+void vs_get_stats(const vs_heap_t* heap, vs_stats_t* stats);
+void vs_dump_memory(const vs_heap_t* heap);
+
+#endif
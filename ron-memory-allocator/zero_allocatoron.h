@@ -0,0 +1,54 @@
+/**
+ * Zeroing shared by the calloc variants of the allocators (fs_calloc, vs_calloc, slab_calloc).
+ *
+ * The allocators track which memory is still known to be zero, so most of a fresh block is never written.
+ * What is left to clear goes through ron_zero: memset for ordinary sizes, and streaming (non-temporal)
+ * stores from RON_STREAM_ZERO_MIN bytes on, so zeroing a large block does not evict the caches.
+ */
+
+#ifndef ZERO_ALLOCATORON_H
+#define ZERO_ALLOCATORON_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define RON_STREAM_ZERO_MIN ((size_t)256 << 10) // Smallest range zeroed with streaming stores
+
+/**
+ * Clears a range of memory.
+ * @param ptr Start of the range
+ * @param size Size of the range in bytes
+ */
+static inline void ron_zero(void* ptr, size_t size)
+{
+#ifdef __SSE2__
+    if (size >= RON_STREAM_ZERO_MIN)
+    {
+        char* curr = ptr;
+        size_t head = (16 - (uintptr_t)curr % 16) % 16; // Streaming stores need 16-byte alignment
+        memset(curr, 0, head);
+        curr += head;
+        size -= head;
+
+        __m128i zero = _mm_setzero_si128();
+        for (; size >= 64; curr += 64, size -= 64)
+        {
+            _mm_stream_si128((__m128i*)curr, zero);
+            _mm_stream_si128((__m128i*)(curr + 16), zero);
+            _mm_stream_si128((__m128i*)(curr + 32), zero);
+            _mm_stream_si128((__m128i*)(curr + 48), zero);
+        }
+        _mm_sfence(); // Streaming stores are weakly ordered: publish them before the block is handed out
+        memset(curr, 0, size);
+        return;
+    }
+#endif
+    memset(ptr, 0, size);
+}
+
+#endif